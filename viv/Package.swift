@@ -35,9 +35,27 @@ let package = Package(
         .define("DEBUG=0", .when(configuration: .release)),
         .define("DEBUG=1", .when(configuration: .debug)),
       ]),
+    .target(
+      name: "vivsim",
+      dependencies: ["viv"],
+      cxxSettings: [
+        .unsafeFlags(["-fno-exceptions", "-fno-rtti"]),
+        .define("NDEBUG", .when(configuration: .release)),
+        .define("DEBUG=0", .when(configuration: .release)),
+        .define("DEBUG=1", .when(configuration: .debug)),
+      ]),
+    .executableTarget(
+      name: "vivbench",
+      dependencies: ["viv", "vivsim"],
+      cxxSettings: [
+        .unsafeFlags(["-fno-exceptions", "-fno-rtti"]),
+        .define("NDEBUG", .when(configuration: .release)),
+        .define("DEBUG=0", .when(configuration: .release)),
+        .define("DEBUG=1", .when(configuration: .debug)),
+      ]),
     .testTarget(
       name: "VivTests",
-      dependencies: ["viv"],
+      dependencies: ["viv", "vivsim"],
       path: "Tests/vivTests"),
     .testTarget(
       name: "VivSwiftTests",
@@ -0,0 +1,195 @@
+// capture.cpp - binary capture of manager sessions
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/capture.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "viv/capture.h"
+#include "viv/directory_query.h"
+#include "viv/endian.hpp"
+#include "viv/packet.h"
+
+#pragma clang assume_nonnull begin
+
+namespace {
+
+constexpr uint8_t kFileHeader[] = {'V', 'I', 'V', 'C', 'A', 'P', 2, 0};
+
+/// Maximum length of an unsigned LEB128 encoding of a uint64_t.
+constexpr size_t kMaxVarintLength = 10;
+
+/// Largest record: type/length byte, varint, value.
+constexpr size_t kMaxRecordLength =
+    1 + kMaxVarintLength + viv::kCaptureMaxValueLength;
+
+/// Number of bits used for the event type.
+constexpr int kTypeBits = 2;
+static_assert(
+    viv::kCaptureMaxValueLength < (1 << (8 - kTypeBits)),
+    "The value's length must fit in the rest of the byte");
+
+} // namespace
+
+namespace viv {
+
+size_t
+WriteCaptureTime(uint8_t *p, size_t offset, time_t posix_time) {
+  uint64_t const time = static_cast<uint64_t>(posix_time);
+  VLWriteLittleInt32(p, offset, static_cast<uint32_t>(time));
+  VLWriteLittleInt32(p, offset + 4, static_cast<uint32_t>(time >> 32));
+  return sizeof(uint64_t);
+}
+
+time_t
+ReadCaptureTime(uint8_t const *p, size_t offset) {
+  return static_cast<time_t>(
+      OSReadLittleInt32(p, offset) |
+      (uint64_t{OSReadLittleInt32(p, offset + 4)} << 32));
+}
+
+void
+WriteCaptureQuery(uint8_t *p, VLDirectoryQuery const &query) {
+  size_t n = 0;
+  n += WriteCaptureTime(p, n, query.min_posix_time);
+  n += WriteCaptureTime(p, n, query.max_posix_time);
+  n += VLWriteLittleInt32(p, n, query.min_length);
+  n += VLWriteLittleInt32(p, n, query.max_length);
+  n += VLWriteLittleInt16(p, n, query.file_type);
+  n += VLWriteLittleInt16(p, n, query.limit);
+  p[n++] = query.required_flags;
+  p[n++] = query.order;
+  assert(n == kCaptureQueryLength);
+}
+
+VLDirectoryQuery
+ReadCaptureQuery(uint8_t const *p) {
+  VLDirectoryQuery query = {};
+  query.min_posix_time = ReadCaptureTime(p, 0);
+  query.max_posix_time = ReadCaptureTime(p, 8);
+  query.min_length = OSReadLittleInt32(p, 16);
+  query.max_length = OSReadLittleInt32(p, 20);
+  query.file_type = static_cast<VLFileType>(OSReadLittleInt16(p, 24));
+  query.limit = OSReadLittleInt16(p, 26);
+  query.required_flags = p[28];
+  query.order = static_cast<VLDirectoryOrder>(p[29]);
+  return query;
+}
+
+void
+CaptureWriter::Record(
+    CaptureEventType type, uint8_t const *_Nullable value, size_t length) {
+  if (!ok_) {
+    return;
+  }
+  if (!started_) {
+    started_ = true;
+    if (sink_(kFileHeader, sizeof(kFileHeader))) {
+      ok_ = false;
+      return;
+    }
+  }
+
+  uint64_t const now = clock_();
+  uint64_t delta = now - last_time_;
+  last_time_ = now;
+  length = (value == nullptr)
+               ? 0
+               : std::min<size_t>(length, kCaptureMaxValueLength);
+
+  uint8_t record[kMaxRecordLength];
+  size_t n = 0;
+  record[n++] = static_cast<uint8_t>(type | (length << kTypeBits));
+  do {
+    uint8_t const low = delta & 0x7f;
+    delta >>= 7;
+    record[n++] = low | (delta ? 0x80 : 0);
+  } while (delta);
+  if (length > 0) {
+    std::memcpy(record + n, value, length);
+    n += length;
+  }
+
+  if (sink_(record, n)) {
+    ok_ = false;
+  }
+}
+
+int
+CaptureReader::Next(CaptureEvent &event) {
+  if (pos_ == data_) {
+    if (static_cast<size_t>(end_ - pos_) < sizeof(kFileHeader) ||
+        std::memcmp(pos_, kFileHeader, sizeof(kFileHeader))) {
+      return -1;
+    }
+    pos_ += sizeof(kFileHeader);
+  }
+  if (pos_ == end_) {
+    return 0;
+  }
+
+  uint8_t const type = *pos_ & ((1 << kTypeBits) - 1);
+  uint8_t const length = *pos_ >> kTypeBits;
+  ++pos_;
+  if (type != kCaptureCall && length > kVLPacketMaxLength) {
+    return -2;
+  }
+
+  uint64_t delta = 0;
+  for (int shift = 0;; shift += 7) {
+    if (pos_ == end_ || shift >= 64) {
+      return -3;
+    }
+    uint8_t const byte = *pos_++;
+    delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+
+  if (static_cast<size_t>(end_ - pos_) < length) {
+    return -3;
+  }
+  time_ += delta;
+  event.type = static_cast<CaptureEventType>(type);
+  event.time = time_;
+  event.length = length;
+  std::memcpy(event.value, pos_, length);
+  pos_ += length;
+  return 1;
+}
+
+} // namespace viv
+
+VLCaptureWriter
+VLMakeCaptureWriter(
+    void *_Nullable ctx,
+    int (*write)(void *_Nullable ctx, uint8_t const *data, size_t length),
+    uint64_t (*now)(void *_Nullable ctx)) {
+  return VLCaptureWriter{new viv::CaptureWriter(
+      viv::CaptureWriter::Sink(write, ctx),
+      viv::CaptureWriter::Clock(now, ctx))};
+}
+
+void
+VLDeleteCaptureWriter(VLCaptureWriter writer) {
+  delete reinterpret_cast<viv::CaptureWriter *>(writer.writer);
+}
+
+#pragma clang assume_nonnull end
@@ -0,0 +1,103 @@
+// clock_discipline.cpp - deciding when and how to set the Viiiiva's clock
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/clock_discipline.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+namespace {
+
+/// Offset beyond which the clock is set by default, in seconds.
+constexpr double kDefaultThreshold = 2.0;
+
+/// Default weight of new drift observations.
+constexpr double kDefaultGain = 0.25;
+
+/// Default minimum interval for drift observations, in seconds.
+constexpr double kDefaultMinInterval = 6 * 60 * 60;
+
+} // namespace
+
+VLClockOptions
+VLClockDefaultOptions() {
+  return VLClockOptions{kDefaultThreshold, kDefaultGain, kDefaultMinInterval};
+}
+
+double
+VLClockMeasureOffset(std::time_t device_time, double sent, double rtt) {
+  // The clock was truncated, so on average it was half a second later.
+  return (device_time + 0.5) - (sent + rtt / 2);
+}
+
+double
+VLClockPredictOffset(VLClockState const *state, double host_time) {
+  assert(state != nullptr);
+  if (state->set_time == 0) {
+    return 0;
+  }
+  return state->drift * (host_time - state->set_time);
+}
+
+void
+VLClockObserve(
+    VLClockState *state, VLClockOptions const *options, double host_time,
+    double offset) {
+  assert(state != nullptr);
+  assert(options != nullptr);
+  double const interval = host_time - state->set_time;
+  if (state->set_time == 0 || interval < options->min_interval) {
+    return;
+  }
+
+  double const drift = offset / interval;
+  if (state->samples == 0) {
+    state->drift = drift;
+  } else {
+    state->drift += options->gain * (drift - state->drift);
+  }
+  ++state->samples;
+}
+
+int
+VLClockShouldSet(
+    VLClockState const *state, VLClockOptions const *options, double host_time,
+    double offset) {
+  assert(state != nullptr);
+  assert(options != nullptr);
+  if (std::isnan(offset)) {
+    if (state->set_time == 0) {
+      // Nothing is known about the clock.
+      return 1;
+    }
+    offset = VLClockPredictOffset(state, host_time);
+  }
+  return std::fabs(offset) > options->threshold;
+}
+
+std::time_t
+VLClockCompensatedTime(double host_time, double rtt) {
+  // The command takes about half the round trip to arrive.  The Viiiiva only
+  // keeps whole seconds, so round to the nearest.
+  return static_cast<std::time_t>(std::llround(host_time + rtt / 2));
+}
+
+void
+VLClockDidSet(VLClockState *state, double host_time) {
+  assert(state != nullptr);
+  state->set_time = host_time;
+}
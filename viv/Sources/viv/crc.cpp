@@ -26,9 +26,15 @@ namespace {
 /// CRC-8 polynomial used for Viiiiva config packets.
 constexpr uint8_t kPoly = 7;
 
+/// Reflected CRC-32 polynomial.
+constexpr uint32_t kPoly32 = 0xedb88320;
+
 /// Precomputed CRC for every possible byte value.
 using LookupTable = std::array<uint8_t, 256>;
 
+/// Precomputed CRC-32 for every possible byte value.
+using LookupTable32 = std::array<uint32_t, 256>;
+
 /// Returns the CRC for a single byte.
 ///
 /// \tparam T_poly The (shifted) CRC polynomial.
@@ -56,6 +62,23 @@ crc_init_lookup() {
   return table;
 }
 
+/// Returns a CRC-32 lookup table for every byte value.
+///
+/// \tparam T_poly The (reflected) CRC polynomial.
+template <uint32_t T_poly>
+constexpr LookupTable32
+crc32_init_lookup() {
+  LookupTable32 table{};
+  for (uint32_t i = 0; i < table.size(); ++i) {
+    uint32_t x = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      x = x & 1 ? (x >> 1) ^ T_poly : x >> 1;
+    }
+    table[i] = x;
+  }
+  return table;
+}
+
 } // namespace
 
 namespace viv {
@@ -70,6 +93,16 @@ crc(uint8_t const *data, size_t length) {
   return crc;
 }
 
+uint32_t
+crc32(uint8_t const *data, size_t length) {
+  static LookupTable32 const lookup = crc32_init_lookup<kPoly32>();
+  uint32_t crc = 0xffffffff;
+  for (uint8_t const *p = data; p < data + length; ++p) {
+    crc = lookup[(crc ^ *p) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffff;
+}
+
 } // namespace viv
 
 #pragma clang assume_nonnull end
@@ -15,49 +15,88 @@
 
 #include "viv/directory.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
-#include <utility>
+#include <cstring>
 
 #include "viv/directory_entry.h"
 #include "viv/raw_directory.h"
 
 namespace viv {
 
-Directory::Reader::Reader(uint8_t const *src, size_t length) noexcept
-    : entries_(), src_(src), end_(src_ + length), valid_() {
+static_assert(
+    alignof(VLRawDirectoryEntry) == 1,
+    "DirectoryView assumes entries can be read from any offset");
+static_assert(
+    sizeof(VLDirectoryEntry) <= sizeof(VLRawDirectoryEntry),
+    "DecodeEntriesInPlace must not overwrite entries it hasn't read");
+
+DirectoryView::DirectoryView(uint8_t const *src, size_t length) noexcept
+    : src_(src), length_(length), header_() {
   assert(src != nullptr);
-  assert(src <= end_);
 }
 
 bool
-Directory::Reader::Read() {
-  entries_.clear();
-
-  int read = VLReadDirectoryHeader(&hdr_, src_, end_ - src_);
-  if (read < 0) {
+DirectoryView::Read() {
+  size_ = 0;
+  if (length_ < sizeof(header_) ||
+      VLReadDirectoryHeader(&header_, src_, length_) < 0) {
+    return false;
+  }
+  size_t const entries_length = length_ - sizeof(header_);
+  if (entries_length % sizeof(VLRawDirectoryEntry) != 0) {
     return false;
   }
+  size_ = entries_length / sizeof(VLRawDirectoryEntry);
+  sorted_known_ = false;
+  return true;
+}
 
-  for (auto *p = src_ + read; p < end_; p += read) {
-    VLRawDirectoryEntry raw;
-    read = VLReadNextDirectoryEntry(&raw, p, end_ - p);
-    if (read < 0) {
-      return false;
+VLRawDirectoryEntry const *_Nullable
+DirectoryView::Find(uint16_t index) const {
+  VLRawDirectoryEntry const *const first = entries();
+  VLRawDirectoryEntry const *const last = first + size_;
+  auto const index_of = [](VLRawDirectoryEntry const &raw) {
+    return OSReadLittleInt16(raw.index, 0);
+  };
+  if (!sorted_known_) {
+    sorted_ = true;
+    for (size_t i = 1; i < size_ && sorted_; ++i) {
+      sorted_ = index_of(first[i - 1]) < index_of(first[i]);
     }
-
-    DirectoryEntry entry(std::move(raw));
-    entries_.emplace(entry.index(), std::move(entry));
+    sorted_known_ = true;
   }
-
-  valid_ = true;
-  return true;
+  if (sorted_) {
+    auto const *p = std::lower_bound(
+        first, last, index, [&](VLRawDirectoryEntry const &raw, uint16_t i) {
+          return index_of(raw) < i;
+        });
+    return (p != last && index_of(*p) == index) ? p : nullptr;
+  }
+  auto const *p =
+      std::find_if(first, last, [&](VLRawDirectoryEntry const &raw) {
+        return index_of(raw) == index;
+      });
+  return (p != last) ? p : nullptr;
 }
 
-Directory
-Directory::Reader::get() const {
-  return Directory(std::move(hdr_), std::move(entries_));
+VLDirectoryEntry *_Nullable
+DecodeEntriesInPlace(
+    uint8_t *buffer, VLRawDirectoryEntry const *raw, size_t count) {
+  assert(reinterpret_cast<uint8_t const *>(raw) >= buffer);
+  if (reinterpret_cast<uintptr_t>(buffer) % alignof(VLDirectoryEntry) != 0) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    // Copy the record out first: entry i may overlap it.
+    VLRawDirectoryEntry record;
+    std::memcpy(&record, &raw[i], sizeof(record));
+    VLDirectoryEntry const entry = DirectoryEntry(record).entry();
+    std::memcpy(buffer + i * sizeof(entry), &entry, sizeof(entry));
+  }
+  return reinterpret_cast<VLDirectoryEntry *>(buffer);
 }
 
 } // namespace viv
@@ -0,0 +1,162 @@
+// directory_cache.cpp - persistent directory cache format
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/directory_cache.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "viv/directory.hpp"
+#include "viv/directory_cache.h"
+#include "viv/directory_query.hpp"
+#include "viv/endian.hpp"
+#include "viv/raw_directory.h"
+
+namespace {
+
+/// Magic number and version.  The version changes if the header does.
+constexpr uint8_t kFileMagic[] = {'V', 'I', 'V', 'D', 'I', 'R', 1, 0};
+
+// Offsets of the header fields.
+constexpr size_t kFetchedTimeOffset = 8;
+constexpr size_t kFingerprintOffset = 16;
+constexpr size_t kLengthOffset = 20;
+
+/// Largest directory: a header, and an entry for every 16-bit index.
+constexpr size_t kMaxDirectoryLength = 0x10000 * sizeof(VLRawDirectoryEntry);
+
+static_assert(
+    kLengthOffset + sizeof(uint32_t) <= viv::DirectoryCache::kHeaderLength,
+    "Cache header fields must fit in the header");
+
+static_assert(
+    viv::DirectoryCache::kHeaderLength % sizeof(VLRawDirectoryEntry) == 0,
+    "Cached entries should stay aligned to their size");
+
+} // namespace
+
+namespace viv {
+
+DirectoryCache::DirectoryCache(uint8_t const *src, size_t length) noexcept
+    : src_(src), length_(length),
+      directory_(
+          src + ((length < kHeaderLength) ? length : kHeaderLength),
+          (length < kHeaderLength) ? 0 : length - kHeaderLength) {
+  assert(src != nullptr);
+}
+
+int
+DirectoryCache::Read() {
+  if (length_ < kHeaderLength ||
+      std::memcmp(src_, kFileMagic, sizeof(kFileMagic) - 2)) {
+    return -1;
+  }
+  if (std::memcmp(src_, kFileMagic, sizeof(kFileMagic))) {
+    return -2;
+  }
+  uint32_t const length = OSReadLittleInt32(src_, kLengthOffset);
+  if (length != length_ - kHeaderLength) {
+    return -3;
+  }
+  if (!directory_.Read()) {
+    return -4;
+  }
+  uint32_t const fingerprint = OSReadLittleInt32(src_, kFingerprintOffset);
+  if (fingerprint != VLDirectoryFingerprint(src_ + kHeaderLength, length)) {
+    return -5;
+  }
+
+  uint64_t const fetched_time =
+      OSReadLittleInt32(src_, kFetchedTimeOffset) |
+      (uint64_t{OSReadLittleInt32(src_, kFetchedTimeOffset + 4)} << 32);
+  info_.device_time = directory_.header().time();
+  info_.fetched_time = static_cast<time_t>(fetched_time);
+  info_.fingerprint = fingerprint;
+  info_.entry_count = static_cast<uint32_t>(directory_.size());
+  return 0;
+}
+
+} // namespace viv
+
+size_t
+VLDirectoryCacheLength(size_t length) {
+  return viv::DirectoryCache::kHeaderLength + length;
+}
+
+int
+VLWriteDirectoryCache(
+    uint8_t *dst, size_t capacity, uint8_t const *directory, size_t length,
+    time_t fetched_time) {
+  assert(dst != nullptr);
+  assert(directory != nullptr);
+
+  if (length > kMaxDirectoryLength ||
+      capacity < VLDirectoryCacheLength(length)) {
+    return -1;
+  }
+  viv::DirectoryView view(directory, length);
+  if (!view.Read()) {
+    return -2;
+  }
+
+  uint8_t *const p = dst;
+  std::memset(p, 0, viv::DirectoryCache::kHeaderLength);
+  std::memcpy(p, kFileMagic, sizeof(kFileMagic));
+  uint64_t const time = static_cast<uint64_t>(fetched_time);
+  VLWriteLittleInt32(p, kFetchedTimeOffset, static_cast<uint32_t>(time));
+  VLWriteLittleInt32(
+      p, kFetchedTimeOffset + 4, static_cast<uint32_t>(time >> 32));
+  VLWriteLittleInt32(
+      p, kFingerprintOffset, VLDirectoryFingerprint(directory, length));
+  VLWriteLittleInt32(p, kLengthOffset, static_cast<uint32_t>(length));
+  std::memcpy(p + viv::DirectoryCache::kHeaderLength, directory, length);
+  return static_cast<int>(VLDirectoryCacheLength(length));
+}
+
+int
+VLReadDirectoryCache(
+    VLDirectoryCacheInfo *info, uint8_t const *src, size_t length) {
+  assert(info != nullptr);
+
+  viv::DirectoryCache cache(src, length);
+  int const status = cache.Read();
+  if (status < 0) {
+    return status;
+  }
+  *info = cache.info();
+  return 0;
+}
+
+int
+VLQueryDirectoryCache(
+    uint8_t const *src, size_t length, VLDirectoryQuery query,
+    void (*callback)(void *_Nullable ctx, VLDirectoryEntry entry),
+    void *_Nullable ctx) {
+  assert(callback != nullptr);
+
+  viv::DirectoryCache cache(src, length);
+  int const status = cache.Read();
+  if (status < 0) {
+    return status;
+  }
+  size_t const count = viv::DirectoryQuery(query).Run(
+      cache.directory(), [&](viv::DirectoryEntry const &entry) {
+        (*callback)(ctx, entry.entry());
+      });
+  return static_cast<int>(count);
+}
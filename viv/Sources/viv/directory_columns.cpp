@@ -0,0 +1,216 @@
+// directory_columns.cpp - bulk decoding of directory entries
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The vector paths load each entry's fields as host-order words, so they're
+// only used on little-endian hosts.  The intrinsics headers come first
+// because compat.h hides __attribute__ from GCC.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define VL_DIRECTORY_COLUMNS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VL_DIRECTORY_COLUMNS_NEON 1
+#endif
+#endif
+
+#include "viv/directory_columns.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "viv/directory.hpp"
+#include "viv/raw_directory.h"
+#include "viv/vivtime.h"
+
+namespace viv {
+
+namespace {
+
+static_assert(
+    sizeof(VLRawDirectoryEntry) == 16,
+    "The vector paths assume each entry is four 32-bit words");
+
+#if VL_DIRECTORY_COLUMNS_SSE2 || VL_DIRECTORY_COLUMNS_NEON
+static_assert(
+    sizeof(time_t) == sizeof(uint64_t),
+    "The vector paths widen times to 64 bits");
+#endif
+
+#if VL_DIRECTORY_COLUMNS_SSE2
+
+/// Decodes the four entries at \p src into element \p i onwards of \p columns.
+///
+/// \param epoch The POSIX time of the ANT epoch, in both 64-bit lanes.
+inline void
+DecodeBlock(
+    VLRawDirectoryEntry const *src, size_t i, DirectoryColumns const &columns,
+    __m128i epoch) {
+  auto const *p = reinterpret_cast<__m128i const *>(src);
+  __m128i const r0 = _mm_loadu_si128(p + 0);
+  __m128i const r1 = _mm_loadu_si128(p + 1);
+  __m128i const r2 = _mm_loadu_si128(p + 2);
+  __m128i const r3 = _mm_loadu_si128(p + 3);
+
+  // Transpose, so that register wN holds word N of each of the four entries.
+  __m128i const t0 = _mm_unpacklo_epi32(r0, r1);
+  __m128i const t1 = _mm_unpacklo_epi32(r2, r3);
+  __m128i const t2 = _mm_unpackhi_epi32(r0, r1);
+  __m128i const t3 = _mm_unpackhi_epi32(r2, r3);
+  __m128i const w0 = _mm_unpacklo_epi64(t0, t1);
+  __m128i const w1 = _mm_unpackhi_epi64(t0, t1);
+  __m128i const w2 = _mm_unpacklo_epi64(t2, t3);
+  __m128i const w3 = _mm_unpackhi_epi64(t2, t3);
+
+  // Word 0 is the index in its low half and the type in its high half.
+  // Sign-extending each half lets the saturating pack keep all 16 bits.
+  __m128i const halves = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_slli_epi32(w0, 16), 16), _mm_srai_epi32(w0, 16));
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(columns.index + i), halves);
+  _mm_storel_epi64(
+      reinterpret_cast<__m128i *>(columns.file_type + i),
+      _mm_unpackhi_epi64(halves, halves));
+
+  // The flags are the top byte of word 1.
+  __m128i const flags16 =
+      _mm_packs_epi32(_mm_srli_epi32(w1, 24), _mm_setzero_si128());
+  __m128i const flags8 = _mm_packus_epi16(flags16, flags16);
+  uint32_t const flags = static_cast<uint32_t>(_mm_cvtsi128_si32(flags8));
+  std::memcpy(columns.flags + i, &flags, sizeof(flags));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(columns.length + i), w2);
+
+  // Widen the times to 64 bits before adding the epoch.
+  __m128i const zero = _mm_setzero_si128();
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i *>(columns.posix_time + i),
+      _mm_add_epi64(_mm_unpacklo_epi32(w3, zero), epoch));
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i *>(columns.posix_time + i + 2),
+      _mm_add_epi64(_mm_unpackhi_epi32(w3, zero), epoch));
+}
+
+/// Decodes entries four at a time.
+///
+/// \return The number of entries decoded.
+size_t
+DecodeVector(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns) {
+  __m128i const epoch =
+      _mm_set1_epi64x(static_cast<int64_t>(VLGetPosixTimeFromViva(0)));
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    DecodeBlock(entries + i, i, columns, epoch);
+  }
+  return i;
+}
+
+#elif VL_DIRECTORY_COLUMNS_NEON
+
+/// Decodes the four entries at \p src into element \p i onwards of \p columns.
+///
+/// \param epoch The POSIX time of the ANT epoch, in both 64-bit lanes.
+inline void
+DecodeBlock(
+    VLRawDirectoryEntry const *src, size_t i, DirectoryColumns const &columns,
+    uint64x2_t epoch) {
+  // De-interleave, so that w.val[N] holds word N of each of the four entries.
+  uint32x4x4_t const w = vld4q_u32(reinterpret_cast<uint32_t const *>(src));
+
+  // Word 0 is the index in its low half and the type in its high half.
+  vst1_u16(columns.index + i, vmovn_u32(w.val[0]));
+  vst1_u16(columns.file_type + i, vshrn_n_u32(w.val[0], 16));
+
+  // The flags are the top byte of word 1.
+  uint16x4_t const flags16 = vmovn_u32(vshrq_n_u32(w.val[1], 24));
+  uint8x8_t const flags8 = vmovn_u16(vcombine_u16(flags16, flags16));
+  uint32_t const flags = vget_lane_u32(vreinterpret_u32_u8(flags8), 0);
+  std::memcpy(columns.flags + i, &flags, sizeof(flags));
+
+  vst1q_u32(columns.length + i, w.val[2]);
+
+  // Widen the times to 64 bits while adding the epoch.
+  uint64x2_t const lo = vaddw_u32(epoch, vget_low_u32(w.val[3]));
+  uint64x2_t const hi = vaddw_u32(epoch, vget_high_u32(w.val[3]));
+  std::memcpy(columns.posix_time + i, &lo, sizeof(lo));
+  std::memcpy(columns.posix_time + i + 2, &hi, sizeof(hi));
+}
+
+/// Decodes entries four at a time.
+///
+/// \return The number of entries decoded.
+size_t
+DecodeVector(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns) {
+  uint64x2_t const epoch =
+      vdupq_n_u64(static_cast<uint64_t>(VLGetPosixTimeFromViva(0)));
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    DecodeBlock(entries + i, i, columns, epoch);
+  }
+  return i;
+}
+
+#else
+
+size_t
+DecodeVector(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns) {
+  return 0;
+}
+
+#endif
+
+} // namespace
+
+#if VL_DIRECTORY_COLUMNS_SSE2 || VL_DIRECTORY_COLUMNS_NEON
+bool const kHasVectorDirectoryDecoder = true;
+#else
+bool const kHasVectorDirectoryDecoder = false;
+#endif
+
+void
+DecodeDirectoryColumns(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns) {
+  size_t const decoded = DecodeVector(entries, count, columns);
+  DirectoryColumns const rest{
+      columns.index + decoded, columns.file_type + decoded,
+      columns.flags + decoded, columns.length + decoded,
+      columns.posix_time + decoded};
+  DecodeDirectoryColumnsScalar(entries + decoded, count - decoded, rest);
+}
+
+void
+DecodeDirectoryColumnsScalar(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns) {
+  for (size_t i = 0; i < count; ++i) {
+    DirectoryEntry const entry(entries[i]);
+    columns.index[i] = entry.index();
+    columns.file_type[i] = entry.file_type();
+    columns.flags[i] = entry.raw_entry().flags;
+    columns.length[i] = entry.length();
+    columns.posix_time[i] = entry.time();
+  }
+}
+
+} // namespace viv
@@ -0,0 +1,115 @@
+// directory_query.cpp - filtering and ordering directory entries
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/directory_query.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/directory.hpp"
+#include "viv/directory_query.h"
+
+namespace viv {
+
+static_assert(
+    uint8_t{kVLFileFlagErasable} == uint8_t{kErasable} &&
+        uint8_t{kVLFileFlagReadable} == uint8_t{kReadable},
+    "VLFileFlags must match FileFlags");
+
+namespace {
+
+/// Returns the sort key of \p entry for \p order; smaller keys come first.
+int64_t
+Key(DirectoryEntry const &entry, VLDirectoryOrder order) {
+  switch (order) {
+  case kVLDirectoryOrderNewest:
+    return -static_cast<int64_t>(entry.time());
+  case kVLDirectoryOrderOldest:
+    return static_cast<int64_t>(entry.time());
+  case kVLDirectoryOrderLargest:
+    return -static_cast<int64_t>(entry.length());
+  default:
+    return 0;
+  }
+}
+
+} // namespace
+
+bool
+DirectoryQuery::Matches(DirectoryEntry const &entry) const {
+  if (query_.file_type != 0 && entry.file_type() != query_.file_type) {
+    return false;
+  }
+  uint8_t const flags = entry.raw_entry().flags;
+  if ((flags & query_.required_flags) != query_.required_flags) {
+    return false;
+  }
+  time_t const time = entry.time();
+  if (time < query_.min_posix_time ||
+      (query_.max_posix_time != 0 && time > query_.max_posix_time)) {
+    return false;
+  }
+  uint32_t const length = entry.length();
+  return length >= query_.min_length &&
+         (query_.max_length == 0 || length <= query_.max_length);
+}
+
+size_t
+DirectoryQuery::Select(VLRawDirectoryEntry *entries, size_t size) const {
+  size_t const limit = (query_.limit == 0) ? size : query_.limit;
+  size_t selected = 0;
+  if (query_.order == kVLDirectoryOrderDirectory) {
+    for (size_t i = 0; i < size && selected < limit; ++i) {
+      if (Matches(DirectoryEntry(entries[i]))) {
+        entries[selected++] = entries[i];
+      }
+    }
+    return selected;
+  }
+
+  // entries[0, selected) stays sorted, and never holds more than the limit.
+  // Only the matches seen so far are overwritten, so entries[i] is intact.
+  for (size_t i = 0; i < size; ++i) {
+    VLRawDirectoryEntry const raw = entries[i];
+    if (!Matches(DirectoryEntry(raw))) {
+      continue;
+    }
+    int64_t const key = Key(DirectoryEntry(raw), query_.order);
+    size_t j;
+    if (selected < limit) {
+      j = selected++;
+    } else if (Key(DirectoryEntry(entries[limit - 1]), query_.order) > key) {
+      j = limit - 1;
+    } else {
+      continue;
+    }
+    // Stable, so ties stay in directory order.
+    for (; j > 0 && Key(DirectoryEntry(entries[j - 1]), query_.order) > key;
+         --j) {
+      entries[j] = entries[j - 1];
+    }
+    entries[j] = raw;
+  }
+  return selected;
+}
+
+bool
+DirectoryQuery::Before(DirectoryView const &dir, size_t i, size_t j) const {
+  int64_t const a = Key(dir[i], query_.order);
+  int64_t const b = Key(dir[j], query_.order);
+  return a < b || (a == b && i < j);
+}
+
+} // namespace viv
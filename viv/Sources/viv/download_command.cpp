@@ -1,4 +1,4 @@
-// erase_command.cpp - Viiiiva download commands
+// download_command.cpp - Viiiiva download commands
 // Copyright 2020 Dean Scarff
 //
 // Licensed under the Apache License, Version 2.0 (the "License");
@@ -15,15 +15,16 @@
 
 #include "viv/download_command.hpp"
 
-#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
-#include <iterator>
+#include <utility>
+#include <vector>
 
 #include "viv/burst.hpp"
 #include "viv/endian.hpp"
 #include "viv/packet.h"
+#include "viv/trace.h"
 
 namespace {
 
@@ -49,10 +50,41 @@ namespace viv {
 
 DownloadCommand::DownloadCommand(
     uint16_t index, uint32_t offset, uint32_t length,
+    uint8_t *_Nullable buffer, size_t capacity,
     OnFinishCallback on_finish) noexcept
-    : CommandWithReply(kCommandDownload, kCommandDownloadReply),
-      on_finish_(std::move(on_finish)), offset_(offset), length_(length),
-      index_(index) {}
+    : CommandWithReply(kCommandDownload, kCommandDownloadReply), buf_(buffer),
+      capacity_(capacity), on_finish_(on_finish), offset_(offset),
+      length_limit_(length), index_(index) {
+  assert(!VL_NO_HEAP || buffer != nullptr);
+}
+
+uint8_t const *_Nullable
+DownloadCommand::buffer() const {
+#if !VL_NO_HEAP
+  if (buf_ == nullptr) {
+    return owned_buf_.data();
+  }
+#endif
+  return buf_;
+}
+
+uint8_t *_Nullable
+DownloadCommand::buffer() {
+#if !VL_NO_HEAP
+  if (buf_ == nullptr) {
+    return owned_buf_.data();
+  }
+#endif
+  return buf_;
+}
+
+#if !VL_NO_HEAP
+std::vector<uint8_t>
+DownloadCommand::TakeBuffer() {
+  assert(owns_buffer());
+  return std::move(owned_buf_);
+}
+#endif
 
 VLPacket
 DownloadCommand::MakeCommandPacket() const {
@@ -61,7 +93,7 @@ DownloadCommand::MakeCommandPacket() const {
 
   p += VLWriteLittleInt16(p, 0, index_);
   p += VLWriteLittleInt32(p, 0, offset_);
-  VLWriteLittleInt32(p, 0, length_);
+  VLWriteLittleInt32(p, 0, length_limit_);
 
   return VLMakePacket(kVLSeqnoEnd, kCommandDownload, payload, sizeof(payload));
 }
@@ -74,14 +106,24 @@ DownloadCommand::ReadAck(VLPacket const &packet) {
   }
   uint32_t const length = OSReadLittleInt32(packet.payload, 6);
   if ((index_ != OSReadLittleInt16(packet.payload, 0)) ||
-      (offset_ != OSReadLittleInt32(packet.payload, 2)) || (length > length_)) {
+      (offset_ != OSReadLittleInt32(packet.payload, 2)) ||
+      (length > length_limit_)) {
     return -3;
   }
-  if (index_ == kDirectoryIndex) {
-    buf_.reserve(length * kDirectoryRecordLength);
+  size_t const expected_length = (index_ == kDirectoryIndex)
+                                     ? length * kDirectoryRecordLength
+                                     : length;
+  if (buf_ != nullptr) {
+    if (expected_length > capacity_) {
+      return -4;
+    }
   } else {
-    buf_.reserve(length);
+#if !VL_NO_HEAP
+    owned_buf_.reserve(expected_length);
+#endif
   }
+  VL_TRACE4(download_ack, this, index_, offset_, expected_length);
+  expected_length_ = expected_length;
   has_ack_ = true;
   return 0;
 }
@@ -95,20 +137,40 @@ DownloadCommand::ReadReply(VLPacket const &packet) {
 
   auto const burst = burst_.ReadPacket(packet);
   if (!burst.IsValid()) {
-    return -2;
+    return kReadPacketSeqnoError;
+  }
+  if (!Append(packet.payload, packet.payload_length)) {
+    return -3;
   }
   burst_ = std::move(burst);
 
-  std::copy(
-      packet.payload, packet.payload + packet.payload_length,
-      std::back_inserter(buf_));
-
   return packet.payload_length;
 }
 
 bool
-DownloadCommand::MaybeFinish() const {
-  if (has_ack_ && burst_.HasEnded()) {
+DownloadCommand::Append(uint8_t const *data, size_t length) {
+  if (buf_ == nullptr) {
+#if VL_NO_HEAP
+    return false;
+#else
+    owned_buf_.insert(owned_buf_.end(), data, data + length);
+    length_ = owned_buf_.size();
+    return true;
+#endif
+  }
+
+  if (length > capacity_ - length_) {
+    return false;
+  }
+  std::memcpy(buf_ + length_, data, length);
+  length_ += length;
+  return true;
+}
+
+bool
+DownloadCommand::MaybeFinish() {
+  if (has_ack_ && (burst_.HasEnded() || expected_length_ == 0)) {
+    VL_TRACE3(download_finish, this, index_, length());
     on_finish_(index_, buffer(), length());
     return true;
   }
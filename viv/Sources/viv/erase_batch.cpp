@@ -0,0 +1,97 @@
+// erase_batch.cpp - state for erasing a set of files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/erase_batch.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/erase_result.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+bool
+EraseBatch::Start(uint16_t const *indices, size_t count) {
+  Clear();
+  if (count > kMaxFiles) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    files_[i] = File{indices[i], false, false};
+  }
+  count_ = count;
+  active_ = true;
+  return true;
+}
+
+void
+EraseBatch::Clear() {
+  count_ = 0;
+  next_ = 0;
+  active_ = false;
+  verifying_ = false;
+  verified_ = false;
+}
+
+bool
+EraseBatch::Next(uint16_t &index) {
+  if (next_ >= count_) {
+    return false;
+  }
+  index = files_[next_++].index;
+  return true;
+}
+
+void
+EraseBatch::DidErase(uint16_t index, bool ok) {
+  for (size_t i = 0; i < next_; ++i) {
+    if (files_[i].index == index) {
+      files_[i].ok = ok;
+    }
+  }
+}
+
+void
+EraseBatch::DidFindFile(uint16_t index) {
+  for (size_t i = 0; i < count_; ++i) {
+    if (files_[i].index == index) {
+      files_[i].present = true;
+    }
+  }
+}
+
+VLEraseResult const *
+EraseBatch::Finish(size_t &count) {
+  for (size_t i = 0; i < count_; ++i) {
+    File const &file = files_[i];
+    VLEraseOutcome outcome;
+    if (!verified_) {
+      outcome = file.ok ? kVLEraseOutcomeErased : kVLEraseOutcomeFailed;
+    } else if (!file.present) {
+      outcome = kVLEraseOutcomeErased;
+    } else {
+      outcome = file.ok ? kVLEraseOutcomeStillPresent : kVLEraseOutcomeFailed;
+    }
+    results_[i] = VLEraseResult{file.index, outcome};
+  }
+  count = count_;
+  return results_;
+}
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
@@ -31,7 +31,7 @@ namespace viv {
 
 EraseCommand::EraseCommand(uint16_t index, OnFinishCallback on_finish) noexcept
     : CommandWithReply(kCommandErase, kCommandEraseReply),
-      on_finish_(std::move(on_finish)), index_(index) {}
+      on_finish_(on_finish), index_(index) {}
 
 VLPacket
 EraseCommand::MakeCommandPacket() const {
@@ -56,9 +56,9 @@ EraseCommand::ReadReply(VLPacket const &packet) {
 }
 
 bool
-EraseCommand::MaybeFinish() const {
+EraseCommand::MaybeFinish() {
   if (has_ack_ && is_finished_) {
-    on_finish_(is_ok_);
+    on_finish_(index_, is_ok_);
     return true;
   }
 
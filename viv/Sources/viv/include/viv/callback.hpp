@@ -0,0 +1,101 @@
+// callback.hpp - non-owning callbacks
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_callback_hpp
+#define viv_callback_hpp
+
+#include <type_traits>
+#include <utility>
+
+#include "viv/compat.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+template <typename Signature> class Callback;
+
+/// Non-owning reference to a function.
+///
+/// Unlike \c std::function, a Callback never allocates: it is a C-style
+/// function pointer plus an opaque context pointer, much like the callbacks in
+/// VLManagerDelegate.  Whatever the context points to must outlive the
+/// Callback.
+///
+/// A default-constructed Callback does nothing when called (and returns a
+/// value-initialized result).
+template <typename R, typename... Args> class Callback<R(Args...)> {
+public:
+  /// C-style function that receives the context as its first parameter.
+  using Function = R (*)(void *_Nullable ctx, Args...);
+
+  constexpr Callback() noexcept : function_(nullptr), ctx_(nullptr) {}
+
+  /// Wraps \p function, which will be called with \p ctx.
+  constexpr Callback(Function function, void *_Nullable ctx) noexcept
+      : function_(function), ctx_(ctx) {}
+
+  /// References \p callable, which must outlive this Callback.
+  template <
+      typename F,
+      typename = ::std::enable_if_t<
+          !::std::is_same<::std::remove_cv_t<F>, Callback>::value>>
+  Callback(F &callable) noexcept
+      : function_(&InvokeCallable<F>),
+        ctx_(const_cast<void *>(static_cast<void const *>(&callable))) {}
+
+  /// Temporaries would dangle; bind an lvalue instead.
+  template <
+      typename F,
+      typename = ::std::enable_if_t<
+          !::std::is_same<::std::decay_t<F>, Callback>::value>>
+  Callback(F &&callable) = delete;
+
+  /// Returns a callback that calls \p Method on \p object.
+  template <auto Method, typename T>
+  static constexpr Callback Bind(T &object) noexcept {
+    return Callback(&InvokeMethod<T, Method>, &object);
+  }
+
+  R operator()(Args... args) const {
+    if (function_ == nullptr) {
+      return R();
+    }
+    return (*function_)(ctx_, ::std::forward<Args>(args)...);
+  }
+
+  /// True unless this is a default-constructed (no-op) callback.
+  explicit operator bool() const { return function_ != nullptr; }
+
+private:
+  template <typename F>
+  static R InvokeCallable(void *_Nullable ctx, Args... args) {
+    return (*static_cast<F *>(ctx))(::std::forward<Args>(args)...);
+  }
+
+  template <typename T, auto Method>
+  static R InvokeMethod(void *_Nullable ctx, Args... args) {
+    return (static_cast<T *>(ctx)->*Method)(::std::forward<Args>(args)...);
+  }
+
+  Function _Nullable function_;
+  void *_Nullable ctx_;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_callback_hpp */
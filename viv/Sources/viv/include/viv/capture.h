@@ -0,0 +1,74 @@
+// capture.h - C interface for capturing manager sessions
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_capture_h
+#define viv_capture_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#include "viv/compat.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// Appends a binary record of a manager's session to a sink.
+///
+/// This is an opaque type, like VLCProtocolManager.  Attach it to a manager
+/// with VLManagerSetCaptureWriter, and replay the result with
+/// VLManagerReplayCapture.
+typedef struct {
+  // Opaque pointer to C++ object.
+  void *_Nullable writer;
+} VLCaptureWriter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Creates a capture writer.
+///
+/// The caller takes ownership of the pointer, and must call
+/// VLDeleteCaptureWriter.
+///
+/// \param ctx Arbitrary pointer passed to \p write and \p now.
+/// \param write Appends \p length bytes from \p data to the capture; returns
+/// non-zero on error, after which nothing more is written.
+/// \param now Returns the time from a monotonic clock, in arbitrary units.
+extern VLCaptureWriter VLMakeCaptureWriter(
+    void *_Nullable ctx,
+    int (*write)(void *_Nullable ctx, uint8_t const *data, size_t length),
+    uint64_t (*now)(void *_Nullable ctx))
+    CF_SWIFT_NAME(VLCaptureWriter.init(ctx:write:now:));
+
+/// Deletes a writer previously created with VLMakeCaptureWriter.
+extern void VLDeleteCaptureWriter(VLCaptureWriter writer)
+    CF_SWIFT_NAME(VLCaptureWriter.deinitialize(self:));
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_capture_h */
@@ -0,0 +1,199 @@
+// capture.hpp - binary capture of manager sessions
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_capture_hpp
+#define viv_capture_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include "viv/callback.hpp"
+#include "viv/compat.h"
+#include "viv/directory_query.h"
+#include "viv/packet.h"
+
+/// \file
+/// A capture is a file header followed by a sequence of records, one for each
+/// value that crossed the manager's boundary and one for each command the
+/// client issued.
+///
+/// The file header is the 6 bytes "VIVCAP", a version byte (2) and a reserved
+/// zero byte.  Each record is:
+///
+/// - a byte with the CaptureEventType in bits 0-1 and the value's length in
+///   bits 2-7;
+/// - the time since the previous record (or since zero, for the first
+///   record), as an unsigned LEB128 varint; and
+/// - the value itself.
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// The kind of a captured record.
+enum CaptureEventType : uint8_t {
+  /// A GATT value notification passed to Manager::NotifyValue.
+  kCaptureNotifyValue = 0,
+
+  /// A value passed to ManagerDelegate::WriteValue.
+  kCaptureWriteValue = 1,
+
+  /// A call to Manager::NotifyTimeout (with no value).
+  kCaptureTimeout = 2,
+
+  /// A call to one of Manager's command methods.  The value is a CaptureCall
+  /// followed by the call's arguments.
+  kCaptureCall = 3,
+};
+
+/// The Manager method recorded by a kCaptureCall record.
+///
+/// Arguments are little-endian; a time_t is written as 8 bytes.
+enum CaptureCall : uint8_t {
+  /// DownloadDirectory (no arguments).
+  kCaptureCallDownloadDirectory = 0,
+
+  /// DownloadDirectoryIfChanged (uint32_t fingerprint).
+  kCaptureCallDownloadDirectoryIfChanged = 1,
+
+  /// ProbeDirectory (uint16_t max_entries, uint16_t known_entries).
+  kCaptureCallProbeDirectory = 2,
+
+  /// DownloadDirectoryPage (uint16_t first_entry, uint16_t max_entries).
+  kCaptureCallDownloadDirectoryPage = 3,
+
+  /// QueryDirectory (the VLDirectoryQuery's fields, in declaration order).
+  kCaptureCallQueryDirectory = 4,
+
+  /// DownloadFile (uint16_t index, uint32_t offset).
+  kCaptureCallDownloadFile = 5,
+
+  /// EraseFile (uint16_t index).
+  kCaptureCallEraseFile = 6,
+
+  /// Part of an EraseFiles call: a byte that is non-zero if more parts
+  /// follow, then some of the uint16_t indices.  A batch too large for one
+  /// record is split over consecutive records.
+  kCaptureCallEraseFiles = 7,
+
+  /// SetTime (time_t posix_time).
+  kCaptureCallSetTime = 8,
+};
+
+/// Maximum length of a record's value.  Only call records may be longer
+/// than kVLPacketMaxLength.
+constexpr size_t kCaptureMaxValueLength = 63;
+
+/// Length of a kCaptureCallQueryDirectory record's arguments.
+constexpr size_t kCaptureQueryLength = 30;
+
+/// Writes \p posix_time to the memory at `p + offset`, as a call argument.
+///
+/// \return The number of bytes written.
+size_t WriteCaptureTime(uint8_t *p, size_t offset, time_t posix_time);
+
+/// Returns the time written by WriteCaptureTime at `p + offset`.
+time_t ReadCaptureTime(uint8_t const *p, size_t offset);
+
+/// Writes \p query to the kCaptureQueryLength bytes at \p p.
+void WriteCaptureQuery(uint8_t *p, VLDirectoryQuery const &query);
+
+/// Returns the query written by WriteCaptureQuery at \p p.
+VLDirectoryQuery ReadCaptureQuery(uint8_t const *p);
+
+/// A record read from a capture.
+struct CaptureEvent {
+  CaptureEventType type;
+
+  /// Timestamp from the capture's clock.
+  uint64_t time;
+
+  /// Number of bytes in \c value.
+  uint8_t length;
+
+  uint8_t value[kCaptureMaxValueLength];
+};
+
+/// Appends records to a capture.
+///
+/// Records are serialized on the stack and passed to a sink callback (e.g. one
+/// that calls fwrite), so recording does not allocate.
+class CaptureWriter {
+public:
+  /// Appends \p length bytes to the capture; returns non-zero on error.
+  using Sink = Callback<int(uint8_t const *data, size_t length)>;
+
+  /// Returns the time from a monotonic clock, in arbitrary units.
+  using Clock = Callback<uint64_t()>;
+
+  CaptureWriter(Sink sink, Clock clock) noexcept
+      : sink_(sink), clock_(clock) {}
+
+  // Disallow copy/move semantics.
+  CaptureWriter(const CaptureWriter &) = delete;
+  CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+  /// Appends a record, preceded by the file header if this is the first.
+  ///
+  /// Values longer than kCaptureMaxValueLength are truncated.  Once the sink
+  /// has failed, records are dropped.
+  void Record(
+      CaptureEventType type, uint8_t const *_Nullable value, size_t length);
+
+  /// Returns false if the sink has failed.
+  bool ok() const { return ok_; }
+
+private:
+  Sink const sink_;
+  Clock const clock_;
+
+  /// Time of the previous record.
+  uint64_t last_time_ = 0;
+
+  /// True once the file header has been written.
+  bool started_ = false;
+
+  bool ok_ = true;
+};
+
+/// Reads records from a capture in memory.
+class CaptureReader {
+public:
+  /// \param data The whole capture, including the file header.  Not owned;
+  /// must outlive the reader.
+  CaptureReader(uint8_t const *data, size_t length) noexcept
+      : data_(data), end_(data + length), pos_(data) {}
+
+  /// Reads the next record into \p event.
+  ///
+  /// \return 1 if a record was read, 0 at the end of the capture, or negative
+  /// if the capture is malformed.
+  int Next(CaptureEvent &event);
+
+private:
+  uint8_t const *const data_;
+  uint8_t const *const end_;
+  uint8_t const *pos_;
+
+  /// Timestamp of the previous record.
+  uint64_t time_ = 0;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_capture_hpp */
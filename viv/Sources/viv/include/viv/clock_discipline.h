@@ -0,0 +1,134 @@
+// clock_discipline.h - deciding when and how to set the Viiiiva's clock
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_clock_discipline_h
+#define viv_clock_discipline_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <ctime>
+#else
+#include <stdint.h>
+#include <time.h>
+#endif
+
+#include "viv/compat.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// Tuning for the VLClock functions.
+struct VLClockOptions {
+  /// Offset, in seconds, beyond which the Viiiiva's clock should be set.
+  double threshold;
+
+  /// Weight given to each new drift observation, between 0 and 1.
+  double gain;
+
+  /// Minimum seconds between setting the clock and an observation for the
+  /// observation to update the drift estimate.  Over short intervals, the
+  /// clock's one-second resolution swamps any drift.
+  double min_interval;
+};
+typedef struct VLClockOptions VLClockOptions;
+
+/// What is known about one Viiiiva's clock.
+///
+/// This is plain data: clients should persist one per device between
+/// sessions, starting from a zeroed struct.
+struct VLClockState {
+  /// Host time (seconds since 1970-01-01) at which the clock was last set, or
+  /// 0 if it never has been.
+  double set_time;
+
+  /// Estimated rate at which the Viiiiva's clock gains on the host's, in
+  /// seconds per second.
+  double drift;
+
+  /// Number of observations in the drift estimate.
+  uint32_t samples;
+};
+typedef struct VLClockState VLClockState;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Returns the default options: a two second threshold, and drift observed
+/// over at least six hours.
+extern VLClockOptions VLClockDefaultOptions(void)
+    CF_SWIFT_NAME(VLClockOptions.init());
+
+/// Estimates how far the Viiiiva's clock is ahead of the host's.
+///
+/// The Viiiiva samples its clock for the directory header about half a round
+/// trip after the command is written, and truncates it to whole seconds.
+///
+/// \param device_time The clock from the directory header (see
+/// \c did_parse_clock).
+/// \param sent Host time at which the directory command was written.
+/// \param rtt Round trip time of the command's acknowledgement, in seconds.
+/// \return The offset in seconds; negative if the Viiiiva is behind.
+extern double VLClockMeasureOffset(time_t device_time, double sent, double rtt)
+    CF_SWIFT_NAME(VLClockState.measureOffset(deviceTime:sent:rtt:));
+
+/// Predicts how far the Viiiiva's clock is ahead of the host's at
+/// \p host_time, from the drift since it was last set.
+///
+/// \return The predicted offset in seconds, or 0 if the clock has never been
+/// set.
+extern double
+VLClockPredictOffset(VLClockState const *state, double host_time)
+    CF_SWIFT_NAME(VLClockState.predictOffset(self:hostTime:));
+
+/// Updates the drift estimate in \p state with an offset measured at
+/// \p host_time.
+///
+/// Observations too soon after the clock was set are ignored.
+extern void VLClockObserve(
+    VLClockState *state, VLClockOptions const *options, double host_time,
+    double offset)
+    CF_SWIFT_NAME(VLClockState.observe(self:options:hostTime:offset:));
+
+/// Returns non-zero if the Viiiiva's clock should be set at \p host_time.
+///
+/// \param offset An offset from VLClockMeasureOffset, or NAN if the directory
+/// hasn't been read, in which case the offset is predicted from the drift.
+extern int VLClockShouldSet(
+    VLClockState const *state, VLClockOptions const *options, double host_time,
+    double offset)
+    CF_SWIFT_NAME(VLClockState.shouldSet(self:options:hostTime:offset:));
+
+/// Returns the time to send in a set-time command written at \p host_time,
+/// so that the Viiiiva's clock is right when the command arrives.
+///
+/// \param rtt Round trip time of a recent acknowledgement, in seconds.
+extern time_t VLClockCompensatedTime(double host_time, double rtt)
+    CF_SWIFT_NAME(VLClockState.compensatedTime(hostTime:rtt:));
+
+/// Records in \p state that the clock was set at \p host_time.
+extern void VLClockDidSet(VLClockState *state, double host_time)
+    CF_SWIFT_NAME(VLClockState.didSet(self:hostTime:));
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_clock_discipline_h */
@@ -17,12 +17,15 @@
 #define viv_command_hpp
 
 #include <cstdint>
-#include <string>
 
 #include "viv/packet.h"
 
 namespace viv {
 
+/// Returned by Command::ReadPacket for a burst packet with an unexpected
+/// sequence number.
+constexpr int kReadPacketSeqnoError = -8;
+
 /// Pure virtual interface for a command sent to a Viiiiva.
 class Command {
 public:
@@ -37,8 +40,8 @@ public:
   /// Creates a write packet for sending to Viiiiva.
   virtual VLPacket MakeCommandPacket() const = 0;
 
-  /// Returns a name for the command (for error messages etc.).
-  virtual ::std::string name() const = 0;
+  /// Returns a static name for the command (for error messages etc.).
+  virtual char const *name() const = 0;
 
   /// Read a GATT value notification packet.
   ///
@@ -48,6 +51,9 @@ public:
   /// \return 0 for packets that were expected for this command.
   virtual int ReadPacket(const VLPacket &packet) = 0;
 
+  /// Returns true once the acknowledgement has been read.
+  virtual bool has_ack() const = 0;
+
   /// Checks if the command is finished, and trigger any callbacks.
   ///
   /// The command is finished if it is not expecting to read more packets (e.g.
@@ -55,7 +61,7 @@ public:
   /// error state.
   ///
   /// \return True unless the command is still expecting a response.
-  virtual bool MaybeFinish() const = 0;
+  virtual bool MaybeFinish() = 0;
 };
 
 /// Skeleton implementation for a command that expects both an acknowledgement
@@ -71,8 +77,10 @@ public:
     return has_ack_ ? ReadReply(packet) : ReadAck(packet);
   }
 
+  bool has_ack() const override { return has_ack_; }
+
   /// Returns true unless more response packets are expected.
-  virtual bool MaybeFinish() const override = 0;
+  virtual bool MaybeFinish() override = 0;
 
   /// Returns true if reply packets should be acknowledged.
   virtual bool ShouldAckReply() const { return false; }
@@ -49,6 +49,9 @@
 // https://developer.apple.com/documentation/swift/objective-c_and_c_code_customization/customizing_your_c_code_for_swift
 #if !defined(CF_SWIFT_NAME) && __has_attribute(swift_name)
 #define CF_SWIFT_NAME(_sel) __attribute__((swift_name(#_sel)))
+#elif !defined(CF_SWIFT_NAME)
+/// Empty fallback for compilers without Swift attributes (e.g. GCC).
+#define CF_SWIFT_NAME(_sel)
 #endif
 
 // VL_ENUM(type, tag) substitutes part of an enum specifier.
@@ -93,4 +96,12 @@
 #error "Conflicting debug definitions: DEBUG is true and NDEBUG is defined"
 #endif /* DEBUG && defined(NDEBUG) */
 
+// If VL_NO_HEAP is true, viv::Manager does not allocate from the heap after
+// it has been constructed.  Downloads are accumulated in a buffer supplied by
+// the caller, and directories are parsed in place.  APIs that would need the
+// heap (such as the Manager constructor without a buffer) are not declared.
+#ifndef VL_NO_HEAP
+#define VL_NO_HEAP 0
+#endif /* ndef VL_NO_HEAP */
+
 #endif /* viv_compat_h */
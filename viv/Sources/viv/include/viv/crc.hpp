@@ -33,6 +33,14 @@ namespace viv {
 ///   check=0xf4, residue=0.
 uint8_t crc(uint8_t const *data, size_t length);
 
+/// Return the CRC-32 used for records that libviv persists.
+///
+/// It is the common (zlib) CRC-32:
+///
+///   width=32, poly=0x04c11db7, init=0xffffffff, refin=true, refout=true,
+///   xorout=0xffffffff, check=0xcbf43926.
+uint32_t crc32(uint8_t const *data, size_t length);
+
 } // namespace viv
 
 #pragma clang assume_nonnull end
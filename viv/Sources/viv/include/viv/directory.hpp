@@ -16,10 +16,10 @@
 #ifndef viv_directory_hpp
 #define viv_directory_hpp
 
+#include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <ctime>
-#include <map>
 #include <utility>
 
 #include "compat.h"
@@ -96,50 +96,95 @@ private:
   VLRawDirectoryHeader const header_;
 };
 
-/// Encapsulates the entries of a directory.
-class Directory {
+/// Read-only view of a directory response, over the downloaded buffer.
+///
+/// The header is validated once by \c Read; entries are then decoded directly
+/// from the buffer as they're accessed, so the view never allocates.  Lookups
+/// by index use a binary search if the entries are sorted by index (as the
+/// Viiiiva sends them), or a linear search otherwise.  Whether they're sorted
+/// is checked on the first lookup, so \c Read doesn't touch the entries.
+class DirectoryView {
 public:
-  class Reader;
+  /// Forward iterator over the entries in the buffer.
+  class Iterator {
+  public:
+    explicit Iterator(VLRawDirectoryEntry const *p) noexcept : p_(p) {}
 
-  explicit Directory(
-      VLRawDirectoryHeader header,
-      ::std::map<uint16_t, DirectoryEntry> entries) noexcept
-      : header_(::std::move(header)), entries_(::std::move(entries)) {}
+    DirectoryEntry operator*() const { return DirectoryEntry(*p_); }
 
-  const DirectoryHeader &header() const { return header_; }
+    Iterator &operator++() {
+      ++p_;
+      return *this;
+    }
 
-  const ::std::map<uint16_t, DirectoryEntry> &entries() const {
-    return entries_;
-  }
+    bool operator==(Iterator const &other) const { return p_ == other.p_; }
+    bool operator!=(Iterator const &other) const { return p_ != other.p_; }
 
-private:
-  DirectoryHeader header_;
-  ::std::map<uint16_t, DirectoryEntry> entries_;
-};
+  private:
+    VLRawDirectoryEntry const *p_;
+  };
 
-/// Reads a directory response from a buffer.
-class Directory::Reader {
-public:
-  explicit Reader(uint8_t const *src, size_t length) noexcept;
+  /// Creates a view of \p src, which must outlive the view.
+  ///
+  /// \param length Size of \p src in bytes.
+  explicit DirectoryView(uint8_t const *src, size_t length) noexcept;
 
-  /// Reads the buffer.
+  /// Validates the header and the length of the buffer.
   ///
-  /// \return Whether the directory was read successfully.
+  /// \return Whether the directory is valid.  The other methods should only be
+  /// called if it is.
   bool Read();
 
-  /// Returns a directory wrapper, invalidating this object.
-  ///
-  /// Should only be called if \c Read() returned true.
-  Directory get() const;
+  DirectoryHeader header() const { return DirectoryHeader(header_); }
+
+  /// Number of entries.
+  size_t size() const { return size_; }
+
+  /// Returns the \p i th entry in the buffer.
+  DirectoryEntry operator[](size_t i) const {
+    assert(i < size_);
+    return DirectoryEntry(entries()[i]);
+  }
+
+  /// Returns the entries in the buffer, e.g. for DecodeDirectoryColumns.
+  VLRawDirectoryEntry const *data() const { return entries(); }
+
+  Iterator begin() const { return Iterator(entries()); }
+  Iterator end() const { return Iterator(entries() + size_); }
+
+  /// Returns the raw entry for the file \p index, or null if there is none.
+  VLRawDirectoryEntry const *_Nullable Find(uint16_t index) const;
 
 private:
-  ::std::map<uint16_t, DirectoryEntry> entries_;
-  VLRawDirectoryHeader hdr_;
-  uint8_t const *src_;
-  uint8_t const *const end_;
-  bool valid_;
+  VLRawDirectoryEntry const *entries() const {
+    return reinterpret_cast<VLRawDirectoryEntry const *>(
+        src_ + sizeof(VLRawDirectoryHeader));
+  }
+
+  uint8_t const *const src_;
+  size_t const length_;
+  VLRawDirectoryHeader header_;
+
+  /// Number of entries in the buffer.
+  size_t size_ = 0;
+
+  /// True if the entries are in ascending order of index.  Only valid if
+  /// sorted_known_.
+  mutable bool sorted_ = false;
+  mutable bool sorted_known_ = false;
 };
 
+/// Decodes \p count raw entries starting at \p raw, which points into
+/// \p buffer, overwriting the start of \p buffer with VLDirectoryEntry structs.
+///
+/// A decoded entry is no larger than a raw one, so each entry only overwrites
+/// records that have already been decoded.  The raw entries are destroyed.
+///
+/// \return The decoded entries, or null if \p buffer isn't suitably aligned
+/// for VLDirectoryEntry.
+VLDirectoryEntry *_Nullable DecodeEntriesInPlace(
+    uint8_t *buffer, VLRawDirectoryEntry const *raw, size_t count);
+
 } // namespace viv
 
 #pragma clang assume_nonnull end
@@ -0,0 +1,108 @@
+// directory_cache.h - persistent directory cache format
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_directory_cache_h
+#define viv_directory_cache_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+#include "viv/directory_query.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// Summary and freshness of a cached directory.
+struct VLDirectoryCacheInfo {
+  /// The Viiiiva's clock when the directory was downloaded, in seconds since
+  /// POSIX epoch.
+  time_t device_time;
+
+  /// The host's clock when the directory was downloaded, in seconds since
+  /// POSIX epoch.
+  time_t fetched_time;
+
+  /// Fingerprint of the directory (see VLDirectoryFingerprint).
+  uint32_t fingerprint;
+
+  /// Number of entries in the directory.
+  uint32_t entry_count;
+};
+typedef struct VLDirectoryCacheInfo VLDirectoryCacheInfo;
+
+#ifdef __cplusplus
+extern "C" {
+using ::std::time_t;
+#endif
+
+/// Returns the size of a cache file holding a directory of \p length bytes.
+extern size_t VLDirectoryCacheLength(size_t length);
+
+/// Writes a cache file for a downloaded directory into \p dst.
+///
+/// A cache file is a 32-byte header (magic, version, fetch time, fingerprint
+/// and length) followed by the directory exactly as downloaded, so that a
+/// memory-mapped file can be read in place.  libviv does no I/O; the caller
+/// writes \p dst to the file (ideally atomically, e.g. by renaming a
+/// temporary file).
+///
+/// \param dst Destination buffer of at least VLDirectoryCacheLength(length)
+/// bytes.
+/// \param directory The raw directory, e.g. from \c did_read_directory.
+/// \param fetched_time The host's clock, in seconds since POSIX epoch.
+/// \return The number of bytes written, or negative if there was an error.
+extern int VLWriteDirectoryCache(
+    uint8_t *dst, size_t capacity, uint8_t const *directory, size_t length,
+    time_t fetched_time);
+
+/// Validates the cache file in \p src and reads its summary.
+///
+/// \param[out] info Summary to write into.
+/// \return Zero, or negative if the file is not a valid cache (e.g. it's from
+/// a newer version of libviv, truncated or corrupt).
+extern int VLReadDirectoryCache(
+    VLDirectoryCacheInfo *info, uint8_t const *src, size_t length);
+
+/// Runs \p query over the directory in the cache file in \p src.
+///
+/// \p callback is called with each matching entry, as for
+/// VLManagerQueryDirectory.  No device is involved.
+///
+/// \return The number of entries delivered, or negative if the file is not a
+/// valid cache.
+extern int VLQueryDirectoryCache(
+    uint8_t const *src, size_t length, VLDirectoryQuery query,
+    void (*callback)(void *_Nullable ctx, VLDirectoryEntry entry),
+    void *_Nullable ctx);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_directory_cache_h */
@@ -0,0 +1,63 @@
+// directory_cache.hpp - persistent directory cache format
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_directory_cache_hpp
+#define viv_directory_cache_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "directory.hpp"
+#include "directory_cache.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Read-only view of a directory cache file (see VLWriteDirectoryCache), e.g.
+/// over a memory-mapped file.
+///
+/// The cached directory is read in place through a DirectoryView, so that it
+/// can be listed and queried like a downloaded one.
+class DirectoryCache {
+public:
+  /// Size of the cache file's header.
+  static constexpr size_t kHeaderLength = 32;
+
+  /// Creates a view of \p src, which must outlive the view.
+  explicit DirectoryCache(uint8_t const *src, size_t length) noexcept;
+
+  /// Validates the cache header and the directory.
+  ///
+  /// \return Zero, or negative if the cache isn't valid.  The other methods
+  /// should only be called if it is.
+  int Read();
+
+  VLDirectoryCacheInfo const &info() const { return info_; }
+
+  DirectoryView const &directory() const { return directory_; }
+
+private:
+  uint8_t const *const src_;
+  size_t const length_;
+  DirectoryView directory_;
+  VLDirectoryCacheInfo info_ = {};
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_directory_cache_hpp */
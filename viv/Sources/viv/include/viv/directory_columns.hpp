@@ -0,0 +1,76 @@
+// directory_columns.hpp - bulk decoding of directory entries
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_directory_columns_hpp
+#define viv_directory_columns_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include "compat.h"
+#include "raw_directory.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Destination for bulk-decoded directory entries, one array per field.
+///
+/// The arrays belong to the caller and must each have room for every entry
+/// decoded into them.  Element \c i of each array describes the same entry.
+struct DirectoryColumns {
+  /// File indexes, in host byte-order.
+  uint16_t *index;
+
+  /// File types (VLFileType values).
+  uint16_t *file_type;
+
+  /// File operation flags (see FileFlags).
+  uint8_t *flags;
+
+  /// File lengths in bytes, in host byte-order.
+  uint32_t *length;
+
+  /// File creation times, in seconds since POSIX epoch.
+  time_t *posix_time;
+};
+
+/// True if DecodeDirectoryColumns has a vector implementation for this target
+/// (SSE2 or NEON on a little-endian host).
+extern bool const kHasVectorDirectoryDecoder;
+
+/// Decodes \p count entries from \p entries into \p columns.
+///
+/// Entries are decoded four at a time with SSE2 or NEON, where available,
+/// falling back to DecodeDirectoryColumnsScalar for the remainder.  The
+/// results are identical to DecodeDirectoryColumnsScalar's.
+void DecodeDirectoryColumns(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns);
+
+/// Decodes \p count entries from \p entries into \p columns, one entry at a
+/// time.
+///
+/// This is the portable reference implementation of DecodeDirectoryColumns.
+void DecodeDirectoryColumnsScalar(
+    VLRawDirectoryEntry const *entries, size_t count,
+    DirectoryColumns const &columns);
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_directory_columns_hpp */
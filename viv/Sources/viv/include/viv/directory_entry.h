@@ -62,4 +62,23 @@ struct VLDirectoryEntry {
 };
 typedef struct VLDirectoryEntry VLDirectoryEntry;
 
+// Summary of the start of a directory, from a probe.
+struct VLDirectoryProbe {
+  /// The Viiiiva's clock, in seconds since POSIX epoch.
+  time_t posix_time;
+
+  /// Hash of the probed part of the directory, excluding the clock (see
+  /// VLDirectoryFingerprint).
+  uint32_t fingerprint;
+
+  /// Number of entries probed.  If fewer entries were probed than requested,
+  /// this is every entry in the directory.
+  uint16_t entry_count;
+
+  /// Non-zero if the directory has more entries than the probe was told it
+  /// had, e.g. because files were added since the last sync.
+  uint8_t grown;
+};
+typedef struct VLDirectoryProbe VLDirectoryProbe;
+
 #endif /* viv_directory_entry_h */
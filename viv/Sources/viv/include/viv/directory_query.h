@@ -0,0 +1,89 @@
+// directory_query.h - filtering and ordering directory entries
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_directory_query_h
+#define viv_directory_query_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <ctime>
+#else
+#include <stdint.h>
+#include <time.h>
+#endif
+
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+
+/// File operation flags, as found in a raw directory entry.
+VL_ENUM(uint8_t, VLFileFlags){
+    /// File may be erased.
+    kVLFileFlagErasable = 0x20,
+
+    /// File can be downloaded.
+    kVLFileFlagReadable = 0x40,
+};
+typedef enum VLFileFlags VLFileFlags;
+
+/// The order in which a query's matching entries are delivered.
+VL_ENUM(uint8_t, VLDirectoryOrder){
+    /// The order of the directory itself (ascending index, on a Viiiiva).
+    kVLDirectoryOrderDirectory = 0,
+
+    /// Most recent file first.
+    kVLDirectoryOrderNewest = 1,
+
+    /// Least recent file first.
+    kVLDirectoryOrderOldest = 2,
+
+    /// Longest file first.
+    kVLDirectoryOrderLargest = 3,
+};
+typedef enum VLDirectoryOrder VLDirectoryOrder;
+
+/// Selects directory entries.
+///
+/// A zero-initialized query matches every entry, in directory order.  Each
+/// non-zero field narrows the selection.  Ties in the order are broken by the
+/// directory order.
+struct VLDirectoryQuery {
+  /// Earliest file time to match, in seconds since POSIX epoch (inclusive).
+  time_t min_posix_time;
+
+  /// Latest file time to match, in seconds since POSIX epoch (inclusive), or
+  /// zero for no limit.
+  time_t max_posix_time;
+
+  /// Smallest file length to match, in bytes.
+  uint32_t min_length;
+
+  /// Largest file length to match, in bytes, or zero for no limit.
+  uint32_t max_length;
+
+  /// File type to match, or zero for any type.
+  VLFileType file_type;
+
+  /// Maximum number of entries to deliver, or zero for no limit.
+  uint16_t limit;
+
+  /// Flags that matching files must all have (bitwise OR of VLFileFlags).
+  uint8_t required_flags;
+
+  /// The order in which to deliver matching entries.
+  VLDirectoryOrder order;
+};
+typedef struct VLDirectoryQuery VLDirectoryQuery;
+
+#endif /* viv_directory_query_h */
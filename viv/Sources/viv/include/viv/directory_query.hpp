@@ -0,0 +1,110 @@
+// directory_query.hpp - filtering and ordering directory entries
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_directory_query_hpp
+#define viv_directory_query_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "directory.hpp"
+#include "directory_query.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Evaluates a VLDirectoryQuery over a directory.
+///
+/// Matching entries are selected in place, without allocating.  For \c Run,
+/// directory order takes a single pass, and any other order takes one pass
+/// per entry delivered: "the newest 3 activities" costs three passes, however
+/// big the directory.  \c Select always takes a single pass.
+class DirectoryQuery {
+public:
+  explicit DirectoryQuery(VLDirectoryQuery const &query) noexcept
+      : query_(query) {}
+
+  /// Returns whether \p entry satisfies the query's predicates.
+  bool Matches(DirectoryEntry const &entry) const;
+
+  /// Calls \p f with each entry of \p dir that matches, in the query's order,
+  /// up to its limit.
+  ///
+  /// \return The number of entries delivered.
+  template <typename F> size_t Run(DirectoryView const &dir, F &&f) const;
+
+  /// Moves the entries of \p entries that match to the front, in the query's
+  /// order, up to its limit.
+  ///
+  /// Unlike \c Run, this rearranges the buffer, in a single pass.  For an
+  /// order other than the directory's, each match is inserted into a sorted
+  /// prefix no longer than the limit, so the work per entry is bounded by
+  /// the limit rather than by the number of matches.
+  ///
+  /// \param size Number of entries in \p entries.
+  /// \return The number of entries selected.
+  size_t Select(VLRawDirectoryEntry *entries, size_t size) const;
+
+private:
+  /// Returns whether entry \p i of \p dir is ordered before entry \p j.
+  bool Before(DirectoryView const &dir, size_t i, size_t j) const;
+
+  VLDirectoryQuery const query_;
+};
+
+template <typename F>
+size_t
+DirectoryQuery::Run(DirectoryView const &dir, F &&f) const {
+  size_t const size = dir.size();
+  size_t const limit = (query_.limit == 0) ? size : query_.limit;
+  size_t delivered = 0;
+  if (query_.order == kVLDirectoryOrderDirectory) {
+    for (size_t i = 0; i < size && delivered < limit; ++i) {
+      DirectoryEntry const entry = dir[i];
+      if (Matches(entry)) {
+        f(entry);
+        ++delivered;
+      }
+    }
+    return delivered;
+  }
+
+  // Each pass selects the first match ordered after the last one delivered.
+  size_t last = size;
+  for (; delivered < limit; ++delivered) {
+    size_t best = size;
+    for (size_t i = 0; i < size; ++i) {
+      if (!Matches(dir[i]) || (last != size && !Before(dir, last, i))) {
+        continue;
+      }
+      if (best == size || Before(dir, i, best)) {
+        best = i;
+      }
+    }
+    if (best == size) {
+      break;
+    }
+    f(dir[best]);
+    last = best;
+  }
+  return delivered;
+}
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_directory_query_hpp */
@@ -17,11 +17,12 @@
 #define viv_download_command_hpp
 
 #include <cstdint>
-#include <functional>
+#include <cstdlib>
 #include <utility>
 #include <vector>
 
 #include "viv/burst.hpp"
+#include "viv/callback.hpp"
 #include "viv/command.hpp"
 #include "viv/compat.h"
 #include "viv/packet.h"
@@ -32,19 +33,23 @@ namespace viv {
 
 /// Command for downloading a file (or the directory itself).
 ///
-/// Accumulates the file content from ReadResponse calls.
+/// Accumulates the file content from ReadResponse calls.  The content is
+/// either written to a buffer supplied by the caller, or (unless VL_NO_HEAP is
+/// set) to a buffer owned by the command.
 class DownloadCommand : public CommandWithReply {
 public:
   /// Function to call once the file has been downloaded.  It is called with
-  /// the file index, file contents, and file length respectively.
-  using OnFinishCallback =
-      ::std::function<void(uint16_t, uint8_t const *, size_t)>;
+  /// the file index, file contents, and file length respectively.  The
+  /// command doesn't read its buffer again, so the callee may overwrite it.
+  using OnFinishCallback = Callback<void(uint16_t, uint8_t *, size_t)>;
 
+#if !VL_NO_HEAP
   /// Convenience constructor for a download at offset 0 and no length limit.
   DownloadCommand(uint16_t index, OnFinishCallback on_finish) noexcept
-      : DownloadCommand(index, 0, 0xffffffffUL, ::std::move(on_finish)) {}
+      : DownloadCommand(index, 0, 0xffffffffUL, on_finish) {}
 
-  /// Creates a download command for reading a particular file.
+  /// Creates a download command for reading a particular file into a buffer
+  /// owned by the command.
   ///
   /// \param index The file (ANT-FS index) to download (host byte order).
   /// \param offset Byte offset within file to start download from (host byte
@@ -52,22 +57,53 @@ public:
   /// \param length Maximum length of the file in bytes (host byte order).
   DownloadCommand(
       uint16_t index, uint32_t offset, uint32_t length,
-      OnFinishCallback const on_finish) noexcept;
+      OnFinishCallback on_finish) noexcept
+      : DownloadCommand(index, offset, length, nullptr, 0, on_finish) {}
+#endif
+
+  /// Creates a download command for reading a particular file into \p buffer.
+  ///
+  /// \param buffer Storage for the file contents, or null to use a buffer
+  /// owned by the command (only allowed if VL_NO_HEAP is false).  Not owned.
+  /// \param capacity Size of \p buffer in bytes.  Downloads longer than this
+  /// will fail.
+  DownloadCommand(
+      uint16_t index, uint32_t offset, uint32_t length,
+      uint8_t *_Nullable buffer, size_t capacity,
+      OnFinishCallback on_finish) noexcept;
 
   VLPacket MakeCommandPacket() const override;
 
   /// Returns true after the full file has been read, or there was an error.
-  bool MaybeFinish() const override;
+  ///
+  /// An empty download (e.g. past the end of the file) finishes with its ack.
+  bool MaybeFinish() override;
 
   /// The contents of the file read so far.
   ///
   /// Only up to \c length() bytes should be read from the returned buffer.
-  uint8_t const *buffer() const { return buf_.data(); }
+  uint8_t const *_Nullable buffer() const;
+
+  /// Writable access to the contents of the file read so far.
+  uint8_t *_Nullable buffer();
 
   /// The number of bytes of the file read so far.
-  size_t length() const { return buf_.size(); }
+  size_t length() const { return length_; }
 
-  ::std::string name() const override { return "download command"; }
+#if !VL_NO_HEAP
+  /// Returns true if the command owns its buffer (rather than writing to a
+  /// caller-supplied one).
+  bool owns_buffer() const { return buf_ == nullptr; }
+
+  /// Moves the contents out of the command's own buffer, without copying.
+  ///
+  /// Only valid if \c owns_buffer, once the command has finished.  May be
+  /// called from the \c OnFinishCallback: the command doesn't touch the
+  /// buffer after calling it.
+  ::std::vector<uint8_t> TakeBuffer();
+#endif
+
+  char const *name() const override { return "download command"; }
 
 protected:
   /// Reads the first response packet.
@@ -82,8 +118,27 @@ protected:
   int ReadReply(VLPacket const &packet) override;
 
 private:
-  /// Contents of the file.
-  ::std::vector<uint8_t> buf_;
+  /// Appends \p length bytes to the buffer.
+  ///
+  /// \return False if there was not enough space.
+  bool Append(uint8_t const *data, size_t length);
+
+#if !VL_NO_HEAP
+  /// Contents of the file, if the command owns its buffer.
+  ::std::vector<uint8_t> owned_buf_;
+#endif
+
+  /// Caller-supplied storage for the file contents; not owned.
+  uint8_t *_Nullable const buf_;
+
+  /// Size of buf_ in bytes.
+  size_t const capacity_;
+
+  /// Number of bytes of the file read so far.
+  size_t length_ = 0;
+
+  /// Number of bytes in the file, according to the ack.
+  size_t expected_length_ = 0;
 
   OnFinishCallback const on_finish_;
 
@@ -92,7 +147,7 @@ private:
 
   // Initial request parameters.
   uint32_t const offset_;
-  uint32_t const length_;
+  uint32_t const length_limit_;
   uint16_t const index_;
 };
 
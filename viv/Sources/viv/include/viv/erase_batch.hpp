@@ -0,0 +1,114 @@
+// erase_batch.hpp - state for erasing a set of files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_erase_batch_hpp
+#define viv_erase_batch_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/compat.h"
+#include "viv/erase_result.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Tracks a set of files being erased by Manager::EraseFiles.
+///
+/// The files are erased one after another, then the directory is downloaded
+/// once to check which are really gone.  The state is held inline, so a batch
+/// doesn't allocate.
+class EraseBatch {
+public:
+  /// Maximum number of files in one batch.
+  static constexpr size_t kMaxFiles = 64;
+
+  EraseBatch() noexcept = default;
+
+  // Disallow copy/move semantics.
+  EraseBatch(const EraseBatch &) = delete;
+  EraseBatch &operator=(const EraseBatch &) = delete;
+
+  /// Starts a batch erasing the files in \p indices.
+  ///
+  /// \return False (and leaves the batch inactive) if \p count is greater than
+  /// kMaxFiles.
+  bool Start(uint16_t const *indices, size_t count);
+
+  /// Abandons the batch.
+  void Clear();
+
+  /// True between \c Start and \c Clear.
+  bool active() const { return active_; }
+
+  /// Gets the next file to erase.
+  ///
+  /// \return False once every file has been issued.
+  bool Next(uint16_t &index);
+
+  /// Records the Viiiiva's reply to erasing \p index.
+  void DidErase(uint16_t index, bool ok);
+
+  /// True once the directory refresh has been issued.
+  bool verifying() const { return verifying_; }
+
+  /// Marks that the directory refresh has been issued.
+  void StartVerifying() { verifying_ = true; }
+
+  /// Records that \p index was found in the refreshed directory.
+  void DidFindFile(uint16_t index);
+
+  /// Marks that the refreshed directory was parsed.
+  void DidVerify() { verified_ = true; }
+
+  /// Classifies each file, and returns the results in the order they were
+  /// given to \c Start.
+  ///
+  /// If the directory wasn't parsed, the Viiiiva's replies are taken at their
+  /// word.
+  ///
+  /// \param[out] count The number of results.
+  /// \return Results valid until the next call to \c Start.
+  VLEraseResult const *Finish(size_t &count);
+
+private:
+  struct File {
+    uint16_t index;
+
+    /// True if the Viiiiva replied that the file was erased.
+    bool ok;
+
+    /// True if the file was in the refreshed directory.
+    bool present;
+  };
+
+  File files_[kMaxFiles];
+  VLEraseResult results_[kMaxFiles];
+  size_t count_ = 0;
+
+  /// Number of files whose erase commands have been issued.
+  size_t next_ = 0;
+
+  bool active_ = false;
+  bool verifying_ = false;
+  bool verified_ = false;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_erase_batch_hpp */
@@ -17,8 +17,8 @@
 #define viv_erase_command_hpp
 
 #include <cstdint>
-#include <functional>
 
+#include "viv/callback.hpp"
 #include "viv/command.hpp"
 #include "viv/compat.h"
 #include "viv/packet.h"
@@ -32,18 +32,18 @@ class EraseCommand : public CommandWithReply {
 public:
   /// Function to call once the file has been erased.
   ///
-  /// The boolean parameter is true if the erase was successful, false
-  /// otherwise.
-  using OnFinishCallback = ::std::function<void(bool)>;
+  /// It is called with the file index, and a boolean that is true if the erase
+  /// was successful, false otherwise.
+  using OnFinishCallback = Callback<void(uint16_t, bool)>;
 
   explicit EraseCommand(uint16_t index, OnFinishCallback on_finish) noexcept;
 
   VLPacket MakeCommandPacket() const override;
 
-  bool MaybeFinish() const override;
+  bool MaybeFinish() override;
   bool ShouldAckReply() const override { return true; }
 
-  ::std::string name() const override { return "erase command"; }
+  char const *name() const override { return "erase command"; }
 
 protected:
   int ReadReply(VLPacket const &packet) override;
@@ -0,0 +1,51 @@
+// erase_result.h - outcome of erasing a set of files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_erase_result_h
+#define viv_erase_result_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "viv/compat.h"
+
+/// What became of one file in a batch erase.
+VL_ENUM(uint8_t, VLEraseOutcome){
+    /// The file is no longer in the directory.
+    kVLEraseOutcomeErased = 0,
+
+    /// The Viiiiva reported an error or didn't reply, and the file is still in
+    /// the directory.
+    kVLEraseOutcomeFailed = 1,
+
+    /// The Viiiiva reported that the file was erased, but it is still in the
+    /// directory.
+    kVLEraseOutcomeStillPresent = 2,
+};
+typedef enum VLEraseOutcome VLEraseOutcome;
+
+/// Result of erasing one file in a batch.
+struct VLEraseResult {
+  /// Index of the file.
+  uint16_t index;
+
+  VLEraseOutcome outcome;
+};
+typedef struct VLEraseResult VLEraseResult;
+
+#endif /* viv_erase_result_h */
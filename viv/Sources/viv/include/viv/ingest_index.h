@@ -0,0 +1,160 @@
+// ingest_index.h - persistent index of ingested files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_ingest_index_h
+#define viv_ingest_index_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+#include "viv/sync_plan.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// Identifies a Viiiiva, e.g. by the bytes of its Bluetooth UUID.
+struct VLDeviceId {
+  uint8_t bytes[16];
+};
+typedef struct VLDeviceId VLDeviceId;
+
+/// How much of a directory entry has been ingested.
+VL_ENUM(uint8_t, VLIngestState){
+    /// Nothing is recorded for the entry's index.
+    kVLIngestStateNew = 0,
+
+    /// Part of the file has been ingested, and it has grown since.
+    kVLIngestStatePartial = 1,
+
+    /// The whole file has been ingested.
+    kVLIngestStateIngested = 2,
+
+    /// The recorded file can't be used: the index now holds a different
+    /// file, it has shrunk, or the host couldn't verify it.
+    kVLIngestStateStale = 3,
+};
+typedef enum VLIngestState VLIngestState;
+
+/// Append-only log of ingested files, e.g. in a memory-mapped file.
+///
+/// This is an opaque type, like VLCProtocolManager.  libviv does no I/O: the
+/// log is read and appended in a buffer supplied by the client, which would
+/// usually map a file (shared, and with spare capacity) into that buffer.
+/// Each record is checksummed, so a log that was torn by a crash is
+/// recovered up to its last whole record when it's opened.
+typedef struct {
+  // Opaque pointer to C++ object.
+  void *_Nullable index;
+} VLIngestIndex;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Returns the number of hash slots needed to index a log of \p capacity
+/// bytes.
+extern size_t VLIngestIndexSlotCount(size_t capacity);
+
+/// Opens the log in \p log, initializing it if it's zero-filled.
+///
+/// The caller takes ownership of the index, and must call
+/// VLDeleteIngestIndex.  \p log and \p slots must outlive the index.
+///
+/// \param log Buffer of \p capacity bytes, holding the log followed by zeros.
+/// \param slots Scratch space of VLIngestIndexSlotCount(capacity) elements
+/// for the lookup table.
+/// \param[out] recovered Number of live records, or negative if \p log isn't
+/// an ingest index (e.g. it's from a newer version of libviv) or there are
+/// too few \p slots.  Anything after the last whole record is zeroed.
+/// \return The index, or a null index (whose \c index is null) if
+/// \p recovered is negative.  A null index must not be passed to the other
+/// VLIngestIndex functions.
+extern VLIngestIndex VLMakeIngestIndex(
+    uint8_t *log, size_t capacity, uint32_t *slots, size_t slot_count,
+    int *recovered);
+
+/// Deletes an index previously created with VLMakeIngestIndex.
+extern void VLDeleteIngestIndex(VLIngestIndex index);
+
+/// Records that \p file has been ingested from \p device.
+///
+/// The record supersedes any earlier one for the same device and index.  The
+/// client should flush the log (e.g. with msync) before relying on it.
+///
+/// \return Zero, or negative if the log is full (see
+/// VLIngestIndexCompact).
+extern int VLIngestIndexAppend(
+    VLIngestIndex index, VLDeviceId const *device, VLLocalFile file);
+
+/// Records that file \p file_index is no longer ingested from \p device, e.g.
+/// because the client deleted its copy.
+///
+/// \return Zero, or negative if the log is full.
+extern int VLIngestIndexForget(
+    VLIngestIndex index, VLDeviceId const *device, uint16_t file_index);
+
+/// Looks up the latest record of file \p file_index from \p device, in
+/// constant time.
+///
+/// \param[out] file The record, if there is one.
+/// \return Non-zero if there is a record.
+extern int VLIngestIndexLookup(
+    VLIngestIndex index, VLDeviceId const *device, uint16_t file_index,
+    VLLocalFile *file);
+
+/// Returns how much of \p entry has been ingested from \p device, in constant
+/// time, e.g. from \c did_parse_directory_entry.
+extern VLIngestState VLIngestIndexState(
+    VLIngestIndex index, VLDeviceId const *device, VLDirectoryEntry entry);
+
+/// Returns non-zero if most of the log's records have been superseded, so
+/// compacting it would be worthwhile.
+extern int VLIngestIndexShouldCompact(VLIngestIndex index);
+
+/// Writes a log holding just the latest record of each ingested file.
+///
+/// The client should write \p dst to a new file, replace the old log with it
+/// atomically (e.g. by renaming it), and open it in place of this index.
+///
+/// \param dst Destination of \p capacity bytes.  Bytes after the compacted
+/// log are zeroed, so spare capacity is ready for appending.
+/// \return The length of the compacted log, or negative if it doesn't fit.
+extern int
+VLIngestIndexCompact(VLIngestIndex index, uint8_t *dst, size_t capacity);
+
+/// Plans a sync as for VLPlanSync, using the files recorded in \p index for
+/// \p device.
+extern int VLPlanSyncWithIngestIndex(
+    uint8_t const *directory, size_t length, VLIngestIndex index,
+    VLDeviceId const *device, VLSyncPolicy const *policy,
+    VLSyncStep *_Nullable steps, size_t capacity);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_ingest_index_h */
@@ -0,0 +1,144 @@
+// ingest_index.hpp - persistent index of ingested files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_ingest_index_hpp
+#define viv_ingest_index_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "directory_entry.h"
+#include "ingest_index.h"
+#include "sync_plan.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Returns how much of \p entry has been ingested, given the latest record
+/// of its index (or null).
+VLIngestState IngestStateOf(
+    VLDirectoryEntry const &entry, VLLocalFile const *_Nullable file);
+
+/// Append-only log of ingested files, with constant-time lookup (see
+/// VLIngestIndex).
+///
+/// The log is a 32-byte header followed by 48-byte records, each holding a
+/// device, a VLLocalFile and a CRC-32.  An open-addressed hash table in
+/// caller-supplied slots maps each (device, file index) to its latest record.
+/// Nothing is allocated.
+class IngestIndex {
+public:
+  /// Size of the log's header.
+  static constexpr size_t kHeaderLength = 32;
+
+  /// Size of each record.
+  static constexpr size_t kRecordLength = 48;
+
+  /// Returns the number of slots needed for a log of \p capacity bytes: a
+  /// power of 2, with at least twice as many slots as records.
+  static size_t SlotCount(size_t capacity);
+
+  /// Creates an index over \p log.  Open must be called before it's used.
+  IngestIndex(
+      uint8_t *log, size_t capacity, uint32_t *slots,
+      size_t slot_count) noexcept;
+
+  IngestIndex(const IngestIndex &) = delete;
+  IngestIndex &operator=(const IngestIndex &) = delete;
+
+  /// Reads the log, initializing it if it's empty, and zeroes anything after
+  /// the last whole record.
+  ///
+  /// \return The number of live records, or negative if the log isn't an
+  /// ingest index or there are too few slots.  The index is then unusable:
+  /// its other methods leave the log untouched and find no records.
+  int Open();
+
+  /// Returns whether the last call to Open succeeded.
+  bool is_open() const { return open_; }
+
+  /// Appends a record of \p file.
+  ///
+  /// \return Zero, or negative if it's full or the index isn't open.
+  int Append(VLDeviceId const &device, VLLocalFile const &file);
+
+  /// Appends a record that \p file_index is no longer ingested.
+  int Forget(VLDeviceId const &device, uint16_t file_index);
+
+  /// Finds the latest record of \p file_index.
+  ///
+  /// \return Whether there is one (never, if the index isn't open).
+  bool Lookup(
+      VLDeviceId const &device, uint16_t file_index, VLLocalFile &file) const;
+
+  /// Returns how much of \p entry has been ingested.
+  VLIngestState
+  State(VLDeviceId const &device, VLDirectoryEntry const &entry) const;
+
+  /// Returns whether most records have been superseded.
+  bool ShouldCompact() const;
+
+  /// Writes a log of the live records into \p dst.
+  ///
+  /// \return Its length, or negative if it doesn't fit in \p capacity or the
+  /// index isn't open.
+  int Compact(uint8_t *dst, size_t capacity) const;
+
+  /// Length of the log, including its header.
+  size_t length() const { return length_; }
+
+  /// Number of records that aren't superseded or forgotten.
+  size_t live_count() const { return live_; }
+
+  /// Number of records in the log.
+  size_t record_count() const {
+    return open_ ? (length_ - kHeaderLength) / kRecordLength : 0;
+  }
+
+  /// Number of torn records zeroed by Open.
+  size_t torn_count() const { return torn_; }
+
+private:
+  /// Returns the slot for \p device and \p file_index: either the one
+  /// holding its latest record, or the empty slot where it would go.
+  uint32_t &Slot(VLDeviceId const &device, uint16_t file_index) const;
+
+  /// Returns record \p n (counting from 1).
+  uint8_t *Record(uint32_t n) const {
+    return log_ + kHeaderLength + (n - 1) * kRecordLength;
+  }
+
+  /// Indexes the record that ends the log.
+  void Insert(uint32_t n);
+
+  /// Appends a record, filling in its CRC.
+  int AppendRecord(uint8_t const *record);
+
+  uint8_t *const log_;
+  size_t const capacity_;
+  uint32_t *const slots_;
+  size_t const slot_mask_;
+  size_t length_ = 0;
+  size_t live_ = 0;
+  size_t torn_ = 0;
+  bool open_ = false;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_ingest_index_hpp */
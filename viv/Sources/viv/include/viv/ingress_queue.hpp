@@ -0,0 +1,126 @@
+// ingress_queue.hpp - lock-free queue for GATT value notifications
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_ingress_queue_hpp
+#define viv_ingress_queue_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "viv/compat.h"
+#include "viv/packet.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Bounded, lock-free, multi-producer single-consumer queue of values.
+///
+/// Any number of threads may call \c Push concurrently (e.g. Bluetooth
+/// callbacks), while a single thread calls \c Pop.  Values of up to
+/// kVLPacketMaxLength bytes are copied into fixed slots, so neither operation
+/// allocates.
+///
+/// This is Dmitry Vyukov's bounded queue: each slot carries a sequence number
+/// that tells producers and the consumer whose turn it is.
+///
+/// \tparam N The number of slots; must be a power of two.
+template <size_t N> class IngressQueue {
+public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+
+  IngressQueue() noexcept {
+    for (size_t i = 0; i < N; ++i) {
+      slots_[i].seq.store(i, ::std::memory_order_relaxed);
+    }
+  }
+
+  // Disallow copy/move semantics.
+  IngressQueue(const IngressQueue &) = delete;
+  IngressQueue &operator=(const IngressQueue &) = delete;
+
+  /// Copies \p value into the queue.  Safe to call from any thread.
+  ///
+  /// \return False if the queue is full or \p length is too big, in which case
+  /// the value is dropped.
+  bool Push(uint8_t const *value, size_t length) noexcept {
+    if (length > kVLPacketMaxLength) {
+      return false;
+    }
+
+    size_t pos = enqueue_pos_.load(::std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[pos & (N - 1)];
+      size_t const seq = slot->seq.load(::std::memory_order_acquire);
+      intptr_t const diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(
+                pos, pos + 1, ::std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(::std::memory_order_relaxed);
+      }
+    }
+
+    ::std::memcpy(slot->value, value, length);
+    slot->length = static_cast<uint8_t>(length);
+    slot->seq.store(pos + 1, ::std::memory_order_release);
+    return true;
+  }
+
+  /// Removes the oldest value from the queue.  Must only be called from the
+  /// consumer thread.
+  ///
+  /// \param[out] value Buffer of at least kVLPacketMaxLength bytes.
+  /// \return The length of the value, or negative if the queue was empty.
+  int Pop(uint8_t *value) noexcept {
+    Slot &slot = slots_[dequeue_pos_ & (N - 1)];
+    if (slot.seq.load(::std::memory_order_acquire) != dequeue_pos_ + 1) {
+      return -1;
+    }
+
+    int const length = slot.length;
+    ::std::memcpy(value, slot.value, length);
+    slot.seq.store(dequeue_pos_ + N, ::std::memory_order_release);
+    ++dequeue_pos_;
+    return length;
+  }
+
+private:
+  struct Slot {
+    ::std::atomic<size_t> seq;
+    uint8_t length;
+    uint8_t value[kVLPacketMaxLength];
+  };
+
+  Slot slots_[N];
+
+  // Keep the producers' and consumer's positions on separate cache lines.
+  alignas(64) ::std::atomic<size_t> enqueue_pos_{0};
+  alignas(64) size_t dequeue_pos_ = 0;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_ingress_queue_hpp */
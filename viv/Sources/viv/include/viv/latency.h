@@ -0,0 +1,142 @@
+// latency.h - C interface for command latency histograms
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_latency_h
+#define viv_latency_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#include "viv/compat.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// The kinds of command whose latency is recorded.
+VL_ENUM(int, VLLatencyKind){
+    kVLLatencyKindDownloadDirectory = 0,
+    kVLLatencyKindDownloadFile = 1,
+    kVLLatencyKindEraseFile = 2,
+    kVLLatencyKindSetTime = 3,
+};
+typedef enum VLLatencyKind VLLatencyKind;
+
+/// The intervals recorded for each command.
+VL_ENUM(int, VLLatencyStage){
+    /// From writing the command to receiving its acknowledgement.
+    kVLLatencyStageAck = 0,
+
+    /// From the acknowledgement to the first reply packet.
+    kVLLatencyStageFirstPacket = 1,
+
+    /// Between consecutive reply packets.
+    kVLLatencyStagePacketGap = 2,
+
+    /// From writing the command to receiving its last response.
+    kVLLatencyStageTotal = 3,
+
+    /// The total, scaled to 1024 bytes of downloaded content.
+    kVLLatencyStageTotalPerKiB = 4,
+};
+typedef enum VLLatencyStage VLLatencyStage;
+
+/// Histograms of command latencies, keyed by VLLatencyKind and
+/// VLLatencyStage.
+///
+/// This is an opaque type, like VLCProtocolManager.  A recorder is updated by
+/// any managers it is attached to (with VLManagerSetLatencyRecorder), so it
+/// must not be read or merged concurrently with calls to those managers.
+typedef struct {
+  // Opaque pointer to C++ object.
+  void *_Nullable recorder;
+} VLLatencyRecorder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Creates an empty recorder.
+///
+/// The caller takes ownership of the pointer, and must call
+/// VLDeleteLatencyRecorder.
+///
+/// \param ctx Arbitrary pointer passed to \p now.
+/// \param now Returns the time from a monotonic clock.  The units are up to
+/// the caller (e.g. nanoseconds), and are the units of recorded values.
+extern VLLatencyRecorder VLMakeLatencyRecorder(
+    void *_Nullable ctx, uint64_t (*now)(void *_Nullable ctx))
+    CF_SWIFT_NAME(VLLatencyRecorder.init(ctx:now:));
+
+/// Deletes a recorder previously created with VLMakeLatencyRecorder.
+extern void VLDeleteLatencyRecorder(VLLatencyRecorder recorder)
+    CF_SWIFT_NAME(VLLatencyRecorder.deinitialize(self:));
+
+/// Adds all the values recorded in \p from to \p into.
+extern void
+VLLatencyRecorderMerge(VLLatencyRecorder into, VLLatencyRecorder from)
+    CF_SWIFT_NAME(VLLatencyRecorder.merge(self:_:));
+
+/// Returns the number of values recorded for \p kind and \p stage.
+extern uint64_t VLLatencyRecorderCount(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage)
+    CF_SWIFT_NAME(VLLatencyRecorder.count(self:kind:stage:));
+
+/// Returns an upper bound for the given percentile of values recorded for
+/// \p kind and \p stage, or 0 if none were recorded.
+///
+/// \param percentile Between 0 and 100.
+extern uint64_t VLLatencyRecorderValueAtPercentile(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    double percentile)
+    CF_SWIFT_NAME(VLLatencyRecorder.value(self:kind:stage:atPercentile:));
+
+/// Copies the bucket counts for \p kind and \p stage into \p counts.
+///
+/// Bucket i counts values from VLLatencyBucketLowerBound(i) up to (but
+/// excluding) the next bucket's lower bound.  Buckets can be added to another
+/// recorder (e.g. from another process) with VLLatencyRecorderAddBuckets.
+///
+/// \param length Number of elements in \p counts.
+/// \return The total number of buckets, which may be more than \p length.
+extern size_t VLLatencyRecorderCopyBuckets(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    uint64_t *_Nullable counts, size_t length)
+    CF_SWIFT_NAME(
+        VLLatencyRecorder.copyBuckets(self:kind:stage:counts:length:));
+
+/// Adds bucket counts previously copied with VLLatencyRecorderCopyBuckets.
+extern void VLLatencyRecorderAddBuckets(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    uint64_t const *counts, size_t length)
+    CF_SWIFT_NAME(VLLatencyRecorder.addBuckets(self:kind:stage:counts:length:));
+
+/// Returns the smallest value counted by bucket \p bucket.
+extern uint64_t VLLatencyBucketLowerBound(size_t bucket);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_latency_h */
@@ -0,0 +1,128 @@
+// latency_histogram.hpp - log-bucketed histograms of command latency
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_latency_histogram_hpp
+#define viv_latency_histogram_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/callback.hpp"
+#include "viv/compat.h"
+#include "viv/latency.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Histogram with logarithmically-sized buckets, in the style of
+/// HdrHistogram.
+///
+/// Each power of two is split into 2^kSubBucketBits linear buckets, so any
+/// uint64_t can be recorded with a relative error of at most 1/8 in fixed
+/// storage.  Recording never allocates.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  /// Returns the index of the bucket that counts \p value.
+  static size_t BucketForValue(uint64_t value) {
+    if (value < kSubBuckets) {
+      return value;
+    }
+    int const shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+  }
+
+  /// Returns the smallest value counted by \p bucket.
+  static uint64_t LowerBound(size_t bucket);
+
+  /// Returns the largest value counted by \p bucket.
+  static uint64_t UpperBound(size_t bucket);
+
+  void Record(uint64_t value) {
+    ++counts_[BucketForValue(value)];
+    ++count_;
+  }
+
+  /// Adds all the values recorded in \p other.
+  void Merge(LatencyHistogram const &other) {
+    AddBuckets(other.counts_, kNumBuckets);
+  }
+
+  /// Adds \p length bucket counts, e.g. from \c counts() of another histogram.
+  void AddBuckets(uint64_t const *counts, size_t length);
+
+  /// Returns the largest value in the bucket containing the given percentile
+  /// of recorded values, or 0 if there are none.
+  ///
+  /// \param percentile Between 0 and 100.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  /// Returns the number of values recorded.
+  uint64_t count() const { return count_; }
+
+  /// Returns the kNumBuckets bucket counts.
+  uint64_t const *counts() const { return counts_; }
+
+private:
+  uint64_t counts_[kNumBuckets] = {};
+  uint64_t count_ = 0;
+};
+
+/// A LatencyHistogram for each VLLatencyKind and VLLatencyStage.
+///
+/// The recorder is not synchronized; it should only be accessed from the
+/// thread calling the Manager(s) it is attached to.
+class LatencyRecorder {
+public:
+  /// Returns the time from a monotonic clock, in arbitrary units.
+  using Clock = Callback<uint64_t()>;
+
+  static constexpr size_t kNumKinds = 4;
+  static constexpr size_t kNumStages = 5;
+
+  explicit LatencyRecorder(Clock clock) noexcept : clock_(clock) {}
+
+  // Disallow copy/move semantics.
+  LatencyRecorder(const LatencyRecorder &) = delete;
+  LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+  uint64_t Now() const { return clock_(); }
+
+  LatencyHistogram &histogram(VLLatencyKind kind, VLLatencyStage stage) {
+    return histograms_[kind][stage];
+  }
+
+  LatencyHistogram const &
+  histogram(VLLatencyKind kind, VLLatencyStage stage) const {
+    return histograms_[kind][stage];
+  }
+
+  /// Adds all the values recorded in \p other.
+  void Merge(LatencyRecorder const &other);
+
+private:
+  Clock const clock_;
+  LatencyHistogram histograms_[kNumKinds][kNumStages];
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_latency_histogram_hpp */
@@ -21,12 +21,26 @@
 #include <cstdlib>
 #include <ctime>
 #include <memory>
-#include <string>
+#include <variant>
+#include <vector>
 
+#include "viv/capture.hpp"
 #include "viv/command.hpp"
 #include "viv/compat.h"
 #include "viv/directory_entry.h"
+#include "viv/directory_query.h"
+#include "viv/download_command.hpp"
+#include "viv/erase_batch.hpp"
+#include "viv/erase_command.hpp"
+#include "viv/erase_result.h"
+#include "viv/ingress_queue.hpp"
+#include "viv/latency.h"
+#include "viv/latency_histogram.hpp"
 #include "viv/manager_error_code.h"
+#include "viv/manager_metrics.h"
+#include "viv/metrics.hpp"
+#include "viv/raw_directory.h"
+#include "viv/set_time_command.hpp"
 
 #pragma clang assume_nonnull begin
 
@@ -49,42 +63,258 @@ public:
 
   virtual void DidFinishWaiting() const = 0;
 
-  virtual void
-  DidError(VLManagerErrorCode code, ::std::string const &&msg) const = 0;
+  /// Called when there was an error.
+  ///
+  /// \param msg A message describing the error.  The pointer is only valid for
+  /// this call.
+  virtual void DidError(VLManagerErrorCode code, char const *msg) const = 0;
 
   virtual void DidParseClock(time_t posix_time) const {}
 
   virtual void DidParseDirectoryEntry(VLDirectoryEntry entry) const {}
 
+  /// Called with the parsed entries of a directory (or of a page, for
+  /// Manager::DownloadDirectoryPage), in the order they're delivered.
+  ///
+  /// The entries are decoded in place over the download buffer, so this is
+  /// only called if that buffer is aligned for VLDirectoryEntry; otherwise
+  /// \c DidParseDirectoryEntry is called for each entry instead.  The default
+  /// calls \c DidParseDirectoryEntry for each entry.
+  ///
+  /// \param entries The pointer is only valid for this call.
+  virtual void
+  DidParseDirectory(VLDirectoryEntry const *entries, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+      DidParseDirectoryEntry(entries[i]);
+    }
+  }
+
   virtual void DidFinishParsingDirectory() const {}
 
+  /// Called after the entries of a page started by
+  /// Manager::DownloadDirectoryPage have been parsed.
+  ///
+  /// \param count The number of entries in the page.  If this is fewer than
+  /// were requested, it was the last page, and \c DidFinishParsingDirectory
+  /// follows.
+  virtual void
+  DidDownloadDirectoryPage(uint16_t first_entry, uint16_t count) const {}
+
+  /// Called when a probe started by Manager::ProbeDirectory has been read.
+  virtual void DidProbeDirectory(VLDirectoryProbe probe) const {}
+
+  /// Called with the raw directory (header and entries) once a whole
+  /// directory has been downloaded and its header validated, before
+  /// \c DidParseClock.  E.g. for VLWriteDirectoryCache.
+  ///
+  /// \param data The pointer is only valid for this call.
+  virtual void DidReadDirectory(uint8_t const *data, size_t length) const {}
+
+  /// Called after a directory from Manager::DownloadDirectory or
+  /// Manager::DownloadDirectoryIfChanged has been read, after
+  /// \c DidParseClock and before its entries.
+  ///
+  /// \param fingerprint The directory's fingerprint (see
+  /// VLDirectoryFingerprint), to pass to a later DownloadDirectoryIfChanged.
+  /// \param unchanged True if the fingerprint matched the one given to
+  /// DownloadDirectoryIfChanged.  The entries are then not parsed, and neither
+  /// \c DidParseDirectory nor \c DidFinishParsingDirectory is called.
+  virtual void
+  DidFingerprintDirectory(uint32_t fingerprint, bool unchanged) const {}
+
   virtual void
   DidDownloadFile(uint16_t index, uint8_t const *data, size_t length) const {}
 
+#if !VL_NO_HEAP
+  /// Called instead of \c DidDownloadFile when the manager owns the download
+  /// buffer (i.e. it wasn't created with a caller-supplied one), handing the
+  /// buffer over rather than lending it.
+  ///
+  /// The default lends \p data to \c DidDownloadFile.
+  virtual void
+  DidTakeFile(uint16_t index, ::std::vector<uint8_t> &&data) const {
+    DidDownloadFile(index, data.data(), data.size());
+  }
+#endif
+
   virtual void DidEraseFile(uint16_t index, bool ok) const {}
 
+  /// Called when a batch started by Manager::EraseFiles has been verified.
+  ///
+  /// \param results One result per file, in the order they were given.  The
+  /// pointer is only valid for this call.
+  virtual void
+  DidEraseFiles(VLEraseResult const *results, size_t count) const {}
+
   virtual void DidSetTime(bool ok) const {}
 };
 
 class Manager {
 public:
+  /// Maximum number of values waiting in the queue for \c DrainValues.
+  static constexpr size_t kIngressQueueLength = 64;
+
+#if !VL_NO_HEAP
   /// Initialize a manager to call functions on \p delegate, assuming ownership.
+  ///
+  /// Downloads are accumulated in buffers allocated by the manager.
   explicit Manager(::std::unique_ptr<ManagerDelegate> delegate) noexcept
-      : delegate_(::std::move(delegate)), busy_(false) {}
+      : Manager(::std::move(delegate), nullptr, 0) {}
+#endif
+
+  /// Initialize a manager to call functions on \p delegate, assuming ownership.
+  ///
+  /// Downloads (including the directory) are accumulated in \p buffer, so it
+  /// must be big enough for the largest file.  With a buffer, the manager
+  /// does not allocate from the heap after construction.
+  ///
+  /// \param buffer Storage for downloads, or null to have the manager allocate
+  /// buffers (only if VL_NO_HEAP is false).  Not owned; must outlive the
+  /// manager.
+  /// \param capacity Size of \p buffer in bytes.
+  Manager(
+      ::std::unique_ptr<ManagerDelegate> delegate, uint8_t *_Nullable buffer,
+      size_t capacity) noexcept;
 
   void NotifyValue(uint8_t const *value, size_t length);
 
+  /// Processes the value notifications \p values in order, as if by
+  /// \c NotifyValue, stopping after the first one that finishes any command
+  /// (including one within an \c EraseFiles batch) or is an error.
+  ///
+  /// \param lengths The length of each value in bytes.
+  /// \param count Number of elements in \p values and \p lengths.
+  /// \param settled Set to whether processing stopped at such a value, if
+  /// non-null.  This tells a caller passing values in chunks whether to go
+  /// on when every value of a chunk was processed.
+  /// \return The number of values processed, including the one that finished
+  /// the command or was an error.  The rest are left for the caller, e.g. to
+  /// pass on once it has issued the next command.
+  size_t NotifyValues(
+      uint8_t const *const *values, size_t const *lengths, size_t count,
+      bool *_Nullable settled = nullptr);
+
+  /// Queues a value notification for a later call to \c DrainValues.
+  ///
+  /// Unlike the other methods, this is safe to call from any thread, and
+  /// concurrently with other methods.
+  ///
+  /// \return False if the value was dropped because the queue was full or the
+  /// value was too long.
+  bool EnqueueValue(uint8_t const *value, size_t length) {
+    return ingress_.Push(value, length);
+  }
+
+  /// Processes up to \p max values queued by \c EnqueueValue, as if by
+  /// \c NotifyValue.
+  ///
+  /// \return The number of values processed.
+  size_t DrainValues(size_t max);
+
   void NotifyTimeout();
 
   void DownloadDirectory();
 
-  void DownloadFile(uint16_t index);
+  /// Downloads the directory, but only parses and reports its entries if its
+  /// fingerprint differs from \p fingerprint.
+  ///
+  /// On most syncs only the clock in the header has changed, which the
+  /// fingerprint ignores.  The clock and the fingerprint are always reported,
+  /// to \c DidParseClock and \c DidFingerprintDirectory.
+  void DownloadDirectoryIfChanged(uint32_t fingerprint);
+
+  /// Downloads only the directory header and up to \p max_entries entries,
+  /// and reports the Viiiiva's clock, a fingerprint of what was read, and
+  /// whether there are more than \p known_entries entries, to
+  /// \c DidProbeDirectory.
+  ///
+  /// The Viiiiva lists files in ascending index order, so new files are
+  /// appended: the fingerprint catches changes to the first entries, and the
+  /// entry count catches additions.  If the entries read don't settle the
+  /// count, the entry after the known ones is downloaded as well (in the same
+  /// waiting period).  Either way this costs a few packets rather than the
+  /// whole directory, so it's a cheap way to read the clock or to check
+  /// whether anything has changed since the last sync.  The entries
+  /// themselves are not reported.
+  ///
+  /// \param known_entries The number of entries when the directory was last
+  /// read.
+  void ProbeDirectory(uint16_t max_entries, uint16_t known_entries);
+
+  /// Downloads up to \p max_entries directory entries, starting from entry
+  /// \p first_entry.
+  ///
+  /// The first page (\p first_entry 0) includes the header, so the clock is
+  /// reported to \c DidParseClock.  The page's entries are reported to
+  /// \c DidParseDirectory, then \c DidDownloadDirectoryPage is called.
+  /// After a short page, \c DidFinishParsingDirectory is called, so a client
+  /// that requests pages until then sees the same callbacks as
+  /// \c DownloadDirectory.  Between pages, the client may issue other
+  /// commands, e.g. to download the files listed so far.
+  ///
+  /// Only the page is buffered, so memory use is bounded by \p max_entries
+  /// rather than the size of the directory.
+  void DownloadDirectoryPage(uint16_t first_entry, uint16_t max_entries);
+
+  /// Downloads the directory, but reports only the entries selected by
+  /// \p query to \c DidParseDirectory, in the query's order.
+  ///
+  /// The clock is reported to \c DidParseClock, and
+  /// \c DidFinishParsingDirectory is called after the last match, as for
+  /// \c DownloadDirectory.
+  void QueryDirectory(VLDirectoryQuery const &query);
+
+  /// Downloads file \p index, starting \p offset bytes in.
+  ///
+  /// A non-zero offset fetches only what a file has grown by since an
+  /// earlier download; \c DidDownloadFile is given just those bytes.
+  void DownloadFile(uint16_t index, uint32_t offset = 0);
 
   void EraseFile(uint16_t index);
 
+  /// Erases each file in \p indices, then downloads the directory once to
+  /// check which were really erased.
+  ///
+  /// The erase commands are issued back-to-back: the delegate sees one
+  /// \c DidStartWaiting and one \c DidFinishWaiting for the whole batch.
+  /// \c DidEraseFile is called as each reply arrives, the usual directory
+  /// callbacks are called for the refresh, and then \c DidEraseFiles reports
+  /// the outcome for each file.  A timeout abandons only the command that
+  /// timed out.
+  ///
+  /// \param count At most EraseBatch::kMaxFiles.
+  void EraseFiles(uint16_t const *indices, size_t count);
+
   void SetTime(time_t posix_time);
 
+  /// Returns a consistent copy of the manager's counters.
+  ///
+  /// Like \c EnqueueValue, this is safe to call from any thread.
+  VLManagerMetrics SnapshotMetrics() const { return metrics_.Snapshot(); }
+
+  /// Records the latency of subsequent commands in \p recorder.
+  ///
+  /// \param recorder Not owned; must outlive the manager, or be replaced.  May
+  /// be shared between managers called from the same thread.  Null disables
+  /// recording.
+  void SetLatencyRecorder(LatencyRecorder *_Nullable recorder) {
+    latency_ = recorder;
+  }
+
+  /// Records subsequent notifications, timeouts, written values and command
+  /// calls in \p writer, for replay with a Replayer.
+  ///
+  /// \param writer Not owned; must outlive the manager, or be replaced.  Null
+  /// disables capture.
+  void SetCaptureWriter(CaptureWriter *_Nullable writer) { capture_ = writer; }
+
 private:
+  /// Processes one value notification, for \c NotifyValue and
+  /// \c NotifyValues.
+  ///
+  /// \return True if the value finished the command or was an error.
+  bool ReadValue(uint8_t const *value, size_t length);
+
   void WritePacket(VLPacket const &packet) {
     WritePacket(packet, true);
   }
@@ -92,14 +322,133 @@ private:
   /// Serializes the packet and sends it to the delegate.
   void WritePacket(VLPacket const &packet, bool wait_for_ack);
 
+  /// Records the latency of a response read at time \p now.
+  ///
+  /// \param is_ack True if the response was the command's acknowledgement.
+  /// \param is_finished True if the response completed the command.
+  void RecordLatency(uint64_t now, bool is_ack, bool is_finished);
+
+  /// Reports an error with \p command to the delegate.
+  ///
+  /// \param what A description of the error.
+  void DidCommandError(
+      VLManagerErrorCode code, Command const &command, char const *what);
+
+  /// Destroys the in-progress command.
+  void ClearCommand();
+
+  /// Records an EraseFiles call in the capture, over as many records as it
+  /// takes.
+  void RecordEraseFiles(uint16_t const *indices, size_t count);
+
+  /// Abandons any erase batch or probe in progress, for a new command.
+  void AbandonSequences() {
+    batch_.Clear();
+    probe_tail_ = false;
+  }
+
+  // Issue commands, without checking for recursion or abandoning a batch.
+  void IssueDownloadDirectory();
+  void IssueProbeTail();
+  void IssueEraseFile(uint16_t index);
+
+  /// Issues the next command in batch_, or reports its results once there
+  /// are none left.
+  void ContinueBatch();
+
+  // Callbacks from the in-progress command.
+  void DidDownloadDirectory(uint16_t index, uint8_t *data, size_t length);
+  void DidProbeDirectory(uint16_t index, uint8_t const *data, size_t length);
+  void DidProbeTail(uint16_t index, uint8_t const *data, size_t length);
+  void DidDownloadDirectoryPage(uint16_t index, uint8_t *data, size_t length);
+  void DidQueryDirectory(uint16_t index, uint8_t *data, size_t length);
+
+  /// Decodes \p count raw entries from \p raw into the start of \p data,
+  /// and delivers them to the delegate.
+  void DeliverEntries(
+      uint8_t *data, VLRawDirectoryEntry const *raw, size_t count);
+  void DidDownloadFile(uint16_t index, uint8_t const *data, size_t length);
+  void DidEraseFile(uint16_t index, bool ok);
+  void DidSetTime(bool ok);
+
   ::std::unique_ptr<ManagerDelegate> const delegate_;
 
+  /// Inline storage for the in-progress command.
+  ::std::variant<
+      ::std::monostate, DownloadCommand, EraseCommand, SetTimeCommand>
+      storage_;
+
   /// The in-progress command.  Null if there is no command in progress, or the
-  /// command has a response.
-  ::std::unique_ptr<Command> command_;
+  /// command has a response.  Points into storage_.
+  Command *_Nullable command_ = nullptr;
+
+  /// The in-progress command (if it has a reply), or null.  Points into
+  /// storage_.
+  CommandWithReply *_Nullable response_ = nullptr;
+
+  /// Caller-supplied storage for downloads; may be null.  Not owned.
+  uint8_t *_Nullable const buffer_;
+
+  /// Size of buffer_ in bytes.
+  size_t const capacity_;
+
+  /// Values notified from other threads, waiting to be processed.
+  IngressQueue<kIngressQueueLength> ingress_;
+
+  Metrics metrics_;
+
+  /// Erase batch in progress, if active.
+  EraseBatch batch_;
+
+  /// True if \c DidStartWaiting has been called for batch_, so its later
+  /// commands don't call it again.
+  bool batch_waiting_ = false;
+
+  /// Parameters of the in-progress probe.
+  uint16_t probe_max_entries_ = 0;
+  uint16_t probe_known_entries_ = 0;
+
+  /// The probe's result, while the entry after the known ones is checked.
+  VLDirectoryProbe probe_ = {};
+
+  /// True if the probe needs (or is downloading) the entry after the known
+  /// ones, so its second command shares the first one's waiting period.
+  bool probe_tail_ = false;
+
+  /// Parameters of the in-progress directory page.
+  uint16_t page_first_entry_ = 0;
+  uint16_t page_max_entries_ = 0;
+
+  /// Fingerprint given to DownloadDirectoryIfChanged, if has_fingerprint_.
+  uint32_t fingerprint_ = 0;
+  bool has_fingerprint_ = false;
+
+  /// Query for the in-progress directory query.
+  VLDirectoryQuery query_ = {};
+
+  /// True if the in-progress command has been counted as failed.
+  bool command_failed_ = false;
+
+  /// Capture of the session, or null.  Not owned.
+  CaptureWriter *_Nullable capture_ = nullptr;
+
+  /// Histograms for command latency, or null.  Not owned.
+  LatencyRecorder *_Nullable latency_ = nullptr;
+
+  /// Kind of the in-progress command, for latency_.
+  VLLatencyKind latency_kind_ = kVLLatencyKindDownloadDirectory;
+
+  /// Time that the in-progress command was written.
+  uint64_t command_time_ = 0;
+
+  /// Time of the in-progress command's most recent response.
+  uint64_t response_time_ = 0;
+
+  /// Number of reply packets read by the in-progress command.
+  size_t reply_packets_ = 0;
 
-  /// The in-progress command (if it has a reply), or null.
-  ::std::unique_ptr<CommandWithReply> response_;
+  /// Bytes downloaded by the in-progress command.
+  size_t reply_bytes_ = 0;
 
   /// True if a function on this manager is already executing.  This can detect
   /// logic errors in delegate methods that recurse back into the manager.
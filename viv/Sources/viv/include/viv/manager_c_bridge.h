@@ -26,9 +26,16 @@
 #include <time.h>
 #endif
 
+#include "viv/capture.h"
 #include "viv/compat.h"
 #include "viv/directory_entry.h"
+#include "viv/directory_query.h"
+#include "viv/erase_result.h"
+#include "viv/latency.h"
 #include "viv/manager_error_code.h"
+#include "viv/manager_metrics.h"
+#include "viv/owned_buffer.h"
+#include "viv/sync_plan.h"
 
 #ifdef __clang__
 #pragma clang assume_nonnull begin
@@ -82,7 +89,8 @@ struct VLCProtocolManagerDelegate {
   /// clock.
   void (*_Nullable did_parse_clock)(void *_Nullable ctx, time_t posix_time);
 
-  /// Called for each directory entry encountered in the directory.
+  /// Called for each directory entry encountered in the directory, unless
+  /// \c did_parse_directory is set.
   ///
   /// The manager will call this after VLManagerDownloadDirectory.
   void (*_Nullable did_parse_directory_entry)(
@@ -94,11 +102,12 @@ struct VLCProtocolManagerDelegate {
   /// VLManagerDownloadDirectory is next called.
   void (*_Nullable did_finish_parsing_directory)(void *_Nullable ctx);
 
-  /// Called when the manager finishes downloading a file.
+  /// Called when the manager finishes downloading a file, unless
+  /// \c did_take_file is set.
   ///
   /// \param index The file's index.
   /// \param value The file contents.  The pointer is only valid for this call;
-  /// the callee should make a copy.
+  /// the callee should make a copy (or use \c did_take_file).
   /// \param length Number of bytes in \p value.
   void (*_Nullable did_download_file)(
       void *_Nullable ctx, uint16_t index, uint8_t const *value, size_t length);
@@ -113,6 +122,72 @@ struct VLCProtocolManagerDelegate {
   ///
   /// \param ok Non-zero if the clock was set.
   void (*_Nullable did_set_time)(void *_Nullable ctx, int ok);
+
+  /// Called when the manager finishes a batch started by VLManagerEraseFiles.
+  ///
+  /// \param results One result per file, in the order they were given.  The
+  /// pointer is only valid for this call.
+  /// \param count Number of elements in \p results.
+  void (*_Nullable did_erase_files)(
+      void *_Nullable ctx, VLEraseResult const *results, size_t count);
+
+  /// Called once the entries of a page started by
+  /// VLManagerDownloadDirectoryPage have been parsed.
+  ///
+  /// \param count The number of entries in the page.  If this is fewer than
+  /// were requested, it was the last page, and \c did_finish_parsing_directory
+  /// follows.
+  void (*_Nullable did_download_directory_page)(
+      void *_Nullable ctx, uint16_t first_entry, uint16_t count);
+
+  /// Called when the manager finishes a probe started by
+  /// VLManagerProbeDirectory.
+  void (*_Nullable did_probe_directory)(
+      void *_Nullable ctx, VLDirectoryProbe probe);
+
+  /// Called when a directory has been read, before its entries.
+  ///
+  /// \param fingerprint The directory's fingerprint, for a later
+  /// VLManagerDownloadDirectoryIfChanged.
+  /// \param unchanged Non-zero if it matched the fingerprint given to
+  /// VLManagerDownloadDirectoryIfChanged, in which case no entries follow.
+  void (*_Nullable did_fingerprint_directory)(
+      void *_Nullable ctx, uint32_t fingerprint, int unchanged);
+
+  /// Called with the raw directory once a whole directory has been
+  /// downloaded, before \c did_parse_clock.  E.g. for VLWriteDirectoryCache.
+  ///
+  /// \param data The directory header and entries.  The pointer is only valid
+  /// for this call.
+  void (*_Nullable did_read_directory)(
+      void *_Nullable ctx, uint8_t const *data, size_t length);
+
+  /// Called with the parsed directory entries, instead of calling
+  /// \c did_parse_directory_entry for each.
+  ///
+  /// Normally this is called once with every entry (or every entry of a
+  /// page).  If the buffer given to VLMakeManagerWithBuffer isn't aligned for
+  /// VLDirectoryEntry, it is called once per entry instead.
+  ///
+  /// \param entries Contiguous entries, in the order they would have been
+  /// given to \c did_parse_directory_entry.  The pointer is only valid for
+  /// this call.
+  /// \param count Number of elements in \p entries.
+  void (*_Nullable did_parse_directory)(
+      void *_Nullable ctx, VLDirectoryEntry const *entries, size_t count);
+
+  /// Called when the manager finishes downloading a file, instead of
+  /// \c did_download_file, handing over the buffer the file was downloaded
+  /// into rather than lending it.  Nothing is copied.
+  ///
+  /// Managers with a caller-supplied buffer (see VLMakeManagerWithBuffer)
+  /// always call \c did_download_file instead.
+  ///
+  /// \param index The file's index.
+  /// \param buffer The file contents.  The callee takes ownership, and must
+  /// release it.
+  void (*_Nullable did_take_file)(
+      void *_Nullable ctx, uint16_t index, VLOwnedBuffer buffer);
 };
 typedef struct VLCProtocolManagerDelegate VLManagerDelegate;
 
@@ -146,6 +221,7 @@ typedef struct {
   void *_Nullable manager;
 } VLCProtocolManager;
 
+#if !VL_NO_HEAP
 /// Creates a manager object.
 ///
 /// The caller takes ownership of the pointer, and must call VLDeleteManager.
@@ -155,6 +231,25 @@ typedef struct {
 extern VLCProtocolManager
 VLMakeManager(void *_Nullable ctx, VLManagerDelegate delegate)
     CF_SWIFT_NAME(VLCProtocolManager.init(ctx:delegate:));
+#endif
+
+/// Creates a manager object that accumulates downloads in \p buffer.
+///
+/// The manager will not allocate memory after it has been created.  Downloads
+/// that do not fit in \p buffer will fail.
+///
+/// The caller takes ownership of the pointer, and must call VLDeleteManager.
+///
+/// \param ctx Arbitrary pointer passed to all callbacks on \p delegate.
+/// \param delegate A collection of callbacks for the manager.
+/// \param buffer Storage for downloads; must outlive the manager.  May be null
+/// (unless VL_NO_HEAP is true), in which case this is equivalent to
+/// VLMakeManager.
+/// \param capacity Size of \p buffer in bytes.
+extern VLCProtocolManager VLMakeManagerWithBuffer(
+    void *_Nullable ctx, VLManagerDelegate delegate, uint8_t *_Nullable buffer,
+    size_t capacity)
+    CF_SWIFT_NAME(VLCProtocolManager.init(ctx:delegate:buffer:capacity:));
 
 /// Deletes a manager object previously created with VLMakeManager.
 ///
@@ -170,6 +265,45 @@ extern void VLManagerNotifyValue(
     VLCProtocolManager mgr, uint8_t const *value, size_t length)
     CF_SWIFT_NAME(VLCProtocolManager.notifyValue(self:value:length:));
 
+/// Notifies the manager of several GATT value notifications, in the order
+/// they were received.
+///
+/// The values are processed as if each were passed to VLManagerNotifyValue,
+/// but processing stops after a value that finishes any command or causes an
+/// error.  That includes each erase of a VLManagerEraseFiles batch, for which
+/// \c did_finish_waiting is only called at the end.
+///
+/// \param values The GATT attribute values.
+/// \param lengths Length of each value in bytes.
+/// \param count Number of elements in \p values and \p lengths.
+/// \return The number of values processed.  If this is less than \p count,
+/// the remaining values were not processed.
+extern size_t VLManagerNotifyValues(
+    VLCProtocolManager mgr, uint8_t const *const *values,
+    size_t const *lengths, size_t count)
+    CF_SWIFT_NAME(VLCProtocolManager.notifyValues(self:values:lengths:count:));
+
+/// Queues a GATT value notification for VLManagerDrainValues.
+///
+/// Unlike the other VLManager functions, this may be called from any thread,
+/// concurrently with other VLManager functions (except VLDeleteManager).
+///
+/// \param value The GATT attribute value.
+/// \param length Length of \p value in bytes.
+/// \return Non-zero if the value was dropped (the queue was full or the value
+/// was too long).
+extern int VLManagerEnqueueValue(
+    VLCProtocolManager mgr, uint8_t const *value, size_t length)
+    CF_SWIFT_NAME(VLCProtocolManager.enqueueValue(self:value:length:));
+
+/// Processes values queued by VLManagerEnqueueValue, as if each were passed to
+/// VLManagerNotifyValue.
+///
+/// \param max The maximum number of values to process.
+/// \return The number of values processed.
+extern size_t VLManagerDrainValues(VLCProtocolManager mgr, size_t max)
+    CF_SWIFT_NAME(VLCProtocolManager.drainValues(self:max:));
+
 /// Notifies the manager that was waiting for a response that the response was
 /// not received within a timeout period.
 extern void VLManagerNotifyTimeout(VLCProtocolManager mgr)
@@ -180,12 +314,86 @@ extern void VLManagerNotifyTimeout(VLCProtocolManager mgr)
 /// The manager will send a write request via the delegate, then call
 /// \c did_start_waiting.  After receiving the expected response and
 /// value notifications, the manager will parse the directory.  It will then
-/// call did_parse_directory_entry once for each valid entry found, then
+/// call \c did_parse_directory with the valid entries found (or
+/// \c did_parse_directory_entry once for each), then
 /// \c did_finish_parsing_directory.  Finally, it will call
 /// \c did_finish_waiting.
 extern void VLManagerDownloadDirectory(VLCProtocolManager mgr)
     CF_SWIFT_NAME(VLCProtocolManager.downloadDirectory(self:));
 
+/// Commands the manager to fetch the directory listing, and parse it only if
+/// it has changed.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c did_start_waiting.  After receiving the expected response and value
+/// notifications, it will call \c did_parse_clock, then
+/// \c did_fingerprint_directory.  If the fingerprint differs from
+/// \p fingerprint, it then parses the directory as for
+/// VLManagerDownloadDirectory.  Finally, it will call \c did_finish_waiting.
+///
+/// \param fingerprint The fingerprint from a previous
+/// \c did_fingerprint_directory call.
+extern void VLManagerDownloadDirectoryIfChanged(
+    VLCProtocolManager mgr, uint32_t fingerprint)
+    CF_SWIFT_NAME(
+        VLCProtocolManager.downloadDirectoryIfChanged(self:fingerprint:));
+
+/// Commands the manager to fetch the directory header and its first few
+/// entries.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c did_start_waiting.  After receiving the expected response and value
+/// notifications, it will call \c did_probe_directory with the Viiiiva's clock,
+/// a fingerprint of the entries read, and whether the directory has grown.
+/// Finally, it will call \c did_finish_waiting.
+///
+/// New files are appended to the directory, so the entries read may not show
+/// them; if not, the manager also downloads the entry after the known ones
+/// before calling \c did_probe_directory.
+///
+/// \param max_entries The number of entries to read.  Zero reads only the
+/// header (e.g. for the clock).
+/// \param known_entries The number of entries when the directory was last
+/// read.
+extern void VLManagerProbeDirectory(
+    VLCProtocolManager mgr, uint16_t max_entries, uint16_t known_entries)
+    CF_SWIFT_NAME(VLCProtocolManager.probeDirectory(
+        self:maxEntries:knownEntries:));
+
+/// Commands the manager to fetch one page of the directory listing.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c did_start_waiting.  After receiving the expected response and value
+/// notifications, it will parse the page: the first page (\p first_entry 0)
+/// includes the header, so the manager calls \c did_parse_clock.  It then
+/// calls \c did_parse_directory with the entries in the page, then
+/// \c did_download_directory_page.  If the page was short (the last page), it
+/// then calls \c did_finish_parsing_directory.  Finally, it will call
+/// \c did_finish_waiting.
+///
+/// Other commands may be issued between pages.
+///
+/// \param first_entry The number of entries before the page.
+/// \param max_entries The number of entries in a full page.
+extern void VLManagerDownloadDirectoryPage(
+    VLCProtocolManager mgr, uint16_t first_entry, uint16_t max_entries)
+    CF_SWIFT_NAME(
+        VLCProtocolManager.downloadDirectoryPage(self:firstEntry:maxEntries:));
+
+/// Commands the manager to fetch the directory listing, and report only the
+/// entries selected by \p query.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c did_start_waiting.  After receiving the expected response and value
+/// notifications, the manager will parse the directory.  It will call
+/// \c did_parse_clock, then \c did_parse_directory with the matching entries
+/// in the query's order (up to its limit), then
+/// \c did_finish_parsing_directory.  Finally, it will call
+/// \c did_finish_waiting.
+extern void
+VLManagerQueryDirectory(VLCProtocolManager mgr, VLDirectoryQuery query)
+    CF_SWIFT_NAME(VLCProtocolManager.queryDirectory(self:_:));
+
 /// Commands the manager to download a file.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -196,6 +404,15 @@ extern void VLManagerDownloadDirectory(VLCProtocolManager mgr)
 extern void VLManagerDownloadFile(VLCProtocolManager mgr, uint16_t index)
     CF_SWIFT_NAME(VLCProtocolManager.downloadFile(self:index:));
 
+/// Commands the manager to download the part of a file from \p offset bytes
+/// in, e.g. what it has grown by since an earlier download.
+///
+/// As for VLManagerDownloadFile, but \c did_download_file is given only the
+/// bytes from \p offset.
+extern void VLManagerDownloadFileFrom(
+    VLCProtocolManager mgr, uint16_t index, uint32_t offset)
+    CF_SWIFT_NAME(VLCProtocolManager.downloadFile(self:index:offset:));
+
 /// Commands the manager to download a file.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -206,6 +423,21 @@ extern void VLManagerDownloadFile(VLCProtocolManager mgr, uint16_t index)
 extern void VLManagerEraseFile(VLCProtocolManager mgr, uint16_t index)
     CF_SWIFT_NAME(VLCProtocolManager.eraseFile(self:index:));
 
+/// Commands the manager to erase several files, then check the directory.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c did_start_waiting.  It then erases each file in turn without waiting for
+/// another command, calling \c did_erase_file for each reply.  Once the files
+/// have been erased, it downloads and parses the directory as for
+/// VLManagerDownloadDirectory, then calls \c did_erase_files with whether each
+/// file was erased.  Finally, it will call \c did_finish_waiting.
+///
+/// \param indices The files to erase.
+/// \param count Number of elements in \p indices; at most 64.
+extern void VLManagerEraseFiles(
+    VLCProtocolManager mgr, uint16_t const *indices, size_t count)
+    CF_SWIFT_NAME(VLCProtocolManager.eraseFiles(self:indices:count:));
+
 /// Commands the manager to set the Viiiiva's time.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -214,6 +446,57 @@ extern void VLManagerEraseFile(VLCProtocolManager mgr, uint16_t index)
 extern void VLManagerSetTime(VLCProtocolManager mgr, time_t posix_time)
     CF_SWIFT_NAME(VLCProtocolManager.setTime(self:posixTime:));
 
+/// Commands the manager to carry out the first step of a plan from
+/// VLPlanSync.
+///
+/// Consecutive erase steps are issued as one VLManagerEraseFiles batch.  The
+/// next command can be issued after \c did_finish_waiting.
+///
+/// \param posix_time The time for a kVLSyncActionSetTime step, e.g. from
+/// VLClockCompensatedTime.
+/// \return The number of steps issued.
+extern size_t VLManagerIssueSyncSteps(
+    VLCProtocolManager mgr, VLSyncStep const *steps, size_t count,
+    time_t posix_time)
+    CF_SWIFT_NAME(VLCProtocolManager.issueSyncSteps(self:_:count:posixTime:));
+
+/// Returns a consistent copy of the manager's counters.
+///
+/// Like VLManagerEnqueueValue, this may be called from any thread.
+extern VLManagerMetrics VLManagerSnapshotMetrics(VLCProtocolManager mgr)
+    CF_SWIFT_NAME(VLCProtocolManager.snapshotMetrics(self:));
+
+/// Records the latency of subsequent commands in \p recorder.
+///
+/// \param recorder Not owned; must not be deleted while attached.  A recorder
+/// with a null pointer disables recording.
+extern void VLManagerSetLatencyRecorder(
+    VLCProtocolManager mgr, VLLatencyRecorder recorder)
+    CF_SWIFT_NAME(VLCProtocolManager.setLatencyRecorder(self:_:));
+
+/// Records subsequent notifications, timeouts and written values in
+/// \p writer.
+///
+/// \param writer Not owned; must not be deleted while attached.  A writer
+/// with a null pointer disables capture.
+extern void
+VLManagerSetCaptureWriter(VLCProtocolManager mgr, VLCaptureWriter writer)
+    CF_SWIFT_NAME(VLCProtocolManager.setCaptureWriter(self:_:));
+
+/// Replays a capture into the manager as fast as possible.
+///
+/// Captured notifications and timeouts are passed to the manager, and
+/// captured commands are re-issued, so the manager calls its delegate as it
+/// did in the captured session.  The manager should be freshly created.
+///
+/// \param data A capture written by a VLCaptureWriter.
+/// \param length Length of \p data in bytes.
+/// \return The number of events replayed, or negative if the capture is
+/// malformed.
+extern int VLManagerReplayCapture(
+    VLCProtocolManager mgr, uint8_t const *data, size_t length)
+    CF_SWIFT_NAME(VLCProtocolManager.replayCapture(self:data:length:));
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
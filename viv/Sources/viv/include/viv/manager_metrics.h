@@ -0,0 +1,95 @@
+// manager_metrics.h - counters for the manager
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_manager_metrics_h
+#define viv_manager_metrics_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#include "viv/compat.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// Snapshot of a manager's counters.
+///
+/// All counters are cumulative since the manager was created.
+struct VLManagerMetrics {
+  /// Value notifications passed to the manager.
+  uint64_t packets_received;
+
+  /// Values written to the delegate.
+  uint64_t packets_sent;
+
+  /// Notifications with a bad CRC.
+  uint64_t crc_failures;
+
+  /// Notifications with a bad length.
+  uint64_t length_failures;
+
+  /// Burst packets with an unexpected sequence number.
+  uint64_t seqno_errors;
+
+  /// Acknowledgements of commands received.
+  uint64_t acks;
+
+  /// Bytes of file (or directory) content received.
+  uint64_t bytes_downloaded;
+
+  /// Commands that received all their expected responses.
+  uint64_t commands_completed;
+
+  /// Commands that received an invalid response or timed out.
+  uint64_t commands_failed;
+
+  /// Timeout notifications while a command was in progress.
+  uint64_t timeouts;
+};
+typedef struct VLManagerMetrics VLManagerMetrics;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Adds each counter in \p from to the corresponding counter in \p into.
+extern void
+VLMergeManagerMetrics(VLManagerMetrics *into, VLManagerMetrics const *from);
+
+/// Writes \p metrics to \p buf in the OpenMetrics text format.
+///
+/// \param buf Buffer for the text; it will always be null-terminated unless
+/// \p length is zero.
+/// \param length Size of \p buf in bytes.
+/// \return The length of the full text (excluding the terminator), like
+/// snprintf.  If this is not less than \p length, the text was truncated.
+extern size_t VLFormatManagerMetrics(
+    VLManagerMetrics const *metrics, char *_Nullable buf, size_t length);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_manager_metrics_h */
@@ -28,6 +28,7 @@
 
 #include "viv/compat.h"
 #include "viv/directory_entry.h"
+#include "viv/directory_query.h"
 #include "viv/manager_error_code.h"
 
 #pragma clang assume_nonnull begin
@@ -72,21 +73,59 @@
 /// \param posixTime Seconds since 1970-01-01 according to the Viiiiva's clock.
 - (void)didParseClock:(time_t)posixTime;
 
-/// Called for each directory entry encountered in the directory.
+/// Called for each directory entry encountered in the directory, unless the
+/// delegate implements \c didParseDirectory:count:.
 ///
 /// The manager will call this after VLManagerDownloadDirectory.
 - (void)didParseDirectoryEntry:(VLDirectoryEntry)entry;
 
+/// Called with the parsed directory entries, instead of calling
+/// \c didParseDirectoryEntry: for each.
+///
+/// Normally this is called once with every entry (or every entry of a page).
+///
+/// \param entries Contiguous entries, in the order they would have been given
+/// to \c didParseDirectoryEntry:.  The pointer is only valid for this call.
+/// \param count Number of elements in \p entries.
+- (void)didParseDirectory:(VLDirectoryEntry const *)entries
+                    count:(size_t)count;
+
 /// Called once all directory entries have been parsed.
 ///
 /// The manager will not call \c did_parse_directory_entry again until
 /// \c downloadDirectory is next called.
 - (void)didFinishParsingDirectory;
 
+/// Called once the entries of a page started by
+/// \c downloadDirectoryPage:maxEntries: have been parsed.
+///
+/// \param count The number of entries in the page.  If this is fewer than
+/// were requested, it was the last page, and \c didFinishParsingDirectory
+/// follows.
+- (void)didDownloadDirectoryPage:(uint16_t)firstEntry count:(uint16_t)count;
+
+/// Called when the manager finishes a probe started by \c probeDirectory:.
+- (void)didProbeDirectory:(VLDirectoryProbe)probe;
+
+/// Called when a directory has been read, before its entries.
+///
+/// \param fingerprint The directory's fingerprint, for a later
+/// \c downloadDirectoryIfChanged:.
+/// \param unchanged True if it matched the fingerprint given to
+/// \c downloadDirectoryIfChanged:, in which case no entries follow.
+- (void)didFingerprintDirectory:(uint32_t)fingerprint
+                      unchanged:(BOOL)unchanged;
+
+/// Called with the raw directory (header and entries) once a whole directory
+/// has been downloaded, before \c didParseClock.  E.g. for
+/// VLWriteDirectoryCache.
+- (void)didReadDirectory:(NSData *)data;
+
 /// Called when the manager finishes downloading a file.
 ///
 /// \param index The file's index.
-/// \param data The file contents.
+/// \param data The file contents.  This wraps the manager's download buffer,
+/// which is handed over without copying.
 - (void)didDownloadFile:(uint16_t)index data:(NSData *)data;
 
 /// Called when the manager finishes erasing file.
@@ -98,6 +137,18 @@
 ///
 /// \param ok \c YES if the clock was set.
 - (void)didSetTime:(BOOL)ok;
+
+/// Called when the manager finishes a batch started by \c eraseFiles:.
+///
+/// Each of the files is in exactly one of the sets.
+///
+/// \param erased Files that are no longer in the directory.
+/// \param failed Files the Viiiiva failed to erase.
+/// \param stillPresent Files the Viiiiva reported erased, but that are still
+/// in the directory.
+- (void)didEraseFiles:(NSIndexSet *)erased
+               failed:(NSIndexSet *)failed
+         stillPresent:(NSIndexSet *)stillPresent;
 @end
 
 /// Error domain for the libviv Manager.
@@ -150,6 +201,34 @@ extern const NSErrorDomain VLOManagerErrorDomain;
 /// \param data The GATT attribute value.
 - (void)notifyValue:(NSData *)data;
 
+/// Notifies the manager of several GATT value notifications, in the order
+/// they were received.
+///
+/// The values are processed as if each were passed to \c notifyValue:, but
+/// processing stops after a value that finishes any command or causes an
+/// error.  That includes each erase of an \c eraseFiles: batch, for which
+/// \c didFinishWaiting is only sent at the end.
+///
+/// \param values The GATT attribute values.
+/// \return The number of values processed.  If this is less than the number
+/// of \p values, the remaining values were not processed.
+- (NSUInteger)notifyValues:(NSArray<NSData *> *)values;
+
+/// Queues a GATT value notification for \c drainValues.
+///
+/// Unlike the other methods, this may be called from any thread.
+///
+/// \param data The GATT attribute value.
+/// \return \c NO if the value was dropped (the queue was full or the value
+/// was too long).
+- (BOOL)enqueueValue:(NSData *)data;
+
+/// Processes all values queued by \c enqueueValue:, as if each were passed to
+/// \c notifyValue:.
+///
+/// \return The number of values processed.
+- (NSUInteger)drainValues;
+
 /// Notifies the manager that was waiting for a response that the response was
 /// not received within a timeout period.
 - (void)notifyTimeout;
@@ -159,10 +238,68 @@ extern const NSErrorDomain VLOManagerErrorDomain;
 /// The manager will send a write request via the delegate, then call
 /// \c didStartWaiting.  After receiving the expected response and
 /// value notifications, the manager will parse the directory.  It will then
-/// call \c didParseDirectoryEntry once for each valid entry found, then
+/// call \c didParseDirectory:count: with the valid entries found (or
+/// \c didParseDirectoryEntry once for each), then
 /// \c didFinishParsingDirectory.  Finally, it will call \c didFinishWaiting.
 - (void)downloadDirectory;
 
+/// Commands the manager to fetch the directory listing, and parse it only if
+/// it has changed.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c didStartWaiting.  After receiving the expected response and value
+/// notifications, it will call \c didParseClock, then
+/// \c didFingerprintDirectory:unchanged:.  If the fingerprint differs from
+/// \p fingerprint, it then parses the directory as for
+/// \c downloadDirectory.  Finally, it will call \c didFinishWaiting.
+- (void)downloadDirectoryIfChanged:(uint32_t)fingerprint;
+
+/// Commands the manager to fetch the directory header and its first few
+/// entries.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c didStartWaiting.  After receiving the expected response and value
+/// notifications, it will call \c didProbeDirectory: with the Viiiiva's clock,
+/// a fingerprint of the entries read, and whether the directory has grown.
+/// Finally, it will call \c didFinishWaiting.
+///
+/// \param maxEntries The number of entries to read; zero reads only the
+/// header.
+/// \param knownEntries The number of entries when the directory was last
+/// read.  If the entries read don't show whether there are more, the entry
+/// after the known ones is downloaded too.
+- (void)probeDirectory:(uint16_t)maxEntries
+          knownEntries:(uint16_t)knownEntries;
+
+/// Commands the manager to fetch one page of the directory listing.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c didStartWaiting.  After receiving the expected response and value
+/// notifications, it will parse the page: the first page includes the header,
+/// so the manager calls \c didParseClock.  It then calls
+/// \c didParseDirectory:count: with the entries in the page, then
+/// \c didDownloadDirectoryPage.  If the page was short (the last page), it
+/// then calls \c didFinishParsingDirectory.  Finally, it will call
+/// \c didFinishWaiting.
+///
+/// Other commands may be issued between pages.
+///
+/// \param firstEntry The number of entries before the page.
+/// \param maxEntries The number of entries in a full page.
+- (void)downloadDirectoryPage:(uint16_t)firstEntry
+                   maxEntries:(uint16_t)maxEntries;
+
+/// Commands the manager to fetch the directory listing, and report only the
+/// entries selected by \p query.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c didStartWaiting.  After receiving the expected response and value
+/// notifications, it will call \c didParseClock, then
+/// \c didParseDirectory:count: with the matching entries in the query's order
+/// (up to its limit), then \c didFinishParsingDirectory.  Finally, it will call
+/// \c didFinishWaiting.
+- (void)queryDirectory:(VLDirectoryQuery)query;
+
 /// Commands the manager to download a file.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -171,6 +308,13 @@ extern const NSErrorDomain VLOManagerErrorDomain;
 /// then call \c didDownloadFile.  Finally, it will call \c didFinishWaiting.
 - (void)downloadFile:(uint16_t)index;
 
+/// Commands the manager to download the part of a file from \p offset bytes
+/// in, e.g. what it has grown by since an earlier download.
+///
+/// As for \c downloadFile:, but \c didDownloadFile is given only the bytes
+/// from \p offset.
+- (void)downloadFile:(uint16_t)index fromOffset:(uint32_t)offset;
+
 /// Commands the manager to download a file.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -179,6 +323,17 @@ extern const NSErrorDomain VLOManagerErrorDomain;
 /// then call \c didEraseFile.  Finally, it will call \c didFinishWaiting.
 - (void)eraseFile:(uint16_t)index;
 
+/// Commands the manager to erase several files, then check the directory.
+///
+/// The manager will send a write request via the delegate, then call
+/// \c didStartWaiting.  It then erases each file in turn, calling
+/// \c didEraseFile for each reply.  Once the files have been erased, it
+/// downloads and parses the directory as for \c downloadDirectory, then calls
+/// \c didEraseFiles.  Finally, it will call \c didFinishWaiting.
+///
+/// \param indices The files to erase; at most 64.
+- (void)eraseFiles:(NSIndexSet *)indices;
+
 /// Commands the manager to set the Viiiiva's time.
 ///
 /// The manager will send a write request via the delegate, then call
@@ -0,0 +1,153 @@
+// metrics.hpp - lock-free counters
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_metrics_hpp
+#define viv_metrics_hpp
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/compat.h"
+#include "viv/manager_metrics.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Counters updated by a single writer and read by any thread.
+///
+/// The writer brackets updates with a \c Metrics::Update; readers retry until
+/// they see no update in progress (a seqlock), so a snapshot never contains
+/// half of an update.
+class Metrics {
+public:
+  /// Identifies a counter; each corresponds to a VLManagerMetrics member.
+  enum Counter {
+    kPacketsReceived,
+    kPacketsSent,
+    kCrcFailures,
+    kLengthFailures,
+    kSeqnoErrors,
+    kAcks,
+    kBytesDownloaded,
+    kCommandsCompleted,
+    kCommandsFailed,
+    kTimeouts,
+    kNumCounters,
+  };
+
+  /// Scoped write access.  Only one thread may write at a time.
+  ///
+  /// Readers spin while an update is in progress, so an update must be brief,
+  /// and must not span a call into client code (which might take a snapshot
+  /// on the same thread).
+  class Update {
+  public:
+    explicit Update(Metrics &metrics) noexcept : metrics_(metrics) {
+      metrics_.BeginUpdate();
+    }
+
+    Update(const Update &) = delete;
+    Update &operator=(const Update &) = delete;
+
+    ~Update() { metrics_.EndUpdate(); }
+
+  private:
+    Metrics &metrics_;
+  };
+
+  Metrics() noexcept {
+    for (auto &counter : counters_) {
+      counter.store(0, ::std::memory_order_relaxed);
+    }
+  }
+
+  // Disallow copy/move semantics.
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  /// Adds \p n to \p counter.  Must be called within an Update.
+  void Add(Counter counter, uint64_t n = 1) {
+    assert(seq_.load(::std::memory_order_relaxed) & 1);
+    // Only the writer modifies counters, so no read-modify-write is needed.
+    auto &c = counters_[counter];
+    c.store(
+        c.load(::std::memory_order_relaxed) + n, ::std::memory_order_relaxed);
+  }
+
+  /// Returns a consistent copy of the counters.  Safe to call from any thread.
+  VLManagerMetrics Snapshot() const;
+
+private:
+  void BeginUpdate() {
+    if (depth_++ == 0) {
+      seq_.store(seq_.load(::std::memory_order_relaxed) + 1,
+                 ::std::memory_order_relaxed);
+      ::std::atomic_thread_fence(::std::memory_order_release);
+    }
+  }
+
+  void EndUpdate() {
+    if (--depth_ == 0) {
+      seq_.store(seq_.load(::std::memory_order_relaxed) + 1,
+                 ::std::memory_order_release);
+    }
+  }
+
+  /// Sequence number; odd while an update is in progress.
+  ::std::atomic<uint32_t> seq_{0};
+
+  /// Nesting level of Update objects (only accessed by the writer).
+  int depth_ = 0;
+
+  ::std::atomic<uint64_t> counters_[kNumCounters];
+};
+
+/// Merges snapshots from many managers.
+class MetricsAggregator {
+public:
+  MetricsAggregator() noexcept : total_(), count_(0) {}
+
+  /// Adds the counters from one manager's snapshot.
+  void Add(VLManagerMetrics const &metrics) {
+    VLMergeManagerMetrics(&total_, &metrics);
+    ++count_;
+  }
+
+  /// Returns the sum of all snapshots added.
+  VLManagerMetrics const &total() const { return total_; }
+
+  /// Returns the number of snapshots added.
+  size_t count() const { return count_; }
+
+  /// Writes the total in the OpenMetrics text format.
+  ///
+  /// \return The length of the full text, like snprintf.
+  size_t WriteOpenMetrics(char *_Nullable buf, size_t length) const {
+    return VLFormatManagerMetrics(&total_, buf, length);
+  }
+
+private:
+  VLManagerMetrics total_;
+  size_t count_;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_metrics_hpp */
@@ -0,0 +1,56 @@
+// owned_buffer.h - buffers handed over to libviv clients
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_owned_buffer_h
+#define viv_owned_buffer_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// A buffer whose ownership has passed from libviv to the client.
+///
+/// The client must call \c release exactly once, with \c owner, when it has
+/// finished with \c data.  Until then, \c data stays valid, and it may be
+/// handed on (e.g. to a Swift \c Data with a custom deallocator) without
+/// copying.
+struct VLOwnedBuffer {
+  /// The contents, or null if \c length is zero.
+  uint8_t *_Nullable data;
+
+  /// Number of bytes in \c data.
+  size_t length;
+
+  /// Opaque owner of \c data, to pass to \c release.
+  void *_Nullable owner;
+
+  /// Frees \c data.
+  void (*release)(void *_Nullable owner);
+};
+typedef struct VLOwnedBuffer VLOwnedBuffer;
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_owned_buffer_h */
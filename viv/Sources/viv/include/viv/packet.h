@@ -103,7 +103,8 @@ extern uint8_t VLGetNextSeqno(uint8_t seqno);
 extern int VLDoesSeqnoMatch(uint8_t seqno, uint8_t expected);
 
 /// Reads a packet with \p length bytes from \p src, into \p packet.
-/// \return Non-zero if the packet was invalid (bad CRC or length).
+/// \return Non-zero if the packet was invalid: -1 for a bad length, or -2 for
+/// a bad CRC.
 extern int VLReadPacket(VLPacket *packet, uint8_t const *src, size_t length);
 
 /// Returns non-zero if \p packet is not marked as coming from Viiiiva.
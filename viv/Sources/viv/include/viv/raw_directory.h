@@ -113,6 +113,16 @@ extern int VLReadDirectoryHeader(
 extern int VLReadNextDirectoryEntry(
     VLRawDirectoryEntry *entry, uint8_t const *src, size_t length);
 
+/// Hashes the raw directory in \p src, ignoring the clock in its header.
+///
+/// The hash is 32-bit FNV-1a.  It changes when files are added, removed or
+/// resized, so comparing it with a stored value is a cheap way of telling
+/// whether the directory has changed.
+///
+/// \param src A directory header followed by zero or more entries.
+/// \param length The size of the buffer in bytes.
+extern uint32_t VLDirectoryFingerprint(uint8_t const *src, size_t length);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,91 @@
+// replayer.hpp - drives a manager from a capture
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_replayer_hpp
+#define viv_replayer_hpp
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/callback.hpp"
+#include "viv/capture.hpp"
+#include "viv/compat.h"
+#include "viv/erase_batch.hpp"
+#include "viv/manager.hpp"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Replays a capture into a manager.
+///
+/// Captured notifications and timeouts are passed to the manager as-is, and
+/// captured command calls are made again with the same arguments.  The
+/// manager then writes its own values to its delegate, so captured writes
+/// only set the pacing.
+class Replayer {
+public:
+  /// Waits for \p delay (in the capture's clock units) before the next event.
+  using Wait = Callback<void(uint64_t delay)>;
+
+  /// \param manager Not owned; must outlive the replayer.  Should be fresh, so
+  /// that it is in the same state as the captured manager was.
+  /// \param data The capture.  Not owned; must outlive the replayer.
+  /// \param wait Called between events to reproduce the captured pacing.  If
+  /// empty, events are replayed as fast as possible.
+  Replayer(
+      Manager &manager, uint8_t const *data, size_t length,
+      Wait wait = Wait()) noexcept
+      : manager_(manager), reader_(data, length), wait_(wait) {}
+
+  // Disallow copy/move semantics.
+  Replayer(const Replayer &) = delete;
+  Replayer &operator=(const Replayer &) = delete;
+
+  /// Replays the next event.
+  ///
+  /// \return 1 if an event was replayed, 0 at the end of the capture, or
+  /// negative if the capture is malformed.
+  int Step();
+
+  /// Replays all remaining events.
+  ///
+  /// \return The number of events replayed, or negative if the capture is
+  /// malformed.
+  int Run();
+
+private:
+  /// Makes the call recorded in \p event.
+  int ReplayCall(CaptureEvent const &event);
+
+  Manager &manager_;
+  CaptureReader reader_;
+  Wait const wait_;
+
+  /// Indices of an EraseFiles call split over several records.  There's one
+  /// spare, so that a batch that was too large is still rejected.
+  uint16_t erase_indices_[EraseBatch::kMaxFiles + 1];
+  size_t erase_count_ = 0;
+
+  /// Timestamp of the previous event, if has_time_.
+  uint64_t time_ = 0;
+  bool has_time_ = false;
+};
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_replayer_hpp */
@@ -18,6 +18,7 @@
 
 #include <cstdint>
 
+#include "viv/callback.hpp"
 #include "viv/command.hpp"
 #include "viv/compat.h"
 #include "viv/packet.h"
@@ -33,16 +34,17 @@ public:
   ///
   /// The boolean parameter is true if the erase was successful, false
   /// otherwise.
-  using OnFinishCallback = ::std::function<void(bool)>;
+  using OnFinishCallback = Callback<void(bool)>;
 
   explicit SetTimeCommand(uint32_t ant_time, OnFinishCallback on_finish)
-    noexcept : on_finish_(std::move(on_finish)), time_(ant_time) {}
+    noexcept : on_finish_(on_finish), time_(ant_time) {}
 
   VLPacket MakeCommandPacket() const override;
   int ReadPacket(VLPacket const &packet) override;
-  bool MaybeFinish() const override;
+  bool MaybeFinish() override;
+  bool has_ack() const override { return has_ack_; }
 
-  ::std::string name() const override { return "set time command"; }
+  char const *name() const override { return "set time command"; }
 
 private:
   OnFinishCallback const on_finish_;
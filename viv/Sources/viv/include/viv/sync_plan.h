@@ -0,0 +1,153 @@
+// sync_plan.h - planning a sync from the directory and local files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_sync_plan_h
+#define viv_sync_plan_h
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+#include "viv/clock_discipline.h"
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+#include "viv/directory_query.h"
+
+#ifdef __clang__
+#pragma clang assume_nonnull begin
+#endif
+
+/// A file that the host has already ingested from the Viiiiva.
+struct VLLocalFile {
+  /// Index of the file on the Viiiiva.
+  uint16_t index;
+
+  /// File time from the directory entry it was downloaded from, in seconds
+  /// since POSIX epoch.
+  time_t posix_time;
+
+  /// Number of bytes ingested.
+  uint32_t length;
+
+  /// The host's checksum of the ingested bytes, or zero if the host couldn't
+  /// verify them (e.g. the download was interrupted).  libviv doesn't
+  /// interpret the value otherwise.
+  uint32_t checksum;
+};
+typedef struct VLLocalFile VLLocalFile;
+
+/// What a step of a sync does.
+VL_ENUM(uint8_t, VLSyncAction){
+    /// Download the whole file (VLManagerDownloadFile).
+    kVLSyncActionDownload = 0,
+
+    /// Download the part of a file that has grown since it was ingested
+    /// (VLManagerDownloadFileFrom).
+    kVLSyncActionResume = 1,
+
+    /// Erase a file that has been ingested (VLManagerEraseFiles).
+    kVLSyncActionErase = 2,
+
+    /// Set the Viiiiva's clock (VLManagerSetTime).
+    kVLSyncActionSetTime = 3,
+};
+typedef enum VLSyncAction VLSyncAction;
+
+/// One command in a sync plan.
+struct VLSyncStep {
+  VLSyncAction action;
+
+  /// Byte offset to download from, for kVLSyncActionResume; otherwise zero.
+  uint32_t offset;
+
+  /// The file's directory entry; zeroed for kVLSyncActionSetTime.
+  VLDirectoryEntry entry;
+};
+typedef struct VLSyncStep VLSyncStep;
+
+/// What a sync should do.
+struct VLSyncPolicy {
+  /// The files to sync.  Its order and limit are ignored.
+  VLDirectoryQuery filter;
+
+  /// What is known about the Viiiiva's clock.
+  VLClockState clock;
+
+  VLClockOptions clock_options;
+
+  /// The host's clock, in seconds since 1970-01-01.
+  double host_time;
+
+  /// The clock's offset measured from the directory (VLClockMeasureOffset),
+  /// or NAN to predict it from \c clock.
+  double clock_offset;
+
+  /// Non-zero to erase files that were completely ingested before this sync.
+  uint8_t erase_ingested;
+};
+typedef struct VLSyncPolicy VLSyncPolicy;
+
+#ifdef __cplusplus
+extern "C" {
+using ::std::time_t;
+#endif
+
+/// Returns a policy that syncs every file, erases nothing, and sets the clock
+/// when VLClockShouldSet says to (with default options and no history).
+extern VLSyncPolicy VLSyncDefaultPolicy(void)
+    CF_SWIFT_NAME(VLSyncPolicy.init());
+
+/// Plans the commands that bring the host's files up to date with the
+/// Viiiiva's directory, with as little airtime as possible.
+///
+/// Only readable files matching the policy's filter are considered:
+///
+///  - New files, files whose index has been reused (the time differs), files
+///    that have shrunk and files the host couldn't verify (zero checksum) are
+///    downloaded in full.
+///  - Files that have grown are resumed from the ingested length.
+///  - With \c erase_ingested, erasable files that are completely ingested are
+///    erased.
+///
+/// The plan resumes first, then downloads (oldest first), then erases, then
+/// sets the clock.  Files downloaded by a plan are erased by the next one,
+/// once the host has verified them.
+///
+/// \param directory The raw directory, e.g. from \c did_read_directory.
+/// \param local The ingested files, in ascending order of index.
+/// \param[out] steps Destination for the plan.  Nothing is written unless the
+/// whole plan fits; at most one step per entry, plus one, is needed.
+/// \return The number of steps in the plan (which may exceed \p capacity), or
+/// negative if the directory is invalid or \p local isn't sorted.
+extern int VLPlanSync(
+    uint8_t const *directory, size_t length, VLLocalFile const *_Nullable local,
+    size_t local_count, VLSyncPolicy const *policy, VLSyncStep *_Nullable steps,
+    size_t capacity);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __clang__
+#pragma clang assume_nonnull end
+#endif
+
+#endif /* viv_sync_plan_h */
@@ -0,0 +1,101 @@
+// sync_plan.hpp - planning a sync from the directory and local files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_sync_plan_hpp
+#define viv_sync_plan_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include "directory.hpp"
+#include "directory_query.hpp"
+#include "ingest_index.h"
+#include "ingest_index.hpp"
+#include "manager.hpp"
+#include "sync_plan.h"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+/// Plans a sync (see VLPlanSync).
+///
+/// Planning doesn't allocate: the directory is read in place, ingested files
+/// are found by binary search, and the plan is written to a caller-supplied
+/// array.
+class SyncPlanner {
+public:
+  explicit SyncPlanner(VLSyncPolicy const &policy) noexcept
+      : policy_(policy), filter_(policy.filter) {}
+
+  /// Writes the plan for \p dir into \p steps, if it fits.
+  ///
+  /// \param local The ingested files, in ascending order of index.
+  /// \return The number of steps in the plan, or -1 if \p local isn't sorted.
+  int Plan(
+      DirectoryView const &dir, VLLocalFile const *_Nullable local,
+      size_t local_count, VLSyncStep *_Nullable steps, size_t capacity) const;
+
+  /// Writes the plan for \p dir into \p steps, if it fits, using the files
+  /// recorded in \p index for \p device.
+  ///
+  /// \return The number of steps in the plan.
+  int Plan(
+      DirectoryView const &dir, IngestIndex const &index,
+      VLDeviceId const &device, VLSyncStep *_Nullable steps,
+      size_t capacity) const;
+
+  /// Decides what to do with one entry.
+  ///
+  /// \param local The ingested copy of the file, or null.
+  /// \param[out] step The step to take.
+  /// \return Whether any step is needed.
+  bool PlanEntry(
+      DirectoryEntry const &entry, VLLocalFile const *_Nullable local,
+      VLSyncStep &step) const;
+
+  /// Returns whether the plan should set the clock.
+  bool ShouldSetTime() const;
+
+private:
+  /// Plans with \p find, which looks up the ingested copy of a file.
+  template <typename F>
+  int PlanWith(
+      DirectoryView const &dir, F &&find, VLSyncStep *_Nullable steps,
+      size_t capacity) const;
+
+  VLSyncPolicy const policy_;
+  DirectoryQuery const filter_;
+};
+
+/// Issues the first command of a plan to \p manager.
+///
+/// Consecutive erase steps are issued as one batch (Manager::EraseFiles).
+///
+/// \param posix_time The time for a kVLSyncActionSetTime step, e.g. from
+/// VLClockCompensatedTime.
+/// \return The number of steps issued, or 0 if \p count is 0.  The next
+/// command can be issued once the manager calls
+/// ManagerDelegate::DidFinishWaiting.
+size_t IssueSyncSteps(
+    Manager &manager, VLSyncStep const *steps, size_t count,
+    time_t posix_time);
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
+
+#endif /* viv_sync_plan_hpp */
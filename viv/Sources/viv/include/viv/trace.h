@@ -0,0 +1,54 @@
+// trace.h - static tracepoints
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef viv_trace_h
+#define viv_trace_h
+
+#include "viv/compat.h"
+
+/// \file
+/// VL_TRACEn(name, args...) marks a static tracepoint called \c name with
+/// \c n arguments, in the "viv" provider.
+///
+/// Tracepoints are only compiled in if VL_ENABLE_TRACE is true on a platform
+/// with SystemTap-style USDT probes (Linux with <sys/sdt.h>).  Each
+/// tracepoint is then a single nop until a tracer such as bpftrace attaches
+/// to it; see the scripts in viv/Scripts.  Otherwise, the macros expand to
+/// nothing and their arguments are not evaluated.
+
+#ifndef VL_ENABLE_TRACE
+#define VL_ENABLE_TRACE 0
+#endif /* ndef VL_ENABLE_TRACE */
+
+#if VL_ENABLE_TRACE && defined(__linux__) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define VL_TRACE1(_name, _a) DTRACE_PROBE1(viv, _name, _a)
+#define VL_TRACE2(_name, _a, _b) DTRACE_PROBE2(viv, _name, _a, _b)
+#define VL_TRACE3(_name, _a, _b, _c) DTRACE_PROBE3(viv, _name, _a, _b, _c)
+#define VL_TRACE4(_name, _a, _b, _c, _d)                                       \
+  DTRACE_PROBE4(viv, _name, _a, _b, _c, _d)
+
+#else /* !VL_ENABLE_TRACE */
+
+#define VL_TRACE1(_name, _a)
+#define VL_TRACE2(_name, _a, _b)
+#define VL_TRACE3(_name, _a, _b, _c)
+#define VL_TRACE4(_name, _a, _b, _c, _d)
+
+#endif /* !VL_ENABLE_TRACE */
+
+#endif /* viv_trace_h */
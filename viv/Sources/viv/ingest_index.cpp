@@ -0,0 +1,425 @@
+// ingest_index.cpp - persistent index of ingested files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/ingest_index.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "viv/crc.hpp"
+#include "viv/directory.hpp"
+#include "viv/directory_entry.h"
+#include "viv/endian.hpp"
+#include "viv/ingest_index.h"
+#include "viv/sync_plan.h"
+#include "viv/sync_plan.hpp"
+
+namespace {
+
+/// Magic number and version.  The version changes if the format does.
+constexpr uint8_t kFileMagic[] = {'V', 'I', 'V', 'I', 'D', 'X', 1, 0};
+
+// Offsets of the header fields.
+constexpr size_t kRecordLengthOffset = 8;
+
+// Offsets of the record fields.
+constexpr size_t kDeviceOffset = 0;
+constexpr size_t kTimeOffset = 16;
+constexpr size_t kLengthOffset = 24;
+constexpr size_t kChecksumOffset = 28;
+constexpr size_t kIndexOffset = 32;
+constexpr size_t kKindOffset = 34;
+constexpr size_t kCrcOffset = 44;
+
+/// What a record says about its file.
+enum RecordKind : uint8_t {
+  kRecordIngested = 1,
+  kRecordForgotten = 2,
+};
+
+/// Minimum number of superseded records before compacting is worthwhile.
+constexpr size_t kMinCompactRecords = 64;
+
+// 32-bit FNV-1a parameters.
+constexpr uint32_t kFnvOffsetBasis = 2166136261UL;
+constexpr uint32_t kFnvPrime = 16777619UL;
+
+static_assert(
+    kCrcOffset + sizeof(uint32_t) == viv::IngestIndex::kRecordLength,
+    "The CRC must end the record");
+
+static_assert(
+    sizeof(VLDeviceId) == kTimeOffset - kDeviceOffset,
+    "VLDeviceId must fill its field");
+
+/// Returns whether \p record holds \p device and \p file_index.
+bool
+HasKey(uint8_t const *record, VLDeviceId const &device, uint16_t file_index) {
+  return OSReadLittleInt16(record, kIndexOffset) == file_index &&
+         !std::memcmp(record + kDeviceOffset, device.bytes, sizeof(device));
+}
+
+/// Returns whether \p record is whole: a known kind, with a matching CRC.
+bool
+IsValid(uint8_t const *record) {
+  uint8_t const kind = record[kKindOffset];
+  return (kind == kRecordIngested || kind == kRecordForgotten) &&
+         OSReadLittleInt32(record, kCrcOffset) ==
+             viv::crc32(record, kCrcOffset);
+}
+
+/// Returns whether \p length bytes from \p p are all zero.
+bool
+IsZero(uint8_t const *p, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (p[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Fills in \p record, apart from its CRC.
+void
+WriteRecord(
+    uint8_t *record, VLDeviceId const &device, VLLocalFile const &file,
+    RecordKind kind) {
+  std::memset(record, 0, viv::IngestIndex::kRecordLength);
+  std::memcpy(record + kDeviceOffset, device.bytes, sizeof(device));
+  uint64_t const time = static_cast<uint64_t>(file.posix_time);
+  VLWriteLittleInt32(record, kTimeOffset, static_cast<uint32_t>(time));
+  VLWriteLittleInt32(
+      record, kTimeOffset + 4, static_cast<uint32_t>(time >> 32));
+  VLWriteLittleInt32(record, kLengthOffset, file.length);
+  VLWriteLittleInt32(record, kChecksumOffset, file.checksum);
+  VLWriteLittleInt16(record, kIndexOffset, file.index);
+  record[kKindOffset] = kind;
+}
+
+} // namespace
+
+namespace viv {
+
+VLIngestState
+IngestStateOf(
+    VLDirectoryEntry const &entry, VLLocalFile const *_Nullable file) {
+  if (file == nullptr) {
+    return kVLIngestStateNew;
+  }
+  if (file->posix_time != entry.posix_time || file->checksum == 0 ||
+      file->length > entry.length) {
+    return kVLIngestStateStale;
+  }
+  return (file->length < entry.length) ? kVLIngestStatePartial
+                                       : kVLIngestStateIngested;
+}
+
+size_t
+IngestIndex::SlotCount(size_t capacity) {
+  size_t const records = (capacity < kHeaderLength)
+                             ? 0
+                             : (capacity - kHeaderLength) / kRecordLength;
+  size_t slots = 1;
+  while (slots < 2 * records) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+IngestIndex::IngestIndex(
+    uint8_t *log, size_t capacity, uint32_t *slots, size_t slot_count) noexcept
+    : log_(log), capacity_(capacity), slots_(slots),
+      slot_mask_(slot_count - 1) {
+  assert(log != nullptr);
+  assert(slots != nullptr);
+}
+
+int
+IngestIndex::Open() {
+  open_ = false;
+  length_ = 0;
+  live_ = 0;
+  torn_ = 0;
+  size_t const slot_count = slot_mask_ + 1;
+  if (capacity_ < kHeaderLength) {
+    return -1;
+  }
+  if (slot_count == 0 || (slot_count & slot_mask_) ||
+      slot_count < SlotCount(capacity_)) {
+    return -3;
+  }
+
+  if (IsZero(log_, kHeaderLength)) {
+    std::memcpy(log_, kFileMagic, sizeof(kFileMagic));
+    VLWriteLittleInt32(log_, kRecordLengthOffset, kRecordLength);
+  } else if (std::memcmp(log_, kFileMagic, sizeof(kFileMagic) - 2)) {
+    return -1;
+  } else if (
+      std::memcmp(log_, kFileMagic, sizeof(kFileMagic)) ||
+      OSReadLittleInt32(log_, kRecordLengthOffset) != kRecordLength) {
+    return -2;
+  }
+
+  std::memset(slots_, 0, slot_count * sizeof(*slots_));
+  length_ = kHeaderLength;
+  open_ = true;
+  for (; length_ + kRecordLength <= capacity_; length_ += kRecordLength) {
+    if (!IsValid(log_ + length_)) {
+      break;
+    }
+    Insert(static_cast<uint32_t>(record_count() + 1));
+  }
+
+  // Records after a torn one may have reached the file before it did, even
+  // past a record that never reached it at all; zero them so that they aren't
+  // resurrected by later appends.
+  for (size_t end = length_; end + kRecordLength <= capacity_;
+       end += kRecordLength) {
+    uint8_t *const record = log_ + end;
+    if (!IsZero(record, kRecordLength)) {
+      std::memset(record, 0, kRecordLength);
+      ++torn_;
+    }
+  }
+  return static_cast<int>(live_);
+}
+
+uint32_t &
+IngestIndex::Slot(VLDeviceId const &device, uint16_t file_index) const {
+  uint32_t hash = kFnvOffsetBasis;
+  for (uint8_t const byte : device.bytes) {
+    hash = (hash ^ byte) * kFnvPrime;
+  }
+  hash = (hash ^ (file_index & 0xff)) * kFnvPrime;
+  hash = (hash ^ (file_index >> 8)) * kFnvPrime;
+
+  // Linear probing.  There are at least twice as many slots as records, so
+  // there's always an empty slot.
+  for (size_t i = hash & slot_mask_;; i = (i + 1) & slot_mask_) {
+    uint32_t &slot = slots_[i];
+    if (slot == 0 || HasKey(Record(slot), device, file_index)) {
+      return slot;
+    }
+  }
+}
+
+void
+IngestIndex::Insert(uint32_t n) {
+  uint8_t const *const record = Record(n);
+  VLDeviceId device;
+  std::memcpy(device.bytes, record + kDeviceOffset, sizeof(device));
+  uint32_t &slot = Slot(device, OSReadLittleInt16(record, kIndexOffset));
+  if (slot != 0 && Record(slot)[kKindOffset] == kRecordIngested) {
+    --live_;
+  }
+  slot = n;
+  if (record[kKindOffset] == kRecordIngested) {
+    ++live_;
+  }
+}
+
+int
+IngestIndex::AppendRecord(uint8_t const *record) {
+  if (!open_ || length_ + kRecordLength > capacity_) {
+    return -1;
+  }
+  uint8_t *const p = log_ + length_;
+  // The CRC goes last, so that a record is only valid once it's whole.
+  std::memcpy(p, record, kCrcOffset);
+  VLWriteLittleInt32(p, kCrcOffset, crc32(record, kCrcOffset));
+  length_ += kRecordLength;
+  Insert(static_cast<uint32_t>(record_count()));
+  return 0;
+}
+
+int
+IngestIndex::Append(VLDeviceId const &device, VLLocalFile const &file) {
+  uint8_t record[kRecordLength];
+  WriteRecord(record, device, file, kRecordIngested);
+  return AppendRecord(record);
+}
+
+int
+IngestIndex::Forget(VLDeviceId const &device, uint16_t file_index) {
+  uint8_t record[kRecordLength];
+  VLLocalFile file = {};
+  file.index = file_index;
+  WriteRecord(record, device, file, kRecordForgotten);
+  return AppendRecord(record);
+}
+
+bool
+IngestIndex::Lookup(
+    VLDeviceId const &device, uint16_t file_index, VLLocalFile &file) const {
+  if (!open_) {
+    return false;
+  }
+  uint32_t const slot = Slot(device, file_index);
+  if (slot == 0) {
+    return false;
+  }
+  uint8_t const *const record = Record(slot);
+  if (record[kKindOffset] != kRecordIngested) {
+    return false;
+  }
+  uint64_t const time =
+      OSReadLittleInt32(record, kTimeOffset) |
+      (uint64_t{OSReadLittleInt32(record, kTimeOffset + 4)} << 32);
+  file.index = file_index;
+  file.posix_time = static_cast<time_t>(time);
+  file.length = OSReadLittleInt32(record, kLengthOffset);
+  file.checksum = OSReadLittleInt32(record, kChecksumOffset);
+  return true;
+}
+
+VLIngestState
+IngestIndex::State(
+    VLDeviceId const &device, VLDirectoryEntry const &entry) const {
+  VLLocalFile file;
+  bool const found = Lookup(device, entry.index, file);
+  return IngestStateOf(entry, found ? &file : nullptr);
+}
+
+bool
+IngestIndex::ShouldCompact() const {
+  size_t const superseded = record_count() - live_;
+  return superseded >= kMinCompactRecords && superseded > live_;
+}
+
+int
+IngestIndex::Compact(uint8_t *dst, size_t capacity) const {
+  assert(dst != nullptr);
+  assert(dst + capacity <= log_ || log_ + capacity_ <= dst);
+
+  size_t const length = kHeaderLength + live_ * kRecordLength;
+  if (!open_ || length > capacity) {
+    return -1;
+  }
+  std::memcpy(dst, log_, kHeaderLength);
+  uint8_t *p = dst + kHeaderLength;
+  uint32_t const count = static_cast<uint32_t>(record_count());
+  for (uint32_t n = 1; n <= count; ++n) {
+    uint8_t const *const record = Record(n);
+    if (record[kKindOffset] != kRecordIngested) {
+      continue;
+    }
+    VLDeviceId device;
+    std::memcpy(device.bytes, record + kDeviceOffset, sizeof(device));
+    if (Slot(device, OSReadLittleInt16(record, kIndexOffset)) == n) {
+      std::memcpy(p, record, kRecordLength);
+      p += kRecordLength;
+    }
+  }
+  assert(p == dst + length);
+  std::memset(p, 0, capacity - length);
+  return static_cast<int>(length);
+}
+
+} // namespace viv
+
+size_t
+VLIngestIndexSlotCount(size_t capacity) {
+  return viv::IngestIndex::SlotCount(capacity);
+}
+
+VLIngestIndex
+VLMakeIngestIndex(
+    uint8_t *log, size_t capacity, uint32_t *slots, size_t slot_count,
+    int *recovered) {
+  assert(recovered != nullptr);
+
+  auto *index = new viv::IngestIndex(log, capacity, slots, slot_count);
+  *recovered = index->Open();
+  if (*recovered < 0) {
+    delete index;
+    return VLIngestIndex{nullptr};
+  }
+  return VLIngestIndex{index};
+}
+
+void
+VLDeleteIngestIndex(VLIngestIndex index) {
+  delete reinterpret_cast<viv::IngestIndex *>(index.index);
+}
+
+namespace {
+
+viv::IngestIndex &
+GetIndex(VLIngestIndex index) {
+  assert(index.index != nullptr);
+  return *reinterpret_cast<viv::IngestIndex *>(index.index);
+}
+
+} // namespace
+
+int
+VLIngestIndexAppend(
+    VLIngestIndex index, VLDeviceId const *device, VLLocalFile file) {
+  assert(device != nullptr);
+  return GetIndex(index).Append(*device, file);
+}
+
+int
+VLIngestIndexForget(
+    VLIngestIndex index, VLDeviceId const *device, uint16_t file_index) {
+  assert(device != nullptr);
+  return GetIndex(index).Forget(*device, file_index);
+}
+
+int
+VLIngestIndexLookup(
+    VLIngestIndex index, VLDeviceId const *device, uint16_t file_index,
+    VLLocalFile *file) {
+  assert(device != nullptr);
+  assert(file != nullptr);
+  return GetIndex(index).Lookup(*device, file_index, *file);
+}
+
+VLIngestState
+VLIngestIndexState(
+    VLIngestIndex index, VLDeviceId const *device, VLDirectoryEntry entry) {
+  assert(device != nullptr);
+  return GetIndex(index).State(*device, entry);
+}
+
+int
+VLIngestIndexShouldCompact(VLIngestIndex index) {
+  return GetIndex(index).ShouldCompact();
+}
+
+int
+VLIngestIndexCompact(VLIngestIndex index, uint8_t *dst, size_t capacity) {
+  return GetIndex(index).Compact(dst, capacity);
+}
+
+int
+VLPlanSyncWithIngestIndex(
+    uint8_t const *directory, size_t length, VLIngestIndex index,
+    VLDeviceId const *device, VLSyncPolicy const *policy,
+    VLSyncStep *_Nullable steps, size_t capacity) {
+  assert(directory != nullptr);
+  assert(device != nullptr);
+  assert(policy != nullptr);
+
+  viv::DirectoryView dir(directory, length);
+  if (!dir.Read()) {
+    return -1;
+  }
+  return viv::SyncPlanner(*policy).Plan(
+      dir, GetIndex(index), *device, steps, capacity);
+}
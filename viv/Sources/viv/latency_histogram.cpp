@@ -0,0 +1,161 @@
+// latency_histogram.cpp - log-bucketed histograms of command latency
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/latency_histogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "viv/latency.h"
+
+#pragma clang assume_nonnull begin
+
+static_assert(
+    kVLLatencyKindSetTime + 1 == viv::LatencyRecorder::kNumKinds,
+    "kNumKinds must match VLLatencyKind");
+static_assert(
+    kVLLatencyStageTotalPerKiB + 1 == viv::LatencyRecorder::kNumStages,
+    "kNumStages must match VLLatencyStage");
+
+namespace viv {
+
+uint64_t
+LatencyHistogram::LowerBound(size_t bucket) {
+  assert(bucket < kNumBuckets);
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  int const shift = bucket / kSubBuckets - 1;
+  return static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << shift;
+}
+
+uint64_t
+LatencyHistogram::UpperBound(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  int const shift = bucket / kSubBuckets - 1;
+  return LowerBound(bucket) + ((uint64_t(1) << shift) - 1);
+}
+
+void
+LatencyHistogram::AddBuckets(uint64_t const *counts, size_t length) {
+  length = std::min(length, kNumBuckets);
+  for (size_t i = 0; i < length; ++i) {
+    counts_[i] += counts[i];
+    count_ += counts[i];
+  }
+}
+
+uint64_t
+LatencyHistogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  double const clamped = std::min(std::max(percentile, 0.0), 100.0);
+  uint64_t const rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return UpperBound(i);
+    }
+  }
+  return UpperBound(kNumBuckets - 1);
+}
+
+void
+LatencyRecorder::Merge(LatencyRecorder const &other) {
+  for (size_t kind = 0; kind < kNumKinds; ++kind) {
+    for (size_t stage = 0; stage < kNumStages; ++stage) {
+      histograms_[kind][stage].Merge(other.histograms_[kind][stage]);
+    }
+  }
+}
+
+} // namespace viv
+
+namespace {
+
+viv::LatencyRecorder &
+GetRecorder(VLLatencyRecorder recorder) {
+  assert(recorder.recorder != nullptr);
+  return *reinterpret_cast<viv::LatencyRecorder *>(recorder.recorder);
+}
+
+} // namespace
+
+VLLatencyRecorder
+VLMakeLatencyRecorder(
+    void *_Nullable ctx, uint64_t (*now)(void *_Nullable ctx)) {
+  return VLLatencyRecorder{
+      new viv::LatencyRecorder(viv::LatencyRecorder::Clock(now, ctx))};
+}
+
+void
+VLDeleteLatencyRecorder(VLLatencyRecorder recorder) {
+  delete reinterpret_cast<viv::LatencyRecorder *>(recorder.recorder);
+}
+
+void
+VLLatencyRecorderMerge(VLLatencyRecorder into, VLLatencyRecorder from) {
+  GetRecorder(into).Merge(GetRecorder(from));
+}
+
+uint64_t
+VLLatencyRecorderCount(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage) {
+  return GetRecorder(recorder).histogram(kind, stage).count();
+}
+
+uint64_t
+VLLatencyRecorderValueAtPercentile(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    double percentile) {
+  return GetRecorder(recorder).histogram(kind, stage).ValueAtPercentile(
+      percentile);
+}
+
+size_t
+VLLatencyRecorderCopyBuckets(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    uint64_t *_Nullable counts, size_t length) {
+  auto const &histogram = GetRecorder(recorder).histogram(kind, stage);
+  size_t const n = viv::LatencyHistogram::kNumBuckets;
+  if (counts != nullptr) {
+    std::memcpy(
+        counts, histogram.counts(), std::min(length, n) * sizeof(*counts));
+  }
+  return n;
+}
+
+void
+VLLatencyRecorderAddBuckets(
+    VLLatencyRecorder recorder, VLLatencyKind kind, VLLatencyStage stage,
+    uint64_t const *counts, size_t length) {
+  GetRecorder(recorder).histogram(kind, stage).AddBuckets(counts, length);
+}
+
+uint64_t
+VLLatencyBucketLowerBound(size_t bucket) {
+  return viv::LatencyHistogram::LowerBound(bucket);
+}
+
+#pragma clang assume_nonnull end
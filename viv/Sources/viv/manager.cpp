@@ -15,23 +15,30 @@
 
 #include "viv/manager.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <memory>
-#include <string>
-#include <tuple>
 #include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "viv/command.hpp"
 #include "viv/directory.hpp"
+#include "viv/directory_query.hpp"
 #include "viv/download_command.hpp"
+#include "viv/endian.hpp"
+#include "viv/erase_batch.hpp"
 #include "viv/erase_command.hpp"
+#include "viv/erase_result.h"
 #include "viv/packet.h"
 #include "viv/raw_directory.h"
 #include "viv/set_time_command.hpp"
+#include "viv/trace.h"
 #include "viv/vivtime.h"
 
 #pragma clang assume_nonnull begin
@@ -43,6 +50,9 @@ namespace {
 /// This only protects against recursion from within one thread, it does not
 /// robustly detect multi-threaded concurrency.  If DEBUG is not true, then
 /// it does nothing at all.
+///
+/// Manager::EnqueueValue does not use this, since it may be called from other
+/// threads.
 class AssertNoRecursion {
 public:
   explicit AssertNoRecursion(bool &busy) : busy_(busy) {
@@ -66,95 +76,313 @@ private:
   bool &busy_;
 };
 
+/// Maximum length of error messages, including the terminator.
+constexpr size_t kMaxErrorMessageLength = 64;
+
 } // namespace
 
 namespace viv {
 
+Manager::Manager(
+    std::unique_ptr<ManagerDelegate> delegate, uint8_t *_Nullable buffer,
+    size_t capacity) noexcept
+    : delegate_(std::move(delegate)), buffer_(buffer), capacity_(capacity),
+      busy_(false) {
+  assert(!VL_NO_HEAP || buffer != nullptr);
+}
+
 void
 Manager::NotifyValue(uint8_t const *value, size_t length) {
   AssertNoRecursion busy(busy_);
+  ReadValue(value, length);
+}
+
+size_t
+Manager::NotifyValues(
+    uint8_t const *const *values, size_t const *lengths, size_t count,
+    bool *_Nullable settled) {
+  AssertNoRecursion busy(busy_);
+  size_t n = 0;
+  bool stopped = false;
+  while (n < count && !stopped) {
+    stopped = ReadValue(values[n], lengths[n]);
+    ++n;
+  }
+  if (settled) {
+    *settled = stopped;
+  }
+  return n;
+}
+
+bool
+Manager::ReadValue(uint8_t const *value, size_t length) {
+  VL_TRACE2(notify_value, this, length);
+  if (capture_) {
+    capture_->Record(kCaptureNotifyValue, value, length);
+  }
+  // Updates are kept short, and never span a delegate call, so that a
+  // snapshot (even from a callback) doesn't wait on the client.
+  {
+    Metrics::Update update(metrics_);
+    metrics_.Add(Metrics::kPacketsReceived);
+  }
 
   if (!command_ && !response_) {
     delegate_->DidError(
         kVLManagerErrorUnexpected, "Unexpected value notification");
-    return;
+    return true;
   }
   Command &command = (response_) ? *response_ : *command_;
 
   VLPacket packet;
-  if (VLReadPacket(&packet, value, length)) {
-    delegate_->DidError(
-        kVLManagerErrorBadHeader,
-        command.name() + ": invalid value notification");
-    return;
+  if (int const err = VLReadPacket(&packet, value, length)) {
+    VL_TRACE3(packet_error, this, err, length);
+    {
+      Metrics::Update update(metrics_);
+      metrics_.Add(
+          (err == -2) ? Metrics::kCrcFailures : Metrics::kLengthFailures);
+    }
+    DidCommandError(
+        kVLManagerErrorBadHeader, command, "invalid value notification");
+    return true;
   }
+  VL_TRACE4(
+      read_packet, this, OSReadLittleInt16(packet.cmd, 0),
+      VLPacketSeqno(&packet), packet.payload_length);
 
-  if (command.ReadPacket(packet) < 0) {
-    delegate_->DidError(
-        kVLManagerErrorBadPayload,
-        command.name() + ": error in response");
-    return;
+  bool const had_ack = command.has_ack();
+  int const read = command.ReadPacket(packet);
+  if (read < 0) {
+    if (read == kReadPacketSeqnoError) {
+      VL_TRACE3(seqno_error, this, command.name(), VLPacketSeqno(&packet));
+      Metrics::Update update(metrics_);
+      metrics_.Add(Metrics::kSeqnoErrors);
+    }
+    DidCommandError(kVLManagerErrorBadPayload, command, "error in response");
+    return true;
+  }
+  bool const is_ack = !had_ack && command.has_ack();
+  {
+    Metrics::Update update(metrics_);
+    if (is_ack) {
+      metrics_.Add(Metrics::kAcks);
+    }
+    if (read > 0) {
+      metrics_.Add(Metrics::kBytesDownloaded, read);
+    }
   }
+  reply_bytes_ += read;
 
-  if (command.MaybeFinish()) {
-    delegate_->DidFinishWaiting();
+  // Take the time before MaybeFinish calls back into the delegate.
+  uint64_t const now = latency_ ? latency_->Now() : 0;
+  bool const is_finished = command.MaybeFinish();
+  if (latency_) {
+    RecordLatency(now, is_ack, is_finished);
+  }
+  if (is_finished) {
+    {
+      Metrics::Update update(metrics_);
+      metrics_.Add(Metrics::kCommandsCompleted);
+    }
+    if (!batch_.active() && !probe_tail_) {
+      delegate_->DidFinishWaiting();
+    }
     if (response_ && response_->ShouldAckReply()) {
       const VLPacket packet = response_->MakeResponseAckPacket();
       WritePacket(packet, false);
     }
-    response_.release();
+    ClearCommand();
+    if (batch_.active()) {
+      ContinueBatch();
+    } else if (probe_tail_) {
+      IssueProbeTail();
+    }
   }
+  return is_finished;
+}
+
+size_t
+Manager::DrainValues(size_t max) {
+  size_t n = 0;
+  uint8_t value[kVLPacketMaxLength];
+  for (int length; n < max && (length = ingress_.Pop(value)) >= 0; ++n) {
+    NotifyValue(value, length);
+  }
+  return n;
 }
 
 void
 Manager::NotifyTimeout() {
   AssertNoRecursion busy(busy_);
-  if (command_) {
-    delegate_->DidError(
-        kVLManagerErrorUnexpected,
-        command_->name() + ": timeout waiting for command");
-    command_.reset();
-    delegate_->DidFinishWaiting();
+  if (capture_) {
+    capture_->Record(kCaptureTimeout, nullptr, 0);
+  }
+  Command *command = (response_) ? response_ : command_;
+  if (command) {
+    VL_TRACE2(timeout, this, command->name());
+    {
+      Metrics::Update update(metrics_);
+      metrics_.Add(Metrics::kTimeouts);
+    }
+    DidCommandError(
+        kVLManagerErrorUnexpected, *command, "timeout waiting for command");
+    ClearCommand();
+    probe_tail_ = false;
+    if (batch_.active()) {
+      ContinueBatch();
+    } else {
+      delegate_->DidFinishWaiting();
+    }
   }
 }
 
 void
 Manager::DownloadDirectory() {
   AssertNoRecursion busy(busy_);
-  command_.release();
-  // While this leaks delegate_ out of its unique_ptr, the response_ is owned by
-  // the Manager so will not outlive the delegate.
-  auto on_finish = [&delegate = *delegate_](
-                       uint16_t index, uint8_t const *data, size_t length) {
-    auto reader = Directory::Reader(data, length);
-    if (!reader.Read()) {
-      delegate.DidError(kVLManagerErrorBadHeader, "Error parsing directory");
-      return;
-    }
-    Directory dir = reader.get();
-    delegate.DidParseClock(dir.header().time());
-    for (const auto &pair : dir.entries()) {
-      delegate.DidParseDirectoryEntry(pair.second.entry());
-    }
-    delegate.DidFinishParsingDirectory();
-  };
-  response_.reset(new DownloadCommand(0, std::move(on_finish)));
+  if (capture_) {
+    uint8_t const call[] = {kCaptureCallDownloadDirectory};
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  has_fingerprint_ = false;
+  IssueDownloadDirectory();
+}
+
+void
+Manager::DownloadDirectoryIfChanged(uint32_t fingerprint) {
+  AssertNoRecursion busy(busy_);
+  if (capture_) {
+    uint8_t call[1 + sizeof(uint32_t)] = {
+        kCaptureCallDownloadDirectoryIfChanged};
+    VLWriteLittleInt32(call, 1, fingerprint);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  fingerprint_ = fingerprint;
+  has_fingerprint_ = true;
+  IssueDownloadDirectory();
+}
+
+void
+Manager::IssueDownloadDirectory() {
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadDirectory;
+  response_ = &storage_.emplace<DownloadCommand>(
+      0, 0, 0xffffffffUL, buffer_, capacity_,
+      DownloadCommand::OnFinishCallback::Bind<&Manager::DidDownloadDirectory>(
+          *this));
 
   VLPacket packet = response_->MakeCommandPacket();
   WritePacket(packet);
 }
 
 void
-Manager::DownloadFile(uint16_t index) {
+Manager::ProbeDirectory(uint16_t max_entries, uint16_t known_entries) {
   AssertNoRecursion busy(busy_);
-  command_.release();
-  // While this leaks delegate_ out of its unique_ptr, the response_ is owned by
-  // the Manager so will not outlive the delegate.
-  auto on_finish = [&delegate = *delegate_](
-                       uint16_t index, uint8_t const *data, size_t length) {
-    delegate.DidDownloadFile(index, data, length);
-  };
-  response_.reset(new DownloadCommand(index, std::move(on_finish)));
+  if (capture_) {
+    uint8_t call[1 + 2 * sizeof(uint16_t)] = {kCaptureCallProbeDirectory};
+    VLWriteLittleInt16(call, 1, max_entries);
+    VLWriteLittleInt16(call, 3, known_entries);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadDirectory;
+  probe_max_entries_ = max_entries;
+  probe_known_entries_ = known_entries;
+  // The directory's length is counted in records, including the header.
+  response_ = &storage_.emplace<DownloadCommand>(
+      0, 0, uint32_t{max_entries} + 1, buffer_, capacity_,
+      DownloadCommand::OnFinishCallback::Bind<&Manager::DidProbeDirectory>(
+          *this));
+
+  VLPacket packet = response_->MakeCommandPacket();
+  WritePacket(packet);
+}
+
+void
+Manager::IssueProbeTail() {
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadDirectory;
+  // Just the record after the known entries; the header is the first record.
+  constexpr uint32_t kRecordLength = sizeof(VLRawDirectoryEntry);
+  response_ = &storage_.emplace<DownloadCommand>(
+      0, (uint32_t{probe_known_entries_} + 1) * kRecordLength, 1, buffer_,
+      capacity_,
+      DownloadCommand::OnFinishCallback::Bind<&Manager::DidProbeTail>(*this));
+
+  VLPacket packet = response_->MakeCommandPacket();
+  WritePacket(packet);
+}
+
+void
+Manager::DownloadDirectoryPage(uint16_t first_entry, uint16_t max_entries) {
+  AssertNoRecursion busy(busy_);
+  if (capture_) {
+    uint8_t call[1 + 2 * sizeof(uint16_t)] = {
+        kCaptureCallDownloadDirectoryPage};
+    VLWriteLittleInt16(call, 1, first_entry);
+    VLWriteLittleInt16(call, 3, max_entries);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadDirectory;
+  page_first_entry_ = first_entry;
+  page_max_entries_ = max_entries;
+  // The offset is in bytes, but the length is counted in records.  The header
+  // is the first record.
+  constexpr uint32_t kRecordLength = sizeof(VLRawDirectoryEntry);
+  uint32_t const offset =
+      (first_entry == 0) ? 0 : (uint32_t{first_entry} + 1) * kRecordLength;
+  uint32_t const length = uint32_t{max_entries} + (first_entry == 0);
+  response_ = &storage_.emplace<DownloadCommand>(
+      0, offset, length, buffer_, capacity_,
+      DownloadCommand::OnFinishCallback::Bind<
+          &Manager::DidDownloadDirectoryPage>(*this));
+
+  VLPacket packet = response_->MakeCommandPacket();
+  WritePacket(packet);
+}
+
+void
+Manager::QueryDirectory(VLDirectoryQuery const &query) {
+  AssertNoRecursion busy(busy_);
+  if (capture_) {
+    uint8_t call[1 + kCaptureQueryLength] = {kCaptureCallQueryDirectory};
+    WriteCaptureQuery(call + 1, query);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadDirectory;
+  query_ = query;
+  response_ = &storage_.emplace<DownloadCommand>(
+      0, 0, 0xffffffffUL, buffer_, capacity_,
+      DownloadCommand::OnFinishCallback::Bind<&Manager::DidQueryDirectory>(
+          *this));
+
+  VLPacket packet = response_->MakeCommandPacket();
+  WritePacket(packet);
+}
+
+void
+Manager::DownloadFile(uint16_t index, uint32_t offset) {
+  AssertNoRecursion busy(busy_);
+  if (capture_) {
+    uint8_t call[1 + sizeof(uint16_t) + sizeof(uint32_t)] = {
+        kCaptureCallDownloadFile};
+    VLWriteLittleInt16(call, 1, index);
+    VLWriteLittleInt32(call, 3, offset);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindDownloadFile;
+  response_ = &storage_.emplace<DownloadCommand>(
+      index, offset, 0xffffffffUL, buffer_, capacity_,
+      DownloadCommand::OnFinishCallback::Bind<&Manager::DidDownloadFile>(
+          *this));
 
   VLPacket packet = response_->MakeCommandPacket();
   WritePacket(packet);
@@ -163,13 +391,56 @@ Manager::DownloadFile(uint16_t index) {
 void
 Manager::EraseFile(uint16_t index) {
   AssertNoRecursion busy(busy_);
-  command_.release();
-  // While this leaks delegate_ out of its unique_ptr, the response_ is owned by
-  // the Manager so will not outlive the delegate.
-  auto on_finish = [&delegate = *delegate_, index](bool success) {
-    delegate.DidEraseFile(index, success);
-  };
-  response_.reset(new EraseCommand(index, std::move(on_finish)));
+  if (capture_) {
+    uint8_t call[1 + sizeof(uint16_t)] = {kCaptureCallEraseFile};
+    VLWriteLittleInt16(call, 1, index);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  IssueEraseFile(index);
+}
+
+void
+Manager::EraseFiles(uint16_t const *indices, size_t count) {
+  AssertNoRecursion busy(busy_);
+  if (capture_) {
+    RecordEraseFiles(indices, count);
+  }
+  probe_tail_ = false;
+  batch_waiting_ = false;
+  if (!batch_.Start(indices, count)) {
+    delegate_->DidError(kVLManagerErrorUnexpected, "Too many files to erase");
+    return;
+  }
+  ContinueBatch();
+}
+
+void
+Manager::RecordEraseFiles(uint16_t const *indices, size_t count) {
+  // Each record has the call, a flag for whether more parts follow, and as
+  // many indices as fit.
+  constexpr size_t kIndicesPerRecord =
+      (kCaptureMaxValueLength - 2) / sizeof(uint16_t);
+  uint8_t call[kCaptureMaxValueLength] = {kCaptureCallEraseFiles};
+  size_t i = 0;
+  do {
+    size_t const n = std::min(count - i, kIndicesPerRecord);
+    call[1] = (i + n < count);
+    for (size_t j = 0; j < n; ++j) {
+      VLWriteLittleInt16(call, 2 + j * sizeof(uint16_t), indices[i + j]);
+    }
+    capture_->Record(kCaptureCall, call, 2 + n * sizeof(uint16_t));
+    i += n;
+  } while (i < count);
+}
+
+void
+Manager::IssueEraseFile(uint16_t index) {
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindEraseFile;
+  response_ = &storage_.emplace<EraseCommand>(
+      index,
+      EraseCommand::OnFinishCallback::Bind<&Manager::DidEraseFile>(*this));
 
   VLPacket packet = response_->MakeCommandPacket();
   WritePacket(packet);
@@ -178,15 +449,18 @@ Manager::EraseFile(uint16_t index) {
 void
 Manager::SetTime(time_t posix_time) {
   AssertNoRecursion busy(busy_);
-  command_.release();
-  // While this leaks delegate_ out of its unique_ptr, the response_ is owned by
-  // the Manager so will not outlive the delegate.
-  auto on_finish = [&delegate = *delegate_](bool success) {
-    delegate.DidSetTime(success);
-  };
+  if (capture_) {
+    uint8_t call[1 + sizeof(uint64_t)] = {kCaptureCallSetTime};
+    WriteCaptureTime(call, 1, posix_time);
+    capture_->Record(kCaptureCall, call, sizeof(call));
+  }
+  AbandonSequences();
+  ClearCommand();
+  latency_kind_ = kVLLatencyKindSetTime;
   uint32_t viva_time = VLGetVivaTimeFromPosix(posix_time);
-  response_.release();
-  command_.reset(new SetTimeCommand(viva_time, std::move(on_finish)));
+  command_ = &storage_.emplace<SetTimeCommand>(
+      viva_time,
+      SetTimeCommand::OnFinishCallback::Bind<&Manager::DidSetTime>(*this));
 
   VLPacket packet = command_->MakeCommandPacket();
   WritePacket(packet);
@@ -201,13 +475,247 @@ Manager::WritePacket(VLPacket const &packet, bool wait_for_ack) {
       std::is_same<uint8_t, unsigned char>::value,
       "uint8_t aliases may not be valid");
   uint8_t const *value = reinterpret_cast<uint8_t const *>(&packet);
+  VL_TRACE4(
+      write_packet, this, OSReadLittleInt16(packet.cmd, 0),
+      VLPacketSeqno(&packet), VLPacketLength(&packet));
+  if (capture_) {
+    capture_->Record(kCaptureWriteValue, value, VLPacketLength(&packet));
+  }
   if (delegate_->WriteValue(value, VLPacketLength(&packet)) < 0) {
     delegate_->DidError(kVLManagerErrorUnexpected, "WriteValue");
     return;
   }
+  {
+    Metrics::Update update(metrics_);
+    metrics_.Add(Metrics::kPacketsSent);
+  }
   if (wait_for_ack) {
-    delegate_->DidStartWaiting();
+    if (latency_) {
+      command_time_ = response_time_ = latency_->Now();
+    }
+    reply_packets_ = 0;
+    reply_bytes_ = 0;
+    // A batch's commands share one waiting period, as do a probe's.
+    if (!probe_tail_ && (!batch_.active() || !batch_waiting_)) {
+      delegate_->DidStartWaiting();
+      batch_waiting_ = batch_.active();
+    }
+  }
+}
+
+void
+Manager::RecordLatency(uint64_t now, bool is_ack, bool is_finished) {
+  auto histogram = [this](VLLatencyStage stage) -> LatencyHistogram & {
+    return latency_->histogram(latency_kind_, stage);
+  };
+
+  if (is_ack) {
+    histogram(kVLLatencyStageAck).Record(now - command_time_);
+  } else {
+    histogram(
+        reply_packets_++ ? kVLLatencyStagePacketGap
+                         : kVLLatencyStageFirstPacket)
+        .Record(now - response_time_);
+  }
+  response_time_ = now;
+
+  if (is_finished) {
+    uint64_t const total = now - command_time_;
+    histogram(kVLLatencyStageTotal).Record(total);
+    if (reply_bytes_ > 0) {
+      histogram(kVLLatencyStageTotalPerKiB).Record(total * 1024 / reply_bytes_);
+    }
+  }
+}
+
+void
+Manager::DidCommandError(
+    VLManagerErrorCode code, Command const &command, char const *what) {
+  if (!command_failed_) {
+    Metrics::Update update(metrics_);
+    metrics_.Add(Metrics::kCommandsFailed);
+    command_failed_ = true;
+  }
+
+  // Format on the stack rather than concatenating strings, to avoid
+  // allocating.
+  char msg[kMaxErrorMessageLength];
+  std::snprintf(msg, sizeof(msg), "%s: %s", command.name(), what);
+  delegate_->DidError(code, msg);
+}
+
+void
+Manager::ClearCommand() {
+  command_ = nullptr;
+  response_ = nullptr;
+  command_failed_ = false;
+  storage_.emplace<std::monostate>();
+}
+
+void
+Manager::ContinueBatch() {
+  uint16_t index;
+  if (batch_.Next(index)) {
+    IssueEraseFile(index);
+    return;
+  }
+  if (!batch_.verifying()) {
+    batch_.StartVerifying();
+    IssueDownloadDirectory();
+    return;
+  }
+
+  size_t count;
+  VLEraseResult const *results = batch_.Finish(count);
+  batch_.Clear();
+  batch_waiting_ = false;
+  delegate_->DidEraseFiles(results, count);
+  delegate_->DidFinishWaiting();
+}
+
+void
+Manager::DidDownloadDirectory(uint16_t index, uint8_t *data, size_t length) {
+  DirectoryView dir(data, length);
+  if (!dir.Read()) {
+    delegate_->DidError(kVLManagerErrorBadHeader, "Error parsing directory");
+    return;
+  }
+  delegate_->DidReadDirectory(data, length);
+  delegate_->DidParseClock(dir.header().time());
+  // An erase batch's verification always needs the entries.
+  uint32_t const fingerprint = VLDirectoryFingerprint(data, length);
+  bool const unchanged = has_fingerprint_ && !batch_.verifying() &&
+                         fingerprint == fingerprint_;
+  delegate_->DidFingerprintDirectory(fingerprint, unchanged);
+  if (unchanged) {
+    return;
+  }
+  if (batch_.verifying()) {
+    for (DirectoryEntry const entry : dir) {
+      batch_.DidFindFile(entry.index());
+    }
   }
+  DeliverEntries(data, dir.data(), dir.size());
+  if (batch_.verifying()) {
+    batch_.DidVerify();
+  }
+  delegate_->DidFinishParsingDirectory();
+}
+
+void
+Manager::DidQueryDirectory(uint16_t index, uint8_t *data, size_t length) {
+  DirectoryView dir(data, length);
+  if (!dir.Read()) {
+    delegate_->DidError(kVLManagerErrorBadHeader, "Error parsing directory");
+    return;
+  }
+  delegate_->DidReadDirectory(data, length);
+  delegate_->DidParseClock(dir.header().time());
+  // Select the matches in place, in front of the others, then decode them.
+  auto *const raw = reinterpret_cast<VLRawDirectoryEntry *>(
+      data + sizeof(VLRawDirectoryHeader));
+  size_t const count = DirectoryQuery(query_).Select(raw, dir.size());
+  DeliverEntries(data, raw, count);
+  delegate_->DidFinishParsingDirectory();
+}
+
+void
+Manager::DidProbeDirectory(
+    uint16_t index, uint8_t const *data, size_t length) {
+  DirectoryView dir(data, length);
+  if (!dir.Read()) {
+    delegate_->DidError(kVLManagerErrorBadHeader, "Error parsing directory");
+    return;
+  }
+  probe_ = VLDirectoryProbe{
+      dir.header().time(), VLDirectoryFingerprint(data, length),
+      static_cast<uint16_t>(dir.size()), 0};
+  if (dir.size() > probe_known_entries_) {
+    probe_.grown = 1;
+  } else if (dir.size() == probe_max_entries_) {
+    // The Viiiiva appends new files, so they're past what was read: check
+    // for the entry after the known ones before reporting.
+    probe_tail_ = true;
+    return;
+  }
+  delegate_->DidProbeDirectory(probe_);
+}
+
+void
+Manager::DidProbeTail(uint16_t index, uint8_t const *data, size_t length) {
+  probe_tail_ = false;
+  probe_.grown = (length >= sizeof(VLRawDirectoryEntry));
+  delegate_->DidProbeDirectory(probe_);
+}
+
+void
+Manager::DidDownloadDirectoryPage(
+    uint16_t index, uint8_t *data, size_t length) {
+  size_t read = 0;
+  if (page_first_entry_ == 0) {
+    VLRawDirectoryHeader header;
+    if (length < sizeof(header) ||
+        VLReadDirectoryHeader(&header, data, length) < 0) {
+      delegate_->DidError(kVLManagerErrorBadHeader, "Error parsing directory");
+      return;
+    }
+    delegate_->DidParseClock(DirectoryHeader(header).time());
+    read = sizeof(header);
+  }
+  if ((length - read) % sizeof(VLRawDirectoryEntry) != 0) {
+    delegate_->DidError(kVLManagerErrorBadHeader, "Error parsing directory");
+    return;
+  }
+
+  // Decode the records in place; a page is never merged into a Directory.
+  auto const count =
+      static_cast<uint16_t>((length - read) / sizeof(VLRawDirectoryEntry));
+  DeliverEntries(
+      data, reinterpret_cast<VLRawDirectoryEntry const *>(data + read), count);
+  delegate_->DidDownloadDirectoryPage(page_first_entry_, count);
+  if (count < page_max_entries_) {
+    delegate_->DidFinishParsingDirectory();
+  }
+}
+
+void
+Manager::DeliverEntries(
+    uint8_t *data, VLRawDirectoryEntry const *raw, size_t count) {
+  VLDirectoryEntry const *entries = DecodeEntriesInPlace(data, raw, count);
+  if (entries != nullptr) {
+    delegate_->DidParseDirectory(entries, count);
+    return;
+  }
+  // A caller-supplied buffer may not be aligned for decoding in place.
+  for (size_t i = 0; i < count; ++i) {
+    delegate_->DidParseDirectoryEntry(DirectoryEntry(raw[i]).entry());
+  }
+}
+
+void
+Manager::DidDownloadFile(uint16_t index, uint8_t const *data, size_t length) {
+#if !VL_NO_HEAP
+  // Hand over the command's own buffer; it isn't read again.
+  auto *const command = std::get_if<DownloadCommand>(&storage_);
+  if (command != nullptr && command->owns_buffer()) {
+    delegate_->DidTakeFile(index, command->TakeBuffer());
+    return;
+  }
+#endif
+  delegate_->DidDownloadFile(index, data, length);
+}
+
+void
+Manager::DidEraseFile(uint16_t index, bool ok) {
+  if (batch_.active()) {
+    batch_.DidErase(index, ok);
+  }
+  delegate_->DidEraseFile(index, ok);
+}
+
+void
+Manager::DidSetTime(bool ok) {
+  delegate_->DidSetTime(ok);
 }
 
 } // namespace viv
@@ -21,11 +21,22 @@
 #include <ctime>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "viv/manager.hpp"
+#include "viv/replayer.hpp"
+#include "viv/sync_plan.hpp"
 
 namespace {
 
+#if !VL_NO_HEAP
+/// Frees a download buffer handed over by \c did_take_file.
+void
+ReleaseFile(void *_Nullable owner) {
+  delete static_cast<std::vector<uint8_t> *>(owner);
+}
+#endif
+
 /// C++ wrapper for the C VLManagerDelegate struct.
 class ManagerDelegateBridge final : public viv::ManagerDelegate {
 public:
@@ -50,10 +61,9 @@ public:
     (*delegate_.did_finish_waiting)(ctx_);
   }
 
-  void
-  DidError(VLManagerErrorCode code, std::string const &&msg) const override {
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
     assert(delegate_.did_error != nullptr);
-    (*delegate_.did_error)(ctx_, code, msg.c_str());
+    (*delegate_.did_error)(ctx_, code, msg);
   }
 
   void DidParseClock(time_t posix_time) const override {
@@ -63,11 +73,24 @@ public:
   }
 
   void DidParseDirectoryEntry(VLDirectoryEntry entry) const override {
-    if (delegate_.did_parse_directory_entry != nullptr) {
+    if (delegate_.did_parse_directory != nullptr) {
+      (*delegate_.did_parse_directory)(ctx_, &entry, 1);
+    } else if (delegate_.did_parse_directory_entry != nullptr) {
       (*delegate_.did_parse_directory_entry)(ctx_, entry);
     }
   }
 
+  void DidParseDirectory(
+      VLDirectoryEntry const *entries, size_t count) const override {
+    if (delegate_.did_parse_directory != nullptr) {
+      (*delegate_.did_parse_directory)(ctx_, entries, count);
+    } else if (delegate_.did_parse_directory_entry != nullptr) {
+      for (size_t i = 0; i < count; ++i) {
+        (*delegate_.did_parse_directory_entry)(ctx_, entries[i]);
+      }
+    }
+  }
+
   void DidFinishParsingDirectory() const override {
     if (delegate_.did_finish_parsing_directory != nullptr) {
       (*delegate_.did_finish_parsing_directory)(ctx_);
@@ -81,6 +104,22 @@ public:
     }
   }
 
+#if !VL_NO_HEAP
+  void
+  DidTakeFile(uint16_t index, std::vector<uint8_t> &&data) const override {
+    if (delegate_.did_take_file == nullptr) {
+      DidDownloadFile(index, data.data(), data.size());
+      return;
+    }
+    // Only the vector is allocated; its storage is handed over as it is.
+    auto *const owner = new std::vector<uint8_t>(std::move(data));
+    VLOwnedBuffer const buffer{
+        owner->empty() ? nullptr : owner->data(), owner->size(), owner,
+        &ReleaseFile};
+    (*delegate_.did_take_file)(ctx_, index, buffer);
+  }
+#endif
+
   void DidEraseFile(uint16_t index, bool ok) const override {
     if (delegate_.did_erase_file != nullptr) {
       (*delegate_.did_erase_file)(ctx_, index, ok);
@@ -93,6 +132,39 @@ public:
     }
   }
 
+  void
+  DidEraseFiles(VLEraseResult const *results, size_t count) const override {
+    if (delegate_.did_erase_files != nullptr) {
+      (*delegate_.did_erase_files)(ctx_, results, count);
+    }
+  }
+
+  void DidDownloadDirectoryPage(
+      uint16_t first_entry, uint16_t count) const override {
+    if (delegate_.did_download_directory_page != nullptr) {
+      (*delegate_.did_download_directory_page)(ctx_, first_entry, count);
+    }
+  }
+
+  void DidProbeDirectory(VLDirectoryProbe probe) const override {
+    if (delegate_.did_probe_directory != nullptr) {
+      (*delegate_.did_probe_directory)(ctx_, probe);
+    }
+  }
+
+  void
+  DidFingerprintDirectory(uint32_t fingerprint, bool unchanged) const override {
+    if (delegate_.did_fingerprint_directory != nullptr) {
+      (*delegate_.did_fingerprint_directory)(ctx_, fingerprint, unchanged);
+    }
+  }
+
+  void DidReadDirectory(uint8_t const *data, size_t length) const override {
+    if (delegate_.did_read_directory != nullptr) {
+      (*delegate_.did_read_directory)(ctx_, data, length);
+    }
+  }
+
 private:
   void *_Nullable ctx_; // not owned
   VLManagerDelegate const delegate_;
@@ -100,11 +172,21 @@ private:
 
 } // namespace
 
+#if !VL_NO_HEAP
 VLCProtocolManager
 VLMakeManager(void *_Nullable ctx, VLManagerDelegate delegate) {
+  return VLMakeManagerWithBuffer(ctx, std::move(delegate), nullptr, 0);
+}
+#endif
+
+VLCProtocolManager
+VLMakeManagerWithBuffer(
+    void *_Nullable ctx, VLManagerDelegate delegate, uint8_t *_Nullable buffer,
+    size_t capacity) {
   std::unique_ptr<viv::ManagerDelegate> delegate_bridge(
       new ManagerDelegateBridge(ctx, std::move(delegate)));
-  return VLCProtocolManager{new viv::Manager(std::move(delegate_bridge))};
+  return VLCProtocolManager{
+      new viv::Manager(std::move(delegate_bridge), buffer, capacity)};
 }
 
 void
@@ -121,6 +203,35 @@ VLManagerNotifyValue(VLCProtocolManager mgr, uint8_t const *value, size_t length
   return manager->NotifyValue(value, length);
 }
 
+size_t
+VLManagerNotifyValues(
+    VLCProtocolManager mgr, uint8_t const *const *values,
+    size_t const *lengths, size_t count) {
+  assert(mgr.manager != nullptr);
+  assert(count == 0 || (values != nullptr && lengths != nullptr));
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->NotifyValues(values, lengths, count);
+}
+
+int
+VLManagerEnqueueValue(
+    VLCProtocolManager mgr, uint8_t const *value, size_t length) {
+  assert(mgr.manager != nullptr);
+  assert(value != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return !manager->EnqueueValue(value, length);
+}
+
+size_t
+VLManagerDrainValues(VLCProtocolManager mgr, size_t max) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->DrainValues(max);
+}
+
 void
 VLManagerNotifyTimeout(VLCProtocolManager mgr) {
   assert(mgr.manager != nullptr);
@@ -137,6 +248,41 @@ VLManagerDownloadDirectory(VLCProtocolManager mgr) {
   return manager->DownloadDirectory();
 }
 
+void
+VLManagerDownloadDirectoryIfChanged(
+    VLCProtocolManager mgr, uint32_t fingerprint) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->DownloadDirectoryIfChanged(fingerprint);
+}
+
+void
+VLManagerProbeDirectory(
+    VLCProtocolManager mgr, uint16_t max_entries, uint16_t known_entries) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->ProbeDirectory(max_entries, known_entries);
+}
+
+void
+VLManagerDownloadDirectoryPage(
+    VLCProtocolManager mgr, uint16_t first_entry, uint16_t max_entries) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->DownloadDirectoryPage(first_entry, max_entries);
+}
+
+void
+VLManagerQueryDirectory(VLCProtocolManager mgr, VLDirectoryQuery query) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->QueryDirectory(query);
+}
+
 void
 VLManagerDownloadFile(VLCProtocolManager mgr, uint16_t index) {
   assert(mgr.manager != nullptr);
@@ -145,6 +291,15 @@ VLManagerDownloadFile(VLCProtocolManager mgr, uint16_t index) {
   return manager->DownloadFile(index);
 }
 
+void
+VLManagerDownloadFileFrom(
+    VLCProtocolManager mgr, uint16_t index, uint32_t offset) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->DownloadFile(index, offset);
+}
+
 void
 VLManagerEraseFile(VLCProtocolManager mgr, uint16_t index) {
   assert(mgr.manager != nullptr);
@@ -153,6 +308,16 @@ VLManagerEraseFile(VLCProtocolManager mgr, uint16_t index) {
   return manager->EraseFile(index);
 }
 
+void
+VLManagerEraseFiles(
+    VLCProtocolManager mgr, uint16_t const *indices, size_t count) {
+  assert(mgr.manager != nullptr);
+  assert(indices != nullptr || count == 0);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->EraseFiles(indices, count);
+}
+
 void
 VLManagerSetTime(VLCProtocolManager mgr, time_t posix_time) {
   assert(mgr.manager != nullptr);
@@ -160,3 +325,51 @@ VLManagerSetTime(VLCProtocolManager mgr, time_t posix_time) {
   viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
   return manager->SetTime(posix_time);
 }
+
+size_t
+VLManagerIssueSyncSteps(
+    VLCProtocolManager mgr, VLSyncStep const *steps, size_t count,
+    time_t posix_time) {
+  assert(mgr.manager != nullptr);
+  assert(steps != nullptr || count == 0);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return viv::IssueSyncSteps(*manager, steps, count, posix_time);
+}
+
+VLManagerMetrics
+VLManagerSnapshotMetrics(VLCProtocolManager mgr) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return manager->SnapshotMetrics();
+}
+
+void
+VLManagerSetLatencyRecorder(
+    VLCProtocolManager mgr, VLLatencyRecorder recorder) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  manager->SetLatencyRecorder(
+      reinterpret_cast<viv::LatencyRecorder *>(recorder.recorder));
+}
+
+void
+VLManagerSetCaptureWriter(VLCProtocolManager mgr, VLCaptureWriter writer) {
+  assert(mgr.manager != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  manager->SetCaptureWriter(
+      reinterpret_cast<viv::CaptureWriter *>(writer.writer));
+}
+
+int
+VLManagerReplayCapture(
+    VLCProtocolManager mgr, uint8_t const *data, size_t length) {
+  assert(mgr.manager != nullptr);
+  assert(data != nullptr);
+
+  viv::Manager *manager = reinterpret_cast<viv::Manager *>(mgr.manager);
+  return viv::Replayer(*manager, data, length).Run();
+}
@@ -17,9 +17,14 @@
 
 #import <Foundation/Foundation.h>
 #include <memory>
+#include <vector>
 
 #include "viv/manager.hpp"
 
+#if VL_NO_HEAP
+#error "The Objective C bridge allocates objects for every callback"
+#endif
+
 using viv::Manager;
 
 const NSErrorDomain VLOManagerErrorDomain = @"VLOManagerErrorDomain";
@@ -78,10 +83,9 @@ public:
 
   void DidFinishWaiting() const override { [delegate_ didFinishWaiting]; }
 
-  void
-  DidError(VLManagerErrorCode code, std::string const &&msg) const override {
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
     if ([delegate_ respondsToSelector:@selector(didError:)]) {
-      NSString *message = [NSString stringWithUTF8String:msg.c_str()];
+      NSString *message = [NSString stringWithUTF8String:msg];
       VLOError *error = [[VLOError alloc] initWithCode:code message:message];
       [delegate_ didError:error];
     }
@@ -94,17 +98,61 @@ public:
   }
 
   void DidParseDirectoryEntry(VLDirectoryEntry entry) const override {
-    if ([delegate_ respondsToSelector:@selector(didParseDirectoryEntry:)]) {
+    SEL const selector = @selector(didParseDirectoryEntry:);
+    if ([delegate_ respondsToSelector:@selector(didParseDirectory:count:)]) {
+      [delegate_ didParseDirectory:&entry count:1];
+    } else if ([delegate_ respondsToSelector:selector]) {
       [delegate_ didParseDirectoryEntry:entry];
     }
   }
 
+  void DidParseDirectory(
+      VLDirectoryEntry const *entries, size_t count) const override {
+    SEL const selector = @selector(didParseDirectoryEntry:);
+    if ([delegate_ respondsToSelector:@selector(didParseDirectory:count:)]) {
+      [delegate_ didParseDirectory:entries count:count];
+    } else if ([delegate_ respondsToSelector:selector]) {
+      for (size_t i = 0; i < count; ++i) {
+        [delegate_ didParseDirectoryEntry:entries[i]];
+      }
+    }
+  }
+
   void DidFinishParsingDirectory() const override {
     if ([delegate_ respondsToSelector:@selector(didFinishParsingDirectory)]) {
       [delegate_ didFinishParsingDirectory];
     }
   }
 
+  void DidDownloadDirectoryPage(
+      uint16_t first_entry, uint16_t count) const override {
+    SEL const selector = @selector(didDownloadDirectoryPage:count:);
+    if ([delegate_ respondsToSelector:selector]) {
+      [delegate_ didDownloadDirectoryPage:first_entry count:count];
+    }
+  }
+
+  void DidProbeDirectory(VLDirectoryProbe probe) const override {
+    if ([delegate_ respondsToSelector:@selector(didProbeDirectory:)]) {
+      [delegate_ didProbeDirectory:probe];
+    }
+  }
+
+  void
+  DidFingerprintDirectory(uint32_t fingerprint, bool unchanged) const override {
+    SEL const selector = @selector(didFingerprintDirectory:unchanged:);
+    if ([delegate_ respondsToSelector:selector]) {
+      [delegate_ didFingerprintDirectory:fingerprint unchanged:unchanged];
+    }
+  }
+
+  void DidReadDirectory(uint8_t const *value, size_t length) const override {
+    if ([delegate_ respondsToSelector:@selector(didReadDirectory:)]) {
+      NSData *data = [NSData dataWithBytes:value length:length];
+      [delegate_ didReadDirectory:data];
+    }
+  }
+
   void DidDownloadFile(
       uint16_t index, uint8_t const *value, size_t length) const override {
     if ([delegate_ respondsToSelector:@selector(didDownloadFile:data:)]) {
@@ -113,6 +161,26 @@ public:
     }
   }
 
+  void
+  DidTakeFile(uint16_t index, std::vector<uint8_t> &&file) const override {
+    if (![delegate_ respondsToSelector:@selector(didDownloadFile:data:)]) {
+      return;
+    }
+    if (file.empty()) {
+      [delegate_ didDownloadFile:index data:[NSData data]];
+      return;
+    }
+    // Wrap the download buffer rather than copying it.
+    auto *const owner = new std::vector<uint8_t>(std::move(file));
+    NSData *data = [[NSData alloc]
+        initWithBytesNoCopy:owner->data()
+                     length:owner->size()
+                deallocator:^(void *bytes, NSUInteger length) {
+                  delete owner;
+                }];
+    [delegate_ didDownloadFile:index data:data];
+  }
+
   void DidEraseFile(uint16_t index, bool ok) const override {
     if ([delegate_ respondsToSelector:@selector(didEraseFile:successfully:)]) {
       [delegate_ didEraseFile:index successfully:ok];
@@ -125,6 +193,31 @@ public:
     }
   }
 
+  void
+  DidEraseFiles(VLEraseResult const *results, size_t count) const override {
+    SEL const selector = @selector(didEraseFiles:failed:stillPresent:);
+    if (![delegate_ respondsToSelector:selector]) {
+      return;
+    }
+    NSMutableIndexSet *erased = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *failed = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *stillPresent = [NSMutableIndexSet indexSet];
+    for (size_t i = 0; i < count; ++i) {
+      switch (results[i].outcome) {
+      case kVLEraseOutcomeErased:
+        [erased addIndex:results[i].index];
+        break;
+      case kVLEraseOutcomeStillPresent:
+        [stillPresent addIndex:results[i].index];
+        break;
+      default:
+        [failed addIndex:results[i].index];
+        break;
+      }
+    }
+    [delegate_ didEraseFiles:erased failed:failed stillPresent:stillPresent];
+  }
+
 private:
   __weak id<VLProtocolManagerDelegate> delegate_;
 };
@@ -177,6 +270,38 @@ GetDelegateBridge(VLProtocolManager *manager) {
       reinterpret_cast<const uint8_t *>(data.bytes), data.length);
 }
 
+- (NSUInteger)notifyValues:(NSArray<NSData *> *)values {
+  // Pass the values on in fixed-size chunks, so as not to allocate.
+  constexpr NSUInteger kChunk = 16;
+  uint8_t const *bytes[kChunk];
+  size_t lengths[kChunk];
+  NSUInteger processed = 0;
+  NSUInteger n = 0;
+  for (NSData *data in values) {
+    bytes[n] = reinterpret_cast<const uint8_t *>(data.bytes);
+    lengths[n] = data.length;
+    if (++n < kChunk && processed + n < values.count) {
+      continue;
+    }
+    bool settled;
+    processed += GetManager(self)->NotifyValues(bytes, lengths, n, &settled);
+    if (settled) {
+      break;
+    }
+    n = 0;
+  }
+  return processed;
+}
+
+- (BOOL)enqueueValue:(NSData *)data {
+  return GetManager(self)->EnqueueValue(
+      reinterpret_cast<const uint8_t *>(data.bytes), data.length);
+}
+
+- (NSUInteger)drainValues {
+  return GetManager(self)->DrainValues(Manager::kIngressQueueLength);
+}
+
 - (void)notifyTimeout {
   GetManager(self)->NotifyTimeout();
 }
@@ -185,14 +310,45 @@ GetDelegateBridge(VLProtocolManager *manager) {
   GetManager(self)->DownloadDirectory();
 }
 
+- (void)downloadDirectoryIfChanged:(uint32_t)fingerprint {
+  GetManager(self)->DownloadDirectoryIfChanged(fingerprint);
+}
+
+- (void)probeDirectory:(uint16_t)maxEntries
+          knownEntries:(uint16_t)knownEntries {
+  GetManager(self)->ProbeDirectory(maxEntries, knownEntries);
+}
+
+- (void)downloadDirectoryPage:(uint16_t)firstEntry
+                   maxEntries:(uint16_t)maxEntries {
+  GetManager(self)->DownloadDirectoryPage(firstEntry, maxEntries);
+}
+
+- (void)queryDirectory:(VLDirectoryQuery)query {
+  GetManager(self)->QueryDirectory(query);
+}
+
 - (void)downloadFile:(uint16_t)index {
   GetManager(self)->DownloadFile(index);
 }
 
+- (void)downloadFile:(uint16_t)index fromOffset:(uint32_t)offset {
+  GetManager(self)->DownloadFile(index, offset);
+}
+
 - (void)eraseFile:(uint16_t)index {
   GetManager(self)->EraseFile(index);
 }
 
+- (void)eraseFiles:(NSIndexSet *)indices {
+  std::vector<uint16_t> v;
+  v.reserve(indices.count);
+  [indices enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+    v.push_back(static_cast<uint16_t>(index));
+  }];
+  GetManager(self)->EraseFiles(v.data(), v.size());
+}
+
 - (void)setTime:(time_t)posixTime {
   GetManager(self)->SetTime(posixTime);
 }
@@ -0,0 +1,151 @@
+// metrics.cpp - lock-free counters
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/metrics.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "viv/manager_metrics.h"
+
+#pragma clang assume_nonnull begin
+
+namespace {
+
+/// Describes how to export a counter.
+struct CounterInfo {
+  /// Metric family name (without the "_total" suffix).
+  char const *name;
+
+  /// Help text for the metric family.
+  char const *help;
+
+  uint64_t VLManagerMetrics::*member;
+};
+
+// clang-format off
+/// Counters, in the same order as viv::Metrics::Counter.
+constexpr CounterInfo kCounters[] = {
+    {"viv_packets_received", "Value notifications received.",
+     &VLManagerMetrics::packets_received},
+    {"viv_packets_sent", "Values written.",
+     &VLManagerMetrics::packets_sent},
+    {"viv_crc_failures", "Value notifications with a bad CRC.",
+     &VLManagerMetrics::crc_failures},
+    {"viv_length_failures", "Value notifications with a bad length.",
+     &VLManagerMetrics::length_failures},
+    {"viv_seqno_errors", "Burst packets with an unexpected sequence number.",
+     &VLManagerMetrics::seqno_errors},
+    {"viv_acks", "Command acknowledgements received.",
+     &VLManagerMetrics::acks},
+    {"viv_downloaded_bytes", "Bytes of file content received.",
+     &VLManagerMetrics::bytes_downloaded},
+    {"viv_commands_completed", "Commands completed.",
+     &VLManagerMetrics::commands_completed},
+    {"viv_commands_failed", "Commands with an invalid response or timeout.",
+     &VLManagerMetrics::commands_failed},
+    {"viv_timeouts", "Timeouts while waiting for a command.",
+     &VLManagerMetrics::timeouts},
+};
+// clang-format on
+
+static_assert(
+    sizeof(kCounters) / sizeof(kCounters[0]) == viv::Metrics::kNumCounters,
+    "kCounters must describe every counter");
+
+/// Appends formatted text at \p offset, advancing it by the untruncated
+/// length.
+__attribute__((format(printf, 4, 5))) void
+AppendFormat(
+    char *_Nullable buf, size_t length, size_t &offset, char const *fmt, ...) {
+  char *dst = nullptr;
+  size_t available = 0;
+  if (buf != nullptr && offset < length) {
+    dst = buf + offset;
+    available = length - offset;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int const n = std::vsnprintf(dst, available, fmt, args);
+  va_end(args);
+  if (n > 0) {
+    offset += n;
+  }
+}
+
+} // namespace
+
+namespace viv {
+
+VLManagerMetrics
+Metrics::Snapshot() const {
+  VLManagerMetrics metrics;
+  for (;;) {
+    uint32_t const begin = seq_.load(std::memory_order_acquire);
+    if (begin & 1) {
+      continue;
+    }
+    for (size_t i = 0; i < kNumCounters; ++i) {
+      metrics.*kCounters[i].member =
+          counters_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) == begin) {
+      return metrics;
+    }
+  }
+}
+
+} // namespace viv
+
+void
+VLMergeManagerMetrics(VLManagerMetrics *into, VLManagerMetrics const *from) {
+  assert(into != nullptr);
+  assert(from != nullptr);
+
+  for (auto const &counter : kCounters) {
+    into->*counter.member += from->*counter.member;
+  }
+}
+
+size_t
+VLFormatManagerMetrics(
+    VLManagerMetrics const *metrics, char *_Nullable buf, size_t length) {
+  assert(metrics != nullptr);
+
+  size_t offset = 0;
+  if (buf != nullptr && length > 0) {
+    buf[0] = '\0';
+  }
+  for (auto const &counter : kCounters) {
+    AppendFormat(
+        buf, length, offset,
+        "# TYPE %s counter\n"
+        "# HELP %s %s\n"
+        "%s_total %" PRIu64 "\n",
+        counter.name, counter.name, counter.help, counter.name,
+        metrics->*counter.member);
+  }
+  AppendFormat(buf, length, offset, "# EOF\n");
+  return offset;
+}
+
+#pragma clang assume_nonnull end
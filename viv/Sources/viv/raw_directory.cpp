@@ -18,6 +18,7 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
+#include <cstddef>
 #include <cstring>
 #include <type_traits>
 
@@ -31,6 +32,10 @@ constexpr uint8_t kExpectedTimeFormat = 0;
 /// Expected value for VLDirectoryHeader::record_length.
 constexpr uint8_t kExpectedRecordLength = 16;
 
+/// 32-bit FNV-1a parameters.
+constexpr uint32_t kFnvOffsetBasis = 2166136261UL;
+constexpr uint32_t kFnvPrime = 16777619UL;
+
 // This implementation assumes there is no padding between the members of
 // VLDirectoryHeader.
 static_assert(
@@ -91,3 +96,19 @@ VLReadNextDirectoryEntry(
 
   return sizeof(VLRawDirectoryEntry);
 }
+
+uint32_t
+VLDirectoryFingerprint(uint8_t const *src, size_t length) {
+  assert(src != nullptr);
+
+  constexpr size_t kTimeBegin = offsetof(VLDirectoryHeader, time);
+  constexpr size_t kTimeEnd = kTimeBegin + sizeof(VLDirectoryHeader::time);
+  uint32_t hash = kFnvOffsetBasis;
+  for (size_t i = 0; i < length; ++i) {
+    if (i >= kTimeBegin && i < kTimeEnd) {
+      continue;
+    }
+    hash = (hash ^ src[i]) * kFnvPrime;
+  }
+  return hash;
+}
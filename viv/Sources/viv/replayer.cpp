@@ -0,0 +1,154 @@
+// replayer.cpp - drives a manager from a capture
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/replayer.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "viv/capture.hpp"
+#include "viv/endian.hpp"
+#include "viv/manager.hpp"
+
+#pragma clang assume_nonnull begin
+
+namespace viv {
+
+int
+Replayer::Step() {
+  CaptureEvent event;
+  int const err = reader_.Next(event);
+  if (err <= 0) {
+    return err;
+  }
+
+  if (has_time_ && wait_ && event.time > time_) {
+    wait_(event.time - time_);
+  }
+  time_ = event.time;
+  has_time_ = true;
+
+  switch (event.type) {
+  case kCaptureNotifyValue:
+    manager_.NotifyValue(event.value, event.length);
+    return 1;
+  case kCaptureWriteValue:
+    // The manager writes its own values as calls are replayed.
+    return 1;
+  case kCaptureCall:
+    return ReplayCall(event);
+  case kCaptureTimeout:
+    manager_.NotifyTimeout();
+    return 1;
+  }
+  return -2;
+}
+
+int
+Replayer::Run() {
+  int n = 0;
+  int err;
+  while ((err = Step()) > 0) {
+    ++n;
+  }
+  return (err < 0) ? err : n;
+}
+
+int
+Replayer::ReplayCall(CaptureEvent const &event) {
+  if (event.length == 0) {
+    return -4;
+  }
+  uint8_t const *const args = event.value + 1;
+  size_t const length = event.length - 1;
+
+  switch (event.value[0]) {
+  case kCaptureCallDownloadDirectory:
+    manager_.DownloadDirectory();
+    break;
+  case kCaptureCallDownloadDirectoryIfChanged:
+    if (length < sizeof(uint32_t)) {
+      return -4;
+    }
+    manager_.DownloadDirectoryIfChanged(OSReadLittleInt32(args, 0));
+    break;
+  case kCaptureCallProbeDirectory:
+    if (length < 2 * sizeof(uint16_t)) {
+      return -4;
+    }
+    manager_.ProbeDirectory(
+        OSReadLittleInt16(args, 0), OSReadLittleInt16(args, 2));
+    break;
+  case kCaptureCallDownloadDirectoryPage:
+    if (length < 2 * sizeof(uint16_t)) {
+      return -4;
+    }
+    manager_.DownloadDirectoryPage(
+        OSReadLittleInt16(args, 0), OSReadLittleInt16(args, 2));
+    break;
+  case kCaptureCallQueryDirectory:
+    if (length < kCaptureQueryLength) {
+      return -4;
+    }
+    manager_.QueryDirectory(ReadCaptureQuery(args));
+    break;
+  case kCaptureCallDownloadFile:
+    if (length < sizeof(uint16_t) + sizeof(uint32_t)) {
+      return -4;
+    }
+    manager_.DownloadFile(
+        OSReadLittleInt16(args, 0), OSReadLittleInt32(args, 2));
+    break;
+  case kCaptureCallEraseFile:
+    if (length < sizeof(uint16_t)) {
+      return -4;
+    }
+    manager_.EraseFile(OSReadLittleInt16(args, 0));
+    break;
+  case kCaptureCallEraseFiles: {
+    if (length < 1) {
+      return -4;
+    }
+    constexpr size_t kCapacity =
+        sizeof(erase_indices_) / sizeof(erase_indices_[0]);
+    for (size_t i = 1; i + sizeof(uint16_t) <= length; i += sizeof(uint16_t)) {
+      if (erase_count_ < kCapacity) {
+        erase_indices_[erase_count_++] = OSReadLittleInt16(args, i);
+      }
+    }
+    if (args[0]) {
+      // More of the batch follows.
+      break;
+    }
+    size_t const count = erase_count_;
+    erase_count_ = 0;
+    manager_.EraseFiles(erase_indices_, count);
+    break;
+  }
+  case kCaptureCallSetTime:
+    if (length < sizeof(uint64_t)) {
+      return -4;
+    }
+    manager_.SetTime(ReadCaptureTime(args, 0));
+    break;
+  default:
+    return -4;
+  }
+  return 1;
+}
+
+} // namespace viv
+
+#pragma clang assume_nonnull end
@@ -30,7 +30,7 @@ VLPacket
 SetTimeCommand::MakeCommandPacket() const {
   uint8_t payload[sizeof(uint32_t)];
 
-  OSWriteLittleInt32(payload, 0, time_);
+  VLWriteLittleInt32(payload, 0, time_);
   return VLMakePacket(kVLSeqnoEnd, kCommandSetTime, payload, sizeof(payload));
 }
 
@@ -44,7 +44,7 @@ SetTimeCommand::ReadPacket(VLPacket const &packet) {
 }
 
 bool
-SetTimeCommand::MaybeFinish() const {
+SetTimeCommand::MaybeFinish() {
   on_finish_(has_ack_);
 
   return has_ack_;
@@ -0,0 +1,230 @@
+// sync_plan.cpp - planning a sync from the directory and local files
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "viv/sync_plan.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include "viv/clock_discipline.h"
+#include "viv/directory.hpp"
+#include "viv/erase_batch.hpp"
+#include "viv/ingest_index.h"
+#include "viv/ingest_index.hpp"
+#include "viv/manager.hpp"
+#include "viv/sync_plan.h"
+
+namespace {
+
+/// Returns the ingested copy of file \p index, or null.
+VLLocalFile const *_Nullable
+FindLocal(VLLocalFile const *_Nullable local, size_t count, uint16_t index) {
+  if (local == nullptr) {
+    return nullptr;
+  }
+  VLLocalFile const *const end = local + count;
+  VLLocalFile const *const found = std::lower_bound(
+      local, end, index, [](VLLocalFile const &file, uint16_t index) {
+        return file.index < index;
+      });
+  return (found != end && found->index == index) ? found : nullptr;
+}
+
+/// Returns whether the files in \p local are in ascending order of index.
+bool
+IsSorted(VLLocalFile const *_Nullable local, size_t count) {
+  for (size_t i = 1; i < count; ++i) {
+    if (local[i - 1].index >= local[i].index) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+namespace viv {
+
+bool
+SyncPlanner::PlanEntry(
+    DirectoryEntry const &entry, VLLocalFile const *_Nullable local,
+    VLSyncStep &step) const {
+  uint8_t const flags = entry.raw_entry().flags;
+  if (!(flags & kReadable) || !filter_.Matches(entry)) {
+    return false;
+  }
+
+  step = VLSyncStep{kVLSyncActionDownload, 0, entry.entry()};
+  switch (IngestStateOf(step.entry, local)) {
+  case kVLIngestStateNew:
+  case kVLIngestStateStale:
+    return true;
+  case kVLIngestStatePartial:
+    step.action = kVLSyncActionResume;
+    step.offset = local->length;
+    return true;
+  case kVLIngestStateIngested:
+    step.action = kVLSyncActionErase;
+    return policy_.erase_ingested && (flags & kErasable);
+  }
+  return false;
+}
+
+bool
+SyncPlanner::ShouldSetTime() const {
+  return VLClockShouldSet(
+      &policy_.clock, &policy_.clock_options, policy_.host_time,
+      policy_.clock_offset);
+}
+
+int
+SyncPlanner::Plan(
+    DirectoryView const &dir, VLLocalFile const *_Nullable local,
+    size_t local_count, VLSyncStep *_Nullable steps, size_t capacity) const {
+  if (!IsSorted(local, local_count)) {
+    return -1;
+  }
+  return PlanWith(
+      dir,
+      [local, local_count](uint16_t index, VLLocalFile &) {
+        return FindLocal(local, local_count, index);
+      },
+      steps, capacity);
+}
+
+int
+SyncPlanner::Plan(
+    DirectoryView const &dir, IngestIndex const &index,
+    VLDeviceId const &device, VLSyncStep *_Nullable steps,
+    size_t capacity) const {
+  return PlanWith(
+      dir,
+      [&index, &device](
+          uint16_t file_index, VLLocalFile &file) -> VLLocalFile const * {
+        return index.Lookup(device, file_index, file) ? &file : nullptr;
+      },
+      steps, capacity);
+}
+
+template <typename F>
+int
+SyncPlanner::PlanWith(
+    DirectoryView const &dir, F &&find, VLSyncStep *_Nullable steps,
+    size_t capacity) const {
+  // Count first, so that nothing is written unless the whole plan fits.
+  size_t const set_time = ShouldSetTime() ? 1 : 0;
+  size_t count = set_time;
+  VLSyncStep step;
+  VLLocalFile storage;
+  for (DirectoryEntry const entry : dir) {
+    count += PlanEntry(entry, find(entry.index(), storage), step);
+  }
+  if (count > capacity || steps == nullptr) {
+    return static_cast<int>(count);
+  }
+
+  // Each pass appends one kind of step, in directory order.
+  size_t n = 0;
+  auto append = [&](VLSyncAction action) {
+    for (DirectoryEntry const entry : dir) {
+      VLLocalFile const *file = find(entry.index(), storage);
+      if (PlanEntry(entry, file, step) && step.action == action) {
+        steps[n++] = step;
+      }
+    }
+  };
+  append(kVLSyncActionResume);
+  size_t const downloads = n;
+  append(kVLSyncActionDownload);
+  std::sort(
+      steps + downloads, steps + n,
+      [](VLSyncStep const &a, VLSyncStep const &b) {
+        return a.entry.posix_time < b.entry.posix_time ||
+               (a.entry.posix_time == b.entry.posix_time &&
+                a.entry.index < b.entry.index);
+      });
+  append(kVLSyncActionErase);
+  if (set_time) {
+    steps[n++] = VLSyncStep{kVLSyncActionSetTime, 0, {}};
+  }
+  assert(n == count);
+  return static_cast<int>(n);
+}
+
+size_t
+IssueSyncSteps(
+    Manager &manager, VLSyncStep const *steps, size_t count,
+    time_t posix_time) {
+  if (count == 0) {
+    return 0;
+  }
+
+  VLSyncStep const &step = steps[0];
+  switch (step.action) {
+  case kVLSyncActionDownload:
+    manager.DownloadFile(step.entry.index);
+    return 1;
+  case kVLSyncActionResume:
+    manager.DownloadFile(step.entry.index, step.offset);
+    return 1;
+  case kVLSyncActionErase: {
+    uint16_t indices[EraseBatch::kMaxFiles];
+    size_t n = 0;
+    while (n < count && n < EraseBatch::kMaxFiles &&
+           steps[n].action == kVLSyncActionErase) {
+      indices[n] = steps[n].entry.index;
+      ++n;
+    }
+    manager.EraseFiles(indices, n);
+    return n;
+  }
+  case kVLSyncActionSetTime:
+    manager.SetTime(posix_time);
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace viv
+
+VLSyncPolicy
+VLSyncDefaultPolicy() {
+  VLSyncPolicy policy = {};
+  policy.clock_options = VLClockDefaultOptions();
+  policy.clock_offset = NAN;
+  return policy;
+}
+
+int
+VLPlanSync(
+    uint8_t const *directory, size_t length, VLLocalFile const *_Nullable local,
+    size_t local_count, VLSyncPolicy const *policy, VLSyncStep *_Nullable steps,
+    size_t capacity) {
+  assert(directory != nullptr);
+  assert(policy != nullptr);
+  assert(local != nullptr || local_count == 0);
+
+  viv::DirectoryView dir(directory, length);
+  if (!dir.Read()) {
+    return -1;
+  }
+  int const count =
+      viv::SyncPlanner(*policy).Plan(dir, local, local_count, steps, capacity);
+  return (count < 0) ? -2 : count;
+}
@@ -0,0 +1,483 @@
+// main.cpp - end-to-end session benchmarks
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs complete manager sessions (directory download, then every file, then
+// erases, then set time) against a simulated device over a lossy link, and
+// prints the results as JSON.
+//
+// Also reports the goodput of file downloads under each class of link fault,
+// and times bulk decoding of directory entries into columns, comparing the
+// scalar and vector decoders.
+//
+// Usage: vivbench [--sessions N] [--quick]
+//
+// The output schema is versioned by its "schema" field; fields are only ever
+// added, so results from different releases can be diffed.  Schema 2 counts
+// only the manager's own allocations, and reports peak RSS per case.
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "viv/directory_columns.hpp"
+#include "viv/directory_entry.h"
+#include "viv/manager.hpp"
+#include "viv/manager_error_code.h"
+#include "viv/packet.h"
+#include "viv/raw_directory.h"
+#include "viv/vivtime.h"
+#include "vivsim/device.hpp"
+#include "vivsim/fault_injector.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+constexpr char kSchema[] = "vivbench/2";
+
+/// Arbitrary time for set-time commands and the device's clock.
+constexpr time_t kPosixTime = 1600000000;
+
+/// Response timeout, matching vivtool.
+constexpr vivsim::Time kTimeout = 16 * vivsim::kSecond;
+
+/// Number of calls to operator new while gCounting.
+std::atomic<uint64_t> gNewCount(0);
+
+/// True while the manager is doing its own work, rather than the simulator
+/// or the delegate.
+bool gCounting = false;
+
+/// Sets whether allocations are counted, until the end of the scope.
+class CountingScope {
+public:
+  explicit CountingScope(bool counting) : was_counting_(gCounting) {
+    gCounting = counting;
+  }
+
+  ~CountingScope() { gCounting = was_counting_; }
+
+  // Disallow copy/move semantics.
+  CountingScope(const CountingScope &) = delete;
+  CountingScope &operator=(const CountingScope &) = delete;
+
+private:
+  bool const was_counting_;
+};
+
+/// Sink for decoded values, so that decoding isn't optimized away.
+volatile uint64_t gDecodeSink = 0;
+
+struct Case {
+  int file_count;
+  size_t file_length;
+
+  /// Probability that each value from the device is faulted.
+  double error_rate;
+
+  /// The fault applied at error_rate.
+  vivsim::Fault fault = vivsim::kFaultCorrupt;
+};
+
+struct Totals {
+  uint64_t bytes = 0;
+  uint64_t faults = 0;
+  uint64_t errors = 0;
+  uint64_t timeouts = 0;
+  vivsim::Time virtual_time = 0;
+};
+
+/// Returns the process's user + system CPU time, in seconds.
+double
+CpuSeconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/// Returns the process's peak resident set size, in bytes.
+///
+/// A forked child starts from (at most) its parent's resident set.
+uint64_t
+PeakRssBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/// The host side of a session.
+///
+/// Allocations are only counted inside calls to the manager, and not in its
+/// calls back to this delegate, so that they measure the manager rather than
+/// the simulator and the bookkeeping here.
+class BenchDelegate final : public viv::ManagerDelegate {
+public:
+  BenchDelegate(vivsim::Scheduler &scheduler, vivsim::Device &device)
+      : scheduler_(scheduler), device_(device),
+        timer_(scheduler, kTimeout, [this]() {
+          ++timeouts;
+          CountingScope counting(true);
+          manager_->NotifyTimeout();
+        }) {}
+
+  void Attach(viv::Manager *manager) { manager_ = manager; }
+
+  /// Schedules a value notification from the device to the manager.
+  void Deliver(uint8_t const *value, size_t length) {
+    std::array<uint8_t, kVLPacketMaxLength> copy;
+    length = std::min<size_t>(length, copy.size());
+    std::copy(value, value + length, copy.begin());
+    scheduler_.Schedule(0, [this, copy, length]() {
+      // Like vivtool, each value received restarts the response timer.
+      if (timer_.armed()) {
+        timer_.Start();
+      }
+      CountingScope counting(true);
+      manager_->NotifyValue(copy.data(), length);
+    });
+  }
+
+  int WriteValue(uint8_t const *value, size_t length) override {
+    CountingScope counting(false);
+    return device_.Receive(value, length);
+  }
+
+  void DidStartWaiting() const override {
+    CountingScope counting(false);
+    timer_.Start();
+  }
+
+  void DidFinishWaiting() const override {
+    CountingScope counting(false);
+    timer_.Stop();
+  }
+
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
+    ++errors;
+  }
+
+  void DidParseDirectoryEntry(VLDirectoryEntry entry) const override {
+    CountingScope counting(false);
+    entries.push_back(entry);
+  }
+
+  void DidParseDirectory(
+      VLDirectoryEntry const *entries, size_t count) const override {
+    CountingScope counting(false);
+    this->entries.insert(this->entries.end(), entries, entries + count);
+  }
+
+  void DidDownloadFile(
+      uint16_t index, uint8_t const *data, size_t length) const override {
+    CountingScope counting(false);
+    files.push_back(index);
+    bytes += length;
+  }
+
+  mutable std::vector<VLDirectoryEntry> entries;
+
+  /// Indices of the files downloaded.
+  mutable std::vector<uint16_t> files;
+
+  mutable uint64_t bytes = 0;
+  mutable uint64_t errors = 0;
+  uint64_t timeouts = 0;
+
+private:
+  vivsim::Scheduler &scheduler_;
+  vivsim::Device &device_;
+  viv::Manager *manager_ = nullptr;
+  mutable vivsim::Timer timer_;
+};
+
+/// Runs one complete session, adding its results to \p totals.
+void
+RunSession(Case const &c, uint64_t seed, Totals &totals) {
+  vivsim::Scheduler scheduler(seed);
+  vivsim::Device device(scheduler);
+  BenchDelegate *host = nullptr;
+  vivsim::FaultInjector injector(
+      scheduler,
+      vivsim::FaultProfile::Only(c.fault, c.error_rate, seed),
+      [&host](uint8_t const *value, size_t length) {
+        host->Deliver(value, length);
+      });
+  auto delegate = std::make_unique<BenchDelegate>(scheduler, device);
+  host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+  device.Attach(injector.link());
+
+  device.set_clock(VLGetVivaTimeFromPosix(kPosixTime));
+  for (int i = 1; i <= c.file_count; ++i) {
+    device.AddFile(
+        i, kVLFileTypeFitActivity, 0,
+        std::vector<uint8_t>(c.file_length, static_cast<uint8_t>(i)));
+  }
+
+  auto const call = [&scheduler](auto &&f) {
+    {
+      CountingScope counting(true);
+      f();
+    }
+    scheduler.Run();
+  };
+  call([&]() { manager.DownloadDirectory(); });
+  std::vector<VLDirectoryEntry> const entries = host->entries;
+  for (auto const &entry : entries) {
+    call([&]() { manager.DownloadFile(entry.index); });
+  }
+  std::vector<uint16_t> const files = host->files;
+  for (uint16_t const index : files) {
+    call([&]() { manager.EraseFile(index); });
+  }
+  call([&]() { manager.SetTime(kPosixTime); });
+
+  totals.bytes += host->bytes;
+  if (c.fault != vivsim::kNumFaults) {
+    totals.faults += injector.count(c.fault);
+  }
+  totals.errors += host->errors;
+  totals.timeouts += host->timeouts;
+  totals.virtual_time += scheduler.now();
+}
+
+/// Runs \p sessions sessions of \p c and prints a JSON result object.
+void
+RunCase(Case const &c, int sessions, bool last) {
+  Totals totals;
+  uint64_t const news = gNewCount.load(std::memory_order_relaxed);
+  double const cpu = CpuSeconds();
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < sessions; ++i) {
+    RunSession(c, i, totals);
+  }
+  std::chrono::duration<double> const wall =
+      std::chrono::steady_clock::now() - start;
+  double const cpu_seconds = CpuSeconds() - cpu;
+  uint64_t const allocations =
+      gNewCount.load(std::memory_order_relaxed) - news;
+  double const mib = totals.bytes / (1024.0 * 1024.0);
+
+  std::printf(
+      "    {\"file_count\": %d, \"file_length\": %zu, \"error_rate\": %g,\n"
+      "     \"sessions\": %d, \"sessions_per_second\": %.3f,\n"
+      "     \"cpu_seconds_per_mib\": %.6f, \"allocations_per_session\": %.1f,\n"
+      "     \"bytes_per_session\": %.1f, \"errors_per_session\": %.3f,\n"
+      "     \"timeouts_per_session\": %.3f, \"peak_rss_bytes\": %llu,\n"
+      "     \"virtual_seconds_per_session\": %.3f}%s\n",
+      c.file_count, c.file_length, c.error_rate, sessions,
+      sessions / wall.count(), (mib > 0) ? cpu_seconds / mib : 0.0,
+      static_cast<double>(allocations) / sessions,
+      static_cast<double>(totals.bytes) / sessions,
+      static_cast<double>(totals.errors) / sessions,
+      static_cast<double>(totals.timeouts) / sessions,
+      static_cast<unsigned long long>(PeakRssBytes()),
+      static_cast<double>(totals.virtual_time) / vivsim::kSecond / sessions,
+      last ? "" : ",");
+}
+
+/// Runs RunCase in a child process, so that its peak RSS is its own rather
+/// than the largest of all the cases so far.
+void
+RunCaseInChild(Case const &c, int sessions, bool last) {
+  std::fflush(stdout);
+  pid_t const pid = fork();
+  if (pid < 0) {
+    RunCase(c, sessions, last);
+    return;
+  }
+  if (pid == 0) {
+    RunCase(c, sessions, last);
+    std::fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+}
+
+/// Runs \p sessions sessions of \p c and prints a JSON object with the
+/// goodput of its file downloads: whole files' bytes per virtual second of
+/// the session.
+void
+RunFaultCase(Case const &c, int sessions, bool last) {
+  Totals totals;
+  for (int i = 0; i < sessions; ++i) {
+    RunSession(c, i, totals);
+  }
+  double const seconds =
+      static_cast<double>(totals.virtual_time) / vivsim::kSecond;
+
+  std::printf(
+      "    {\"fault\": \"%s\", \"error_rate\": %g, \"sessions\": %d,\n"
+      "     \"faults_per_session\": %.3f, \"bytes_per_session\": %.1f,\n"
+      "     \"goodput_bytes_per_second\": %.1f}%s\n",
+      vivsim::FaultName(c.fault), c.error_rate, sessions,
+      static_cast<double>(totals.faults) / sessions,
+      static_cast<double>(totals.bytes) / sessions,
+      (seconds > 0) ? totals.bytes / seconds : 0.0, last ? "" : ",");
+}
+
+/// Returns the mean time to decode one of \p entries, in nanoseconds.
+template <typename Decode>
+double
+TimeDecode(
+    Decode decode, std::vector<VLRawDirectoryEntry> const &entries,
+    int repeats) {
+  size_t const n = entries.size();
+  std::vector<uint16_t> index(n);
+  std::vector<uint16_t> file_type(n);
+  std::vector<uint8_t> flags(n);
+  std::vector<uint32_t> length(n);
+  std::vector<time_t> posix_time(n);
+  viv::DirectoryColumns const columns{
+      index.data(), file_type.data(), flags.data(), length.data(),
+      posix_time.data()};
+
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    decode(entries.data(), n, columns);
+    gDecodeSink = gDecodeSink + length[i % n] + posix_time[n - 1];
+  }
+  std::chrono::duration<double, std::nano> const elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (static_cast<double>(n) * repeats);
+}
+
+/// Times the scalar and vector decoders on \p count entries and prints a JSON
+/// result object.
+void
+RunDecodeCase(size_t count, size_t total_entries, bool last) {
+  std::vector<VLRawDirectoryEntry> entries(count);
+  auto *const p = reinterpret_cast<uint8_t *>(entries.data());
+  uint32_t x = 1;
+  for (size_t i = 0; i < count * sizeof(VLRawDirectoryEntry); ++i) {
+    x = x * 1664525 + 1013904223;
+    p[i] = static_cast<uint8_t>(x >> 24);
+  }
+  int const repeats = static_cast<int>(total_entries / count) + 1;
+
+  double const scalar =
+      TimeDecode(viv::DecodeDirectoryColumnsScalar, entries, repeats);
+  double const vector =
+      TimeDecode(viv::DecodeDirectoryColumns, entries, repeats);
+  std::printf(
+      "    {\"entries\": %zu, \"vector\": %s,\n"
+      "     \"scalar_ns_per_entry\": %.3f, \"vector_ns_per_entry\": %.3f}%s\n",
+      count, viv::kHasVectorDirectoryDecoder ? "true" : "false", scalar, vector,
+      last ? "" : ",");
+}
+
+} // namespace
+
+void *
+operator new(std::size_t size) {
+  if (gCounting) {
+    gNewCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    std::abort();
+  }
+  return p;
+}
+
+void
+operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t size) noexcept {
+  std::free(p);
+}
+
+int
+main(int argc, char const *argv[]) {
+  int sessions = 3;
+  bool quick = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--sessions") && i + 1 < argc) {
+      sessions = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--quick")) {
+      quick = true;
+    } else {
+      std::fprintf(stderr, "usage: %s [--sessions N] [--quick]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (sessions < 1) {
+    sessions = 1;
+  }
+
+  std::vector<int> file_counts{1, 8, 32};
+  std::vector<size_t> file_lengths{1024, 16384, 131072};
+  std::vector<double> error_rates{0, 0.001, 0.01};
+  if (quick) {
+    file_counts = {1, 8};
+    file_lengths = {1024};
+    error_rates = {0, 0.01};
+  }
+
+  std::vector<Case> cases;
+  for (int const file_count : file_counts) {
+    for (size_t const file_length : file_lengths) {
+      for (double const error_rate : error_rates) {
+        cases.push_back(Case{file_count, file_length, error_rate});
+      }
+    }
+  }
+
+  std::printf("{\n  \"schema\": \"%s\",\n  \"results\": [\n", kSchema);
+  for (size_t i = 0; i < cases.size(); ++i) {
+    RunCaseInChild(cases[i], sessions, i + 1 == cases.size());
+  }
+
+  // Each fault class alone, after a clean baseline (kNumFaults).
+  std::printf("  ],\n  \"faults\": [\n");
+  for (int i = vivsim::kNumFaults; i >= 0; --i) {
+    Case c{8, 16384, (i == vivsim::kNumFaults) ? 0 : 0.01};
+    c.fault = static_cast<vivsim::Fault>(i);
+    RunFaultCase(c, sessions, i == 0);
+  }
+
+  std::vector<size_t> const decode_counts{16, 256, 65536};
+  size_t const decode_total = quick ? (1 << 20) : (1 << 24);
+  std::printf("  ],\n  \"decode\": [\n");
+  for (size_t i = 0; i < decode_counts.size(); ++i) {
+    RunDecodeCase(
+        decode_counts[i], decode_total, i + 1 == decode_counts.size());
+  }
+  std::printf(
+      "  ],\n  \"peak_rss_bytes\": %llu\n}\n",
+      static_cast<unsigned long long>(PeakRssBytes()));
+  return 0;
+}
@@ -0,0 +1,287 @@
+// device.cpp - simulated Viiiiva
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "vivsim/device.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "viv/crc.hpp"
+#include "viv/directory.hpp"
+#include "viv/endian.hpp"
+#include "viv/packet.h"
+#include "viv/raw_directory.h"
+
+#pragma clang assume_nonnull begin
+
+namespace {
+
+// Commands sent from host to Viiiiva.
+constexpr VLCommandId kCommandSetTime = 0x0108;
+constexpr VLCommandId kCommandDownload = 0x010b;
+constexpr VLCommandId kCommandErase = 0x040b;
+
+// Replies sent from Viiiiva to host.
+constexpr VLCommandId kCommandDownloadReply = 0x030b;
+constexpr VLCommandId kCommandEraseReply = 0x050b;
+
+/// Bit set in the command ID of an acknowledgement.
+constexpr VLCommandId kAckBit = 0x8000;
+
+/// Sender and receiver bytes of packets from Viiiiva to host.
+constexpr uint8_t kPeerHost = 3;
+constexpr uint8_t kPeerViiiiva = 1;
+
+/// Length of the header fields that precede VLPacket::payload.
+constexpr size_t kPacketHeaderLength = 6;
+
+/// Maximum payload per packet.
+constexpr size_t kMaxPayloadLength = kVLPacketMaxLength - kPacketHeaderLength;
+
+/// Length of each directory record (the header and each entry).
+constexpr size_t kRecordLength = sizeof(VLRawDirectoryEntry);
+
+/// Status byte in an erase reply.
+constexpr uint8_t kEraseOk = 0;
+constexpr uint8_t kEraseFailed = 1;
+
+/// Builds a packet from Viiiiva to host.
+VLPacket
+MakeDevicePacket(
+    uint8_t seqno, VLCommandId cmd, uint8_t const *_Nullable payload,
+    size_t payload_length) {
+  assert(seqno <= kVLSeqnoEnd);
+  assert(payload_length <= kMaxPayloadLength);
+
+  VLPacket packet = {0};
+  packet.payload_length = static_cast<uint8_t>(payload_length);
+  packet.sender = kPeerViiiiva;
+  packet.receiver = kPeerHost;
+  VLWriteLittleInt16(packet.cmd, 0, cmd);
+  if (payload_length > 0) {
+    std::memcpy(packet.payload, payload, payload_length);
+  }
+  uint8_t const crc = viv::crc(
+      &packet.payload_length, payload_length + kPacketHeaderLength - 1);
+  packet.crc = static_cast<uint8_t>(seqno << 5) | (crc & 0x1f);
+  return packet;
+}
+
+} // namespace
+
+namespace vivsim {
+
+Device::Device(Scheduler &scheduler, Time latency, Time packet_interval)
+    : scheduler_(scheduler), latency_(latency),
+      packet_interval_(packet_interval) {}
+
+Device::~Device() { CancelPending(); }
+
+void
+Device::AddFile(
+    uint16_t index, VLFileType file_type, uint32_t viva_time,
+    std::vector<uint8_t> contents) {
+  assert(index != 0);
+  files_[index] = File{file_type, viva_time, std::move(contents)};
+}
+
+void
+Device::set_clock(uint32_t viva_time) {
+  clock_ = viva_time;
+  clock_set_at_ = scheduler_.now();
+}
+
+uint32_t
+Device::clock() const {
+  return clock_ +
+         static_cast<uint32_t>((scheduler_.now() - clock_set_at_) / kSecond);
+}
+
+std::vector<uint8_t>
+Device::Directory() const {
+  std::vector<uint8_t> directory((1 + files_.size()) * kRecordLength);
+  VLRawDirectoryHeader header = {0};
+  header.version = 1;
+  header.record_length = kRecordLength;
+  VLWriteLittleInt32(header.time, 0, clock());
+  std::memcpy(directory.data(), &header, sizeof(header));
+
+  uint8_t *p = directory.data() + kRecordLength;
+  for (auto const &file : files_) {
+    VLRawDirectoryEntry entry = {0};
+    VLWriteLittleInt16(entry.index, 0, file.first);
+    entry.file_type = file.second.file_type & 0xff;
+    entry.subtype = file.second.file_type >> 8;
+    VLWriteLittleInt16(entry.file_id, 0, file.first);
+    VLWriteLittleInt32(
+        entry.length, 0, static_cast<uint32_t>(file.second.contents.size()));
+    VLWriteLittleInt32(entry.time, 0, file.second.viva_time);
+    // Every file can be downloaded and erased.
+    entry.flags = viv::kReadable | viv::kErasable;
+    std::memcpy(p, &entry, sizeof(entry));
+    p += kRecordLength;
+  }
+  return directory;
+}
+
+int
+Device::Receive(uint8_t const *value, size_t length) {
+  VLPacket packet;
+  if (VLReadPacket(&packet, value, length) || packet.sender != kPeerHost) {
+    ++ignored_;
+    return 0;
+  }
+
+  int const served = commands_;
+  switch (OSReadLittleInt16(packet.cmd, 0)) {
+  case kCommandDownload:
+    Download(packet);
+    break;
+  case kCommandErase:
+    Erase(packet);
+    break;
+  case kCommandSetTime:
+    SetTime(packet);
+    break;
+  default:
+    // Including the host's acknowledgements of replies.
+    break;
+  }
+  if (commands_ == served) {
+    ++ignored_;
+  }
+  return 0;
+}
+
+void
+Device::Download(VLPacket const &packet) {
+  if (packet.payload_length < 10) {
+    return;
+  }
+  uint16_t const index = OSReadLittleInt16(packet.payload, 0);
+  uint32_t const offset = OSReadLittleInt32(packet.payload, 2);
+  uint32_t const length_limit = OSReadLittleInt32(packet.payload, 6);
+
+  std::vector<uint8_t> directory;
+  std::vector<uint8_t> const *contents;
+  if (index == 0) {
+    directory = Directory();
+    contents = &directory;
+  } else {
+    auto const it = files_.find(index);
+    if (it == files_.end()) {
+      return;
+    }
+    contents = &it->second.contents;
+  }
+
+  ++commands_;
+  CancelPending();
+  size_t length = (offset < contents->size()) ? contents->size() - offset : 0;
+  // The directory's length is counted in records, so it is only sent whole
+  // records at a time.
+  uint32_t ack_length;
+  if (index == 0) {
+    ack_length = static_cast<uint32_t>(
+        std::min<size_t>(length / kRecordLength, length_limit));
+    length = ack_length * kRecordLength;
+  } else {
+    length = std::min<size_t>(length, length_limit);
+    ack_length = static_cast<uint32_t>(length);
+  }
+
+  uint8_t ack[10];
+  uint8_t *p = ack;
+  p += VLWriteLittleInt16(p, 0, index);
+  p += VLWriteLittleInt32(p, 0, offset);
+  VLWriteLittleInt32(p, 0, ack_length);
+  Send(kVLSeqnoEnd, kCommandDownload | kAckBit, ack, sizeof(ack));
+  SendBurst(
+      contents->data() + std::min<size_t>(offset, contents->size()), length);
+}
+
+void
+Device::Erase(VLPacket const &packet) {
+  if (packet.payload_length < sizeof(uint16_t)) {
+    return;
+  }
+  uint16_t const index = OSReadLittleInt16(packet.payload, 0);
+
+  ++commands_;
+  CancelPending();
+  uint8_t const status = files_.erase(index) ? kEraseOk : kEraseFailed;
+  Send(kVLSeqnoEnd, kCommandErase | kAckBit, nullptr, 0);
+  Send(kVLSeqnoEnd, kCommandEraseReply, &status, sizeof(status));
+}
+
+void
+Device::SetTime(VLPacket const &packet) {
+  if (packet.payload_length < sizeof(uint32_t)) {
+    return;
+  }
+
+  ++commands_;
+  CancelPending();
+  set_clock(OSReadLittleInt32(packet.payload, 0));
+  Send(kVLSeqnoEnd, kCommandSetTime | kAckBit, nullptr, 0);
+}
+
+void
+Device::SendBurst(uint8_t const *data, size_t length) {
+  uint8_t seqno = kVLSeqnoStart;
+  while (length > 0) {
+    size_t const n = std::min(length, kMaxPayloadLength);
+    length -= n;
+    Send(length == 0 ? kVLSeqnoEnd : seqno, kCommandDownloadReply, data, n);
+    data += n;
+    seqno = VLGetNextSeqno(seqno);
+  }
+}
+
+void
+Device::Send(
+    uint8_t seqno, VLCommandId cmd, uint8_t const *_Nullable payload,
+    size_t payload_length) {
+  VLPacket const packet = MakeDevicePacket(seqno, cmd, payload, payload_length);
+  pending_.push_back(scheduler_.Schedule(
+      next_delay_,
+      [this, packet]() {
+        ++packets_sent_;
+        if (link_) {
+          link_(
+              reinterpret_cast<uint8_t const *>(&packet),
+              VLPacketLength(&packet));
+        }
+      },
+      "device"));
+  next_delay_ += packet_interval_;
+}
+
+void
+Device::CancelPending() {
+  for (auto const id : pending_) {
+    scheduler_.Cancel(id);
+  }
+  pending_.clear();
+  next_delay_ = latency_;
+}
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
@@ -0,0 +1,221 @@
+// fault_injector.cpp - simulated link faults
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "vivsim/fault_injector.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <utility>
+
+#include "viv/packet.h"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+namespace {
+
+/// Number of bits of the first byte that the masked CRC checks.
+constexpr size_t kCrcBits = 5;
+
+/// Offset of the first byte after the length byte, which VLReadPacket checks
+/// before the CRC.
+constexpr size_t kCrcCoveredOffset = 2;
+
+} // namespace
+
+char const *
+FaultName(Fault fault) {
+  switch (fault) {
+  case kFaultDrop:
+    return "drop";
+  case kFaultDuplicate:
+    return "duplicate";
+  case kFaultReorder:
+    return "reorder";
+  case kFaultCorrupt:
+    return "corrupt";
+  case kFaultTruncate:
+    return "truncate";
+  case kFaultDelay:
+    return "delay";
+  case kNumFaults:
+    break;
+  }
+  return "none";
+}
+
+FaultProfile
+FaultProfile::Only(Fault fault, double p, uint64_t seed) {
+  FaultProfile profile;
+  profile.seed = seed;
+  switch (fault) {
+  case kFaultDrop:
+    profile.drop = p;
+    break;
+  case kFaultDuplicate:
+    profile.duplicate = p;
+    break;
+  case kFaultReorder:
+    profile.reorder = p;
+    break;
+  case kFaultCorrupt:
+    profile.corrupt = p;
+    break;
+  case kFaultTruncate:
+    profile.truncate = p;
+    break;
+  case kFaultDelay:
+    profile.delay = p;
+    break;
+  case kNumFaults:
+    break;
+  }
+  return profile;
+}
+
+FaultInjector::FaultInjector(
+    Scheduler &scheduler, FaultProfile const &profile, Link link)
+    : scheduler_(scheduler), profile_(profile), link_(std::move(link)),
+      rng_(profile.seed) {}
+
+FaultInjector::~FaultInjector() {
+  if (has_held_) {
+    scheduler_.Cancel(release_task_);
+  }
+}
+
+void
+FaultInjector::Send(uint8_t const *value, size_t length) {
+  ++sent_;
+  Value v;
+  v.length = std::min<size_t>(length, v.bytes.size());
+  std::copy(value, value + v.length, v.bytes.begin());
+
+  // Empty values can't be corrupted or truncated, so pass them through.
+  Fault const fault = (v.length > 0) ? Choose() : kNumFaults;
+  if (fault != kNumFaults) {
+    ++counts_[fault];
+  }
+
+  switch (fault) {
+  case kFaultDrop:
+    break;
+  case kFaultDuplicate:
+    Deliver(v);
+    Deliver(v);
+    break;
+  case kFaultReorder:
+    if (has_held_) {
+      // Already holding one; let this one overtake it.
+      Deliver(v);
+      ReleaseHeld();
+    } else {
+      held_ = v;
+      has_held_ = true;
+      release_task_ = scheduler_.Schedule(
+          profile_.delay_time, [this]() { ReleaseHeld(); }, "release");
+    }
+    return;
+  case kFaultCorrupt: {
+    // Flip a bit of the CRC or of the bytes after the length, so that the
+    // CRC check (rather than the length check) fails.  Choose again if the
+    // masked CRC happens to miss the flip; flips of the CRC itself are always
+    // caught, so this terminates.  A value that was already unreadable just
+    // gets one flip.
+    VLPacket packet;
+    bool const readable = !VLReadPacket(&packet, v.bytes.data(), v.length);
+    size_t const covered_bits =
+        (v.length > kCrcCoveredOffset) ? (v.length - kCrcCoveredOffset) * 8
+                                       : 0;
+    std::uniform_int_distribution<size_t> bit(0, kCrcBits + covered_bits - 1);
+    for (;;) {
+      size_t const b = bit(rng_);
+      size_t const byte =
+          (b < kCrcBits) ? 0 : kCrcCoveredOffset + (b - kCrcBits) / 8;
+      uint8_t const mask = 1 << ((b < kCrcBits) ? b : (b - kCrcBits) % 8);
+      v.bytes[byte] ^= mask;
+      if (!readable || VLReadPacket(&packet, v.bytes.data(), v.length) == -2) {
+        break;
+      }
+      v.bytes[byte] ^= mask;
+    }
+    Deliver(v);
+    break;
+  }
+  case kFaultTruncate:
+    v.length = std::uniform_int_distribution<size_t>(0, v.length - 1)(rng_);
+    Deliver(v);
+    break;
+  case kFaultDelay: {
+    ++delivered_;
+    Link const link = link_;
+    scheduler_.Schedule(
+        profile_.delay_time,
+        [link, v]() {
+          if (link) {
+            link(v.bytes.data(), v.length);
+          }
+        },
+        "delayed");
+    break;
+  }
+  case kNumFaults:
+    Deliver(v);
+    break;
+  }
+
+  ReleaseHeld();
+}
+
+Fault
+FaultInjector::Choose() {
+  double const r = std::uniform_real_distribution<double>()(rng_);
+  double const p[kNumFaults] = {
+      profile_.drop,    profile_.duplicate, profile_.reorder,
+      profile_.corrupt, profile_.truncate,  profile_.delay};
+  double sum = 0;
+  for (int i = 0; i < kNumFaults; ++i) {
+    sum += p[i];
+    if (r < sum) {
+      return static_cast<Fault>(i);
+    }
+  }
+  return kNumFaults;
+}
+
+void
+FaultInjector::Deliver(Value const &value) {
+  ++delivered_;
+  if (link_) {
+    link_(value.bytes.data(), value.length);
+  }
+}
+
+void
+FaultInjector::ReleaseHeld() {
+  if (!has_held_) {
+    return;
+  }
+  has_held_ = false;
+  scheduler_.Cancel(release_task_);
+  Deliver(held_);
+}
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
@@ -0,0 +1,151 @@
+// host.cpp - simulated host side of a manager session
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "vivsim/host.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include "viv/packet.h"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+HostDelegate::HostDelegate(
+    Scheduler &scheduler, Transport transport, Time timeout)
+    : scheduler_(scheduler), transport_(std::move(transport)),
+      timer_(scheduler, timeout, [this]() {
+        if (manager_ != nullptr) {
+          ++timeouts_;
+          scheduler_.Log("timeout");
+          manager_->NotifyTimeout();
+        }
+      }) {}
+
+void
+HostDelegate::Deliver(Time delay, uint8_t const *value, size_t length) {
+  std::array<uint8_t, kVLPacketMaxLength> copy;
+  length = std::min<size_t>(length, copy.size());
+  std::copy(value, value + length, copy.begin());
+  scheduler_.Schedule(
+      delay,
+      [this, copy, length]() {
+        if (manager_ != nullptr) {
+          // Like vivtool, each value received restarts the response timer.
+          if (waiting_) {
+            timer_.Start();
+          }
+          manager_->NotifyValue(copy.data(), length);
+        }
+      },
+      "notify");
+}
+
+int
+HostDelegate::WriteValue(uint8_t const *value, size_t length) {
+  scheduler_.Log("write");
+  return transport_ ? transport_(value, length) : 0;
+}
+
+void
+HostDelegate::DidStartWaiting() const {
+  waiting_ = true;
+  ++waits_;
+  timer_.Start();
+}
+
+void
+HostDelegate::DidFinishWaiting() const {
+  waiting_ = false;
+  timer_.Stop();
+  scheduler_.Log("finish");
+}
+
+void
+HostDelegate::DidError(VLManagerErrorCode code, char const *msg) const {
+  ++errors_;
+  scheduler_.Log("error");
+}
+
+void
+HostDelegate::DidParseClock(time_t posix_time) const {
+  device_time_ = posix_time;
+  parsing_.clear();
+}
+
+void
+HostDelegate::DidParseDirectoryEntry(VLDirectoryEntry entry) const {
+  parsing_.push_back(entry);
+}
+
+void
+HostDelegate::DidFinishParsingDirectory() const {
+  entries_.swap(parsing_);
+  parsing_.clear();
+}
+
+void
+HostDelegate::DidDownloadDirectoryPage(
+    uint16_t first_entry, uint16_t count) const {
+  ++pages_;
+}
+
+void
+HostDelegate::DidProbeDirectory(VLDirectoryProbe probe) const {
+  probe_ = probe;
+}
+
+void
+HostDelegate::DidFingerprintDirectory(
+    uint32_t fingerprint, bool unchanged) const {
+  fingerprint_ = fingerprint;
+  unchanged_ += unchanged;
+}
+
+void
+HostDelegate::DidReadDirectory(uint8_t const *data, size_t length) const {
+  raw_directory_.assign(data, data + length);
+}
+
+void
+HostDelegate::DidDownloadFile(
+    uint16_t index, uint8_t const *data, size_t length) const {
+  files_[index].assign(data, data + length);
+}
+
+void
+HostDelegate::DidEraseFile(uint16_t index, bool ok) const {
+  erased_[index] = ok;
+}
+
+void
+HostDelegate::DidEraseFiles(VLEraseResult const *results, size_t count) const {
+  erase_results_.assign(results, results + count);
+}
+
+void
+HostDelegate::DidSetTime(bool ok) const {
+  if (ok) {
+    ++set_time_count_;
+  }
+}
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
@@ -0,0 +1,157 @@
+// device.hpp - simulated Viiiiva
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivsim_device_hpp
+#define vivsim_device_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+#include "viv/packet.h"
+#include "vivsim/scheduler.hpp"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+/// The device side of the Viiiiva's ANT-FS-over-GATT protocol, in virtual
+/// time.
+///
+/// The device serves a directory of files, and answers download, erase and
+/// set-time commands written to it with Receive.  Its responses are sent to a
+/// link (typically HostDelegate::Deliver) as separate values, paced like GATT
+/// notifications: the first after the device's latency, and the rest one
+/// packet interval apart.
+///
+/// Like the real device, it only serves one command at a time: a new command
+/// abandons any response still being sent.  Commands it cannot serve (e.g.
+/// downloads of files that don't exist) are not answered, so the host times
+/// out.
+class Device {
+public:
+  /// Default delay between receiving a command and sending its first packet.
+  static constexpr Time kDefaultLatency = 20 * kMillisecond;
+
+  /// Default delay between packets of a response (one connection interval).
+  static constexpr Time kDefaultPacketInterval = 15 * kMillisecond;
+
+  /// Receives values sent by the device.
+  using Link = ::std::function<void(uint8_t const *value, size_t length)>;
+
+  explicit Device(
+      Scheduler &scheduler, Time latency = kDefaultLatency,
+      Time packet_interval = kDefaultPacketInterval);
+
+  ~Device();
+
+  // Disallow copy/move semantics.
+  Device(const Device &) = delete;
+  Device &operator=(const Device &) = delete;
+
+  /// Sets where the device's responses are sent.
+  void Attach(Link link) { link_ = ::std::move(link); }
+
+  /// Adds (or replaces) a file in the directory.
+  ///
+  /// \param index Must not be 0, which is the directory itself.
+  /// \param viva_time Creation time, in seconds since 1989-12-31 UTC.
+  void AddFile(
+      uint16_t index, VLFileType file_type, uint32_t viva_time,
+      ::std::vector<uint8_t> contents);
+
+  /// Returns true if the directory has a file with \p index.
+  bool HasFile(uint16_t index) const { return files_.count(index) != 0; }
+
+  /// Sets the device's clock, in seconds since 1989-12-31 UTC.
+  void set_clock(uint32_t viva_time);
+
+  /// Returns the device's clock, which advances with virtual time.
+  uint32_t clock() const;
+
+  /// Returns the directory as the device would send it: a
+  /// VLRawDirectoryHeader followed by a VLRawDirectoryEntry per file.
+  ::std::vector<uint8_t> Directory() const;
+
+  /// Handles a value written by the host.
+  ///
+  /// Malformed packets, acknowledgements and unknown commands are ignored.
+  ///
+  /// \return 0, so that it can be used as a HostDelegate::Transport.
+  int Receive(uint8_t const *value, size_t length);
+
+  /// Number of commands served.
+  int commands() const { return commands_; }
+
+  /// Number of received values that were not commands the device could serve.
+  int ignored() const { return ignored_; }
+
+  /// Number of values sent to the link.
+  int packets_sent() const { return packets_sent_; }
+
+private:
+  struct File {
+    VLFileType file_type;
+    uint32_t viva_time;
+    ::std::vector<uint8_t> contents;
+  };
+
+  void Download(VLPacket const &packet);
+  void Erase(VLPacket const &packet);
+  void SetTime(VLPacket const &packet);
+
+  /// Sends \p data as a burst of download replies, following an ack.
+  void SendBurst(uint8_t const *data, size_t length);
+
+  /// Schedules a packet to be sent after the previously scheduled one.
+  void Send(
+      uint8_t seqno, VLCommandId cmd, uint8_t const *_Nullable payload,
+      size_t payload_length);
+
+  /// Cancels any packets of a previous response that have not been sent.
+  void CancelPending();
+
+  Scheduler &scheduler_;
+  Time const latency_;
+  Time const packet_interval_;
+  Link link_;
+
+  ::std::map<uint16_t, File> files_;
+
+  /// Clock at clock_set_at_, in seconds since 1989-12-31 UTC.
+  uint32_t clock_ = 0;
+  Time clock_set_at_ = 0;
+
+  /// Packets scheduled for the current response.
+  ::std::vector<Scheduler::TaskId> pending_;
+
+  /// Delay from the current command to the next packet scheduled.
+  Time next_delay_ = 0;
+
+  int commands_ = 0;
+  int ignored_ = 0;
+  int packets_sent_ = 0;
+};
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
+
+#endif /* vivsim_device_hpp */
@@ -0,0 +1,154 @@
+// fault_injector.hpp - simulated link faults
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivsim_fault_injector_hpp
+#define vivsim_fault_injector_hpp
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+#include "viv/compat.h"
+#include "viv/packet.h"
+#include "vivsim/scheduler.hpp"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+/// Classes of fault that a FaultInjector can apply to a value.
+enum Fault : int {
+  /// The value is lost.
+  kFaultDrop = 0,
+
+  /// The value is delivered twice.
+  kFaultDuplicate,
+
+  /// The value is held back and delivered after the next one.
+  kFaultReorder,
+
+  /// One bit of the value is flipped, so that VLReadPacket's CRC check
+  /// rejects it.
+  kFaultCorrupt,
+
+  /// The value is cut short.
+  kFaultTruncate,
+
+  /// The value is delivered late (which may also reorder it).
+  kFaultDelay,
+
+  kNumFaults
+};
+
+/// Returns a short name for \p fault, or "none" for kNumFaults.
+char const *FaultName(Fault fault);
+
+/// Per-value probabilities of each fault.
+///
+/// At most one fault is applied to each value; the probabilities are checked
+/// in the order of the Fault enum, so their sum should not exceed 1.
+struct FaultProfile {
+  /// Seed for the injector's random number generator.
+  uint64_t seed = 0;
+
+  double drop = 0;
+  double duplicate = 0;
+  double reorder = 0;
+  double corrupt = 0;
+  double truncate = 0;
+  double delay = 0;
+
+  /// Extra delay for kFaultDelay values, and the longest a kFaultReorder
+  /// value is held waiting for the next value.
+  Time delay_time = 50 * kMillisecond;
+
+  /// Returns a profile that applies \p fault with probability \p p.
+  static FaultProfile Only(Fault fault, double p, uint64_t seed = 0);
+};
+
+/// Applies faults to values passing along a simulated link.
+///
+/// The injector sits between a sender (e.g. a Device) and a receiver (e.g.
+/// HostDelegate::Deliver), and counts the faults it applies, so that their
+/// effect on the session (errors, timeouts, goodput) can be attributed.
+/// Faults are chosen from the injector's own seeded generator, so a profile
+/// reproduces the same faults regardless of other randomness in the
+/// simulation.
+class FaultInjector {
+public:
+  /// Receives values from the injector.
+  using Link = ::std::function<void(uint8_t const *value, size_t length)>;
+
+  FaultInjector(Scheduler &scheduler, FaultProfile const &profile, Link link);
+
+  ~FaultInjector();
+
+  // Disallow copy/move semantics.
+  FaultInjector(const FaultInjector &) = delete;
+  FaultInjector &operator=(const FaultInjector &) = delete;
+
+  /// Passes a value along the link, possibly with a fault applied.
+  void Send(uint8_t const *value, size_t length);
+
+  /// Returns a Link that sends via this injector.
+  Link link() {
+    return [this](uint8_t const *value, size_t length) { Send(value, length); };
+  }
+
+  /// Number of values sent to the injector.
+  int sent() const { return sent_; }
+
+  /// Number of values passed on (including duplicates).
+  int delivered() const { return delivered_; }
+
+  /// Number of times \p fault was applied.
+  int count(Fault fault) const { return counts_[fault]; }
+
+private:
+  struct Value {
+    ::std::array<uint8_t, kVLPacketMaxLength> bytes;
+    size_t length;
+  };
+
+  /// Chooses the fault for the next value, or kNumFaults for none.
+  Fault Choose();
+
+  void Deliver(Value const &value);
+
+  /// Delivers the value held by kFaultReorder, if any.
+  void ReleaseHeld();
+
+  Scheduler &scheduler_;
+  FaultProfile const profile_;
+  Link const link_;
+  ::std::mt19937_64 rng_;
+
+  /// Value held back by kFaultReorder.
+  Value held_;
+  bool has_held_ = false;
+  Scheduler::TaskId release_task_ = 0;
+
+  int sent_ = 0;
+  int delivered_ = 0;
+  ::std::array<int, kNumFaults> counts_ = {};
+};
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
+
+#endif /* vivsim_fault_injector_hpp */
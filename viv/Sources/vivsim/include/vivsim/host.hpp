@@ -0,0 +1,159 @@
+// host.hpp - simulated host side of a manager session
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivsim_host_hpp
+#define vivsim_host_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "viv/compat.h"
+#include "viv/directory_entry.h"
+#include "viv/erase_result.h"
+#include "viv/manager.hpp"
+#include "viv/manager_error_code.h"
+#include "vivsim/scheduler.hpp"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+/// ManagerDelegate that behaves like a host app, in virtual time.
+///
+/// Written values are passed to a transport (e.g. a simulated device).  While
+/// the manager is waiting, a timer runs, restarting with each delivered value;
+/// if it expires, the manager is notified of the timeout, like the host's
+/// response timer.  Results are
+/// collected for inspection.
+class HostDelegate final : public ::viv::ManagerDelegate {
+public:
+  /// Default response timeout, matching vivtool.
+  static constexpr Time kDefaultTimeout = 16 * kSecond;
+
+  /// Receives values written by the manager; returns negative on error.
+  using Transport = ::std::function<int(uint8_t const *value, size_t length)>;
+
+  HostDelegate(
+      Scheduler &scheduler, Transport transport,
+      Time timeout = kDefaultTimeout);
+
+  /// Sets the manager that owns this delegate, for timeouts and deliveries.
+  void Attach(::viv::Manager *_Nullable manager) { manager_ = manager; }
+
+  /// Schedules a value notification to the manager after \p delay.
+  void Deliver(Time delay, uint8_t const *value, size_t length);
+
+  int WriteValue(uint8_t const *value, size_t length) override;
+  void DidStartWaiting() const override;
+  void DidFinishWaiting() const override;
+  void DidError(VLManagerErrorCode code, char const *msg) const override;
+  void DidParseClock(time_t posix_time) const override;
+  void DidParseDirectoryEntry(VLDirectoryEntry entry) const override;
+  void DidFinishParsingDirectory() const override;
+  void DidDownloadDirectoryPage(
+      uint16_t first_entry, uint16_t count) const override;
+  void DidProbeDirectory(VLDirectoryProbe probe) const override;
+  void
+  DidFingerprintDirectory(uint32_t fingerprint, bool unchanged) const override;
+  void DidReadDirectory(uint8_t const *data, size_t length) const override;
+  void DidDownloadFile(
+      uint16_t index, uint8_t const *data, size_t length) const override;
+  void DidEraseFile(uint16_t index, bool ok) const override;
+  void
+  DidEraseFiles(VLEraseResult const *results, size_t count) const override;
+  void DidSetTime(bool ok) const override;
+
+  /// True between DidStartWaiting and DidFinishWaiting.
+  bool waiting() const { return waiting_; }
+
+  /// Number of times the manager started waiting.
+  int waits() const { return waits_; }
+
+  int errors() const { return errors_; }
+  int timeouts() const { return timeouts_; }
+
+  /// Clock from the most recent directory.
+  time_t device_time() const { return device_time_; }
+
+  /// Entries from the most recent directory.
+  ::std::vector<VLDirectoryEntry> const &entries() const { return entries_; }
+
+  /// Number of directory pages downloaded.
+  int pages() const { return pages_; }
+
+  /// Result of the most recent directory probe.
+  VLDirectoryProbe const &probe() const { return probe_; }
+
+  /// Fingerprint of the most recent directory.
+  uint32_t fingerprint() const { return fingerprint_; }
+
+  /// Number of directories reported as unchanged.
+  int unchanged() const { return unchanged_; }
+
+  /// The most recent raw directory.
+  ::std::vector<uint8_t> const &raw_directory() const {
+    return raw_directory_;
+  }
+
+  /// Downloaded files, by index.
+  ::std::map<uint16_t, ::std::vector<uint8_t>> const &files() const {
+    return files_;
+  }
+
+  /// Results of erase commands, by index.
+  ::std::map<uint16_t, bool> const &erased() const { return erased_; }
+
+  /// Results of the most recent erase batch.
+  ::std::vector<VLEraseResult> const &erase_results() const {
+    return erase_results_;
+  }
+
+  int set_time_count() const { return set_time_count_; }
+
+private:
+  Scheduler &scheduler_;
+  Transport const transport_;
+  ::viv::Manager *_Nullable manager_ = nullptr;
+
+  // The ManagerDelegate callbacks are const, so the state they update is
+  // mutable.
+  mutable Timer timer_;
+  mutable bool waiting_ = false;
+  mutable int waits_ = 0;
+  mutable int errors_ = 0;
+  mutable int timeouts_ = 0;
+  mutable time_t device_time_ = 0;
+  mutable ::std::vector<VLDirectoryEntry> entries_;
+  mutable ::std::vector<VLDirectoryEntry> parsing_;
+  mutable int pages_ = 0;
+  mutable VLDirectoryProbe probe_ = {0};
+  mutable uint32_t fingerprint_ = 0;
+  mutable int unchanged_ = 0;
+  mutable ::std::vector<uint8_t> raw_directory_;
+  mutable ::std::map<uint16_t, ::std::vector<uint8_t>> files_;
+  mutable ::std::map<uint16_t, bool> erased_;
+  mutable ::std::vector<VLEraseResult> erase_results_;
+  mutable int set_time_count_ = 0;
+};
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
+
+#endif /* vivsim_host_hpp */
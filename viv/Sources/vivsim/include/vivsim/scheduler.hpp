@@ -0,0 +1,175 @@
+// scheduler.hpp - deterministic virtual-time event scheduler
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivsim_scheduler_hpp
+#define vivsim_scheduler_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "viv/callback.hpp"
+#include "viv/compat.h"
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+/// Virtual time, in microseconds.
+using Time = uint64_t;
+
+constexpr Time kMillisecond = 1000;
+constexpr Time kSecond = 1000 * kMillisecond;
+
+/// Runs tasks in virtual time.
+///
+/// The clock only moves when the next task is run, so simulated hours take as
+/// long as the tasks themselves.  Tasks due at the same time run in the order
+/// they were scheduled, and all randomness in a simulation should come from
+/// \c rng(), so a simulation is reproducible from its seed.
+class Scheduler {
+public:
+  using Task = ::std::function<void()>;
+
+  /// Identifies a scheduled task, for Cancel.
+  using TaskId = uint64_t;
+
+  /// A task that has run (or a note added with Log).
+  struct LogEntry {
+    Time time;
+
+    /// Static string describing the event.
+    char const *label;
+  };
+
+  explicit Scheduler(uint64_t seed = 0) : rng_(seed) {}
+
+  // Disallow copy/move semantics.
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  /// Returns the current virtual time.
+  Time now() const { return now_; }
+
+  /// Returns a clock callback for libviv components (e.g.
+  /// viv::LatencyRecorder), reading this scheduler's virtual time.
+  ::viv::Callback<uint64_t()> clock() {
+    return ::viv::Callback<uint64_t()>::Bind<&Scheduler::now>(*this);
+  }
+
+  /// Schedules \p task to run \p delay after the current time.
+  ///
+  /// \param label Static string recorded in the log when the task runs.
+  TaskId Schedule(Time delay, Task task, char const *label = "task");
+
+  /// Removes a task that has not yet run.
+  ///
+  /// \return False if the task had already run or been cancelled.
+  bool Cancel(TaskId id);
+
+  /// Advances the clock to the next task and runs it.
+  ///
+  /// \return False if there were no tasks.
+  bool Step();
+
+  /// Runs tasks due up to \p deadline, then advances the clock to
+  /// \p deadline.
+  ///
+  /// \return The number of tasks run.
+  size_t RunUntil(Time deadline);
+
+  /// Runs tasks until there are none left, or \p max_tasks have run.
+  ///
+  /// \return The number of tasks run.
+  size_t Run(size_t max_tasks = SIZE_MAX);
+
+  /// Returns the number of tasks waiting to run.
+  size_t pending() const { return tasks_.size(); }
+
+  /// Random number generator for the simulation.
+  ::std::mt19937_64 &rng() { return rng_; }
+
+  /// Enables or disables the event log (disabled by default).
+  void set_logging(bool logging) { logging_ = logging; }
+
+  /// Adds \p label to the log at the current time, if logging is enabled.
+  void Log(char const *label) {
+    if (logging_) {
+      log_.push_back(LogEntry{now_, label});
+    }
+  }
+
+  /// Returns the tasks run (and notes added) while logging was enabled.
+  ::std::vector<LogEntry> const &log() const { return log_; }
+
+private:
+  struct Entry {
+    Task task;
+    char const *label;
+  };
+
+  /// Tasks keyed by due time, then by ID (i.e. order scheduled).
+  ::std::map<::std::pair<Time, TaskId>, Entry> tasks_;
+
+  /// Due times of tasks, by ID.
+  ::std::unordered_map<TaskId, Time> due_;
+
+  Time now_ = 0;
+  TaskId next_id_ = 0;
+  ::std::mt19937_64 rng_;
+  bool logging_ = false;
+  ::std::vector<LogEntry> log_;
+};
+
+/// A restartable one-shot deadline, like a host's response timer.
+class Timer {
+public:
+  /// \param on_fire Called (from a scheduler task) when the timer expires.
+  Timer(Scheduler &scheduler, Time timeout, ::std::function<void()> on_fire)
+      : scheduler_(scheduler), timeout_(timeout),
+        on_fire_(::std::move(on_fire)) {}
+
+  ~Timer() { Stop(); }
+
+  // Disallow copy/move semantics.
+  Timer(const Timer &) = delete;
+  Timer &operator=(const Timer &) = delete;
+
+  /// Arms the timer to fire after its timeout, restarting it if armed.
+  void Start();
+
+  /// Disarms the timer.
+  void Stop();
+
+  bool armed() const { return armed_; }
+
+private:
+  Scheduler &scheduler_;
+  Time const timeout_;
+  ::std::function<void()> const on_fire_;
+  Scheduler::TaskId task_ = 0;
+  bool armed_ = false;
+};
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
+
+#endif /* vivsim_scheduler_hpp */
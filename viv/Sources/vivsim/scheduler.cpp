@@ -0,0 +1,107 @@
+// scheduler.cpp - deterministic virtual-time event scheduler
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "vivsim/scheduler.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#pragma clang assume_nonnull begin
+
+namespace vivsim {
+
+Scheduler::TaskId
+Scheduler::Schedule(Time delay, Task task, char const *label) {
+  TaskId const id = next_id_++;
+  Time const due = now_ + delay;
+  tasks_.emplace(std::make_pair(due, id), Entry{std::move(task), label});
+  due_.emplace(id, due);
+  return id;
+}
+
+bool
+Scheduler::Cancel(TaskId id) {
+  auto const it = due_.find(id);
+  if (it == due_.end()) {
+    return false;
+  }
+  tasks_.erase(std::make_pair(it->second, id));
+  due_.erase(it);
+  return true;
+}
+
+bool
+Scheduler::Step() {
+  if (tasks_.empty()) {
+    return false;
+  }
+  auto it = tasks_.begin();
+  now_ = it->first.first;
+  Entry entry = std::move(it->second);
+  due_.erase(it->first.second);
+  tasks_.erase(it);
+
+  Log(entry.label);
+  entry.task();
+  return true;
+}
+
+size_t
+Scheduler::RunUntil(Time deadline) {
+  size_t n = 0;
+  while (!tasks_.empty() && tasks_.begin()->first.first <= deadline) {
+    Step();
+    ++n;
+  }
+  if (now_ < deadline) {
+    now_ = deadline;
+  }
+  return n;
+}
+
+size_t
+Scheduler::Run(size_t max_tasks) {
+  size_t n = 0;
+  while (n < max_tasks && Step()) {
+    ++n;
+  }
+  return n;
+}
+
+void
+Timer::Start() {
+  Stop();
+  armed_ = true;
+  task_ = scheduler_.Schedule(
+      timeout_,
+      [this]() {
+        armed_ = false;
+        on_fire_();
+      },
+      "timer");
+}
+
+void
+Timer::Stop() {
+  if (armed_) {
+    scheduler_.Cancel(task_);
+    armed_ = false;
+  }
+}
+
+} // namespace vivsim
+
+#pragma clang assume_nonnull end
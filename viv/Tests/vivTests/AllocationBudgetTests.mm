@@ -0,0 +1,447 @@
+// AllocationBudgetTests.mm - heap allocation budgets for viv::Manager
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "viv/manager.hpp"
+#include "viv/manager_c_bridge.h"
+#include "viv/packet.h"
+#include "vivsim/device.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+// Budgets for the heap-backed manager.  Commands themselves live in the
+// manager, so issuing one doesn't allocate; a download reserves its buffer
+// once, when the ack gives its length.
+
+/// Allocations per command issued.
+constexpr size_t kCommandBudget = 0;
+
+/// Allocations per notification, other than a download's ack.
+constexpr size_t kNotificationBudget = 0;
+
+/// Allocations per file download, regardless of the file's length.
+constexpr size_t kFileBudget = 1;
+
+/// Extra allocations when a download's buffer is handed over through the C
+/// bridge: the handle, but not a copy of the contents.
+constexpr size_t kTakeFileBudget = 1;
+
+/// Allocations per directory download, plus kDirectoryEntryBudget per entry.
+/// Entries are read in place from the download buffer.
+constexpr size_t kDirectoryBudget = 1;
+constexpr size_t kDirectoryEntryBudget = 0;
+
+/// Delegate that records its last write without allocating.
+class Delegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override {
+    std::memcpy(written, value, length);
+    written_length = length;
+    return 0;
+  }
+
+  void DidStartWaiting() const override {}
+
+  void DidFinishWaiting() const override { ++finishes; }
+
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
+    ++errors;
+  }
+
+  void DidParseDirectoryEntry(VLDirectoryEntry entry) const override {
+    ++entries;
+  }
+
+  uint8_t written[kVLPacketMaxLength];
+  size_t written_length = 0;
+  mutable int finishes = 0;
+  mutable int errors = 0;
+  mutable int entries = 0;
+};
+
+/// Simulated device whose responses are collected, rather than delivered, so
+/// that the manager's allocations can be told apart from the simulator's.
+struct Device {
+  Device() : device(scheduler) {
+    device.Attach([this](uint8_t const *value, size_t length) {
+      values.emplace_back(value, value + length);
+    });
+    for (uint16_t i = 1; i <= 16; ++i) {
+      device.AddFile(
+          i, kVLFileTypeFitActivity, 0, std::vector<uint8_t>(100 * i * i));
+    }
+  }
+
+  /// Returns the device's responses to \p value, without counting the
+  /// simulator's allocations.
+  std::vector<std::vector<uint8_t>>
+  Respond(
+      vivtest::AllocationTracker &tracker, uint8_t const *value,
+      size_t length) {
+    tracker.set_paused(true);
+    values.clear();
+    device.Receive(value, length);
+    scheduler.Run();
+    auto responses = values;
+    tracker.set_paused(false);
+    return responses;
+  }
+
+  vivsim::Scheduler scheduler;
+  vivsim::Device device;
+  std::vector<std::vector<uint8_t>> values;
+};
+
+/// C bridge delegate callbacks, recording the last write.
+struct CContext {
+  uint8_t written[kVLPacketMaxLength];
+  size_t written_length = 0;
+  int finishes = 0;
+  int directories = 0;
+  int entries = 0;
+  uint16_t last_index = 0;
+  VLOwnedBuffer file = {};
+};
+
+int
+CWriteValue(void *ctx, uint8_t const *value, size_t length) {
+  auto *c = static_cast<CContext *>(ctx);
+  std::memcpy(c->written, value, length);
+  c->written_length = length;
+  return 0;
+}
+
+void
+CDidStartWaiting(void *ctx) {}
+
+void
+CDidFinishWaiting(void *ctx) {
+  ++static_cast<CContext *>(ctx)->finishes;
+}
+
+void
+CDidParseDirectory(void *ctx, VLDirectoryEntry const *entries, size_t count) {
+  auto *c = static_cast<CContext *>(ctx);
+  ++c->directories;
+  c->entries += count;
+  if (count > 0) {
+    c->last_index = entries[count - 1].index;
+  }
+}
+
+void
+CDidTakeFile(void *ctx, uint16_t index, VLOwnedBuffer buffer) {
+  auto *c = static_cast<CContext *>(ctx);
+  c->last_index = index;
+  c->file = buffer;
+}
+
+void
+CDidParseDirectoryEntry(void *ctx, VLDirectoryEntry entry) {
+  auto *c = static_cast<CContext *>(ctx);
+  ++c->entries;
+  c->last_index = entry.index;
+}
+
+} // namespace
+
+@interface AllocationBudgetTests : XCTestCase
+
+@end
+
+@implementation AllocationBudgetTests {
+  Device _device;
+  Delegate *_delegate;
+  std::unique_ptr<viv::Manager> _manager;
+}
+
+- (void)setUp {
+  auto delegate = std::make_unique<Delegate>();
+  _delegate = delegate.get();
+  _manager = std::make_unique<viv::Manager>(std::move(delegate));
+}
+
+- (void)tearDown {
+  _manager.reset();
+}
+
+- (void)testNotifications {
+  vivtest::AllocationTracker tracker;
+  _manager->DownloadFile(16);
+  VLAssertAllocationBudget(tracker, kCommandBudget);
+
+  auto const values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+  XCTAssertGreaterThan(values.size(), 100);
+
+  _manager->NotifyValue(values[0].data(), values[0].size());
+  for (size_t i = 1; i < values.size(); ++i) {
+    tracker.Reset();
+    _manager->NotifyValue(values[i].data(), values[i].size());
+    VLAssertAllocationBudget(tracker, kNotificationBudget);
+  }
+  XCTAssertEqual(_delegate->finishes, 1);
+  XCTAssertEqual(_delegate->errors, 0);
+}
+
+- (void)testNotifyValues {
+  vivtest::AllocationTracker tracker;
+  _manager->DownloadFile(16);
+  auto values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+  size_t const count = values.size();
+
+  // A value after the last one is left for the next command.
+  values.push_back(values.back());
+  std::vector<uint8_t const *> data;
+  std::vector<size_t> lengths;
+  for (auto const &value : values) {
+    data.push_back(value.data());
+    lengths.push_back(value.size());
+  }
+  tracker.Reset();
+  bool settled = false;
+  XCTAssertEqual(
+      _manager->NotifyValues(
+          data.data(), lengths.data(), values.size(), &settled),
+      count);
+  VLAssertAllocationBudget(tracker, kFileBudget);
+  XCTAssertTrue(settled);
+  XCTAssertEqual(_delegate->finishes, 1);
+  XCTAssertEqual(_delegate->errors, 0);
+
+  // Stops at an error.
+  _manager->DownloadFile(16);
+  values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+  values[2][0] ^= 0xff;
+  data.clear();
+  lengths.clear();
+  for (auto const &value : values) {
+    data.push_back(value.data());
+    lengths.push_back(value.size());
+  }
+
+  // A chunk that is processed without finishing the command.
+  XCTAssertEqual(
+      _manager->NotifyValues(data.data(), lengths.data(), 2, &settled), 2);
+  XCTAssertFalse(settled);
+  XCTAssertEqual(
+      _manager->NotifyValues(
+          data.data() + 2, lengths.data() + 2, values.size() - 2, &settled),
+      1);
+  XCTAssertTrue(settled);
+  XCTAssertEqual(_delegate->errors, 1);
+}
+
+- (void)testFiles {
+  vivtest::AllocationTracker tracker;
+  for (uint16_t index = 1; index <= 16; ++index) {
+    _manager->DownloadFile(index);
+    auto const values = _device.Respond(
+        tracker, _delegate->written, _delegate->written_length);
+
+    // Independent of the file's length.
+    tracker.Reset();
+    for (auto const &value : values) {
+      _manager->NotifyValue(value.data(), value.size());
+    }
+    VLAssertAllocationBudget(tracker, kFileBudget);
+  }
+  XCTAssertEqual(_delegate->finishes, 16);
+  XCTAssertEqual(_delegate->errors, 0);
+}
+
+- (void)testDirectory {
+  vivtest::AllocationTracker tracker;
+  _manager->DownloadDirectory();
+  auto const values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+
+  for (auto const &value : values) {
+    _manager->NotifyValue(value.data(), value.size());
+  }
+  XCTAssertEqual(_delegate->entries, 16);
+  VLAssertAllocationBudget(
+      tracker, kDirectoryBudget + 16 * kDirectoryEntryBudget);
+}
+
+- (void)testEraseAndSetTime {
+  vivtest::AllocationTracker tracker;
+  _manager->EraseFile(1);
+  auto values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+  for (auto const &value : values) {
+    _manager->NotifyValue(value.data(), value.size());
+  }
+
+  _manager->SetTime(1600000000);
+  values = _device.Respond(
+      tracker, _delegate->written, _delegate->written_length);
+  for (auto const &value : values) {
+    _manager->NotifyValue(value.data(), value.size());
+  }
+
+  VLAssertAllocationBudget(tracker, 2 * kCommandBudget);
+  XCTAssertEqual(_delegate->finishes, 2);
+}
+
+- (void)testCBridge {
+  CContext ctx;
+  VLManagerDelegate delegate = {0};
+  delegate.write_value = CWriteValue;
+  delegate.did_start_waiting = CDidStartWaiting;
+  delegate.did_finish_waiting = CDidFinishWaiting;
+  VLCProtocolManager mgr = VLMakeManager(&ctx, delegate);
+
+  vivtest::AllocationTracker tracker;
+  VLManagerDownloadFile(mgr, 4);
+  VLAssertAllocationBudget(tracker, kCommandBudget);
+  auto values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  tracker.Reset();
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  VLAssertAllocationBudget(tracker, kFileBudget);
+
+  tracker.Reset();
+  VLManagerEraseFile(mgr, 1);
+  values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  tracker.set_paused(true);
+  std::vector<uint8_t const *> data;
+  std::vector<size_t> lengths;
+  for (auto const &value : values) {
+    data.push_back(value.data());
+    lengths.push_back(value.size());
+  }
+  tracker.set_paused(false);
+  XCTAssertEqual(
+      VLManagerNotifyValues(mgr, data.data(), lengths.data(), values.size()),
+      values.size());
+  VLManagerSetTime(mgr, 1600000000);
+  values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  VLAssertAllocationBudget(tracker, 2 * kCommandBudget);
+
+  XCTAssertEqual(ctx.finishes, 3);
+  VLDeleteManager(mgr);
+}
+
+- (void)testCBridgeTakeFile {
+  CContext ctx;
+  VLManagerDelegate delegate = {0};
+  delegate.write_value = CWriteValue;
+  delegate.did_start_waiting = CDidStartWaiting;
+  delegate.did_finish_waiting = CDidFinishWaiting;
+  delegate.did_take_file = CDidTakeFile;
+  VLCProtocolManager mgr = VLMakeManager(&ctx, delegate);
+
+  vivtest::AllocationTracker tracker;
+  VLManagerDownloadFile(mgr, 16);
+  auto const values =
+      _device.Respond(tracker, ctx.written, ctx.written_length);
+  tracker.Reset();
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  VLAssertAllocationBudget(tracker, kFileBudget + kTakeFileBudget);
+  XCTAssertEqual(ctx.finishes, 1);
+  XCTAssertEqual(ctx.last_index, 16);
+  XCTAssertEqual(ctx.file.length, 100 * 16 * 16);
+  XCTAssertNotEqual(ctx.file.data, nullptr);
+
+  // The buffer outlives the manager, until it's released.
+  VLDeleteManager(mgr);
+  XCTAssertEqual(ctx.file.data[ctx.file.length - 1], 0);
+  ctx.file.release(ctx.file.owner);
+}
+
+- (void)testCBridgeDirectory {
+  CContext ctx;
+  VLManagerDelegate delegate = {0};
+  delegate.write_value = CWriteValue;
+  delegate.did_start_waiting = CDidStartWaiting;
+  delegate.did_finish_waiting = CDidFinishWaiting;
+  delegate.did_parse_directory_entry = CDidParseDirectoryEntry;
+  delegate.did_parse_directory = CDidParseDirectory;
+  VLCProtocolManager mgr = VLMakeManager(&ctx, delegate);
+
+  // The whole directory arrives in one call, decoded in the download buffer.
+  vivtest::AllocationTracker tracker;
+  VLManagerDownloadDirectory(mgr);
+  auto values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  VLAssertAllocationBudget(
+      tracker, kDirectoryBudget + 16 * kDirectoryEntryBudget);
+  XCTAssertEqual(ctx.directories, 1);
+  XCTAssertEqual(ctx.entries, 16);
+  XCTAssertEqual(ctx.last_index, 16);
+  VLDeleteManager(mgr);
+
+  // Without the bulk callback, entries are delivered one at a time.
+  ctx = CContext();
+  delegate.did_parse_directory = nullptr;
+  mgr = VLMakeManager(&ctx, delegate);
+  VLManagerDownloadDirectory(mgr);
+  values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  XCTAssertEqual(ctx.directories, 0);
+  XCTAssertEqual(ctx.entries, 16);
+  XCTAssertEqual(ctx.last_index, 16);
+  VLDeleteManager(mgr);
+}
+
+- (void)testCBridgeQueryDirectory {
+  CContext ctx;
+  VLManagerDelegate delegate = {0};
+  delegate.write_value = CWriteValue;
+  delegate.did_start_waiting = CDidStartWaiting;
+  delegate.did_finish_waiting = CDidFinishWaiting;
+  delegate.did_parse_directory = CDidParseDirectory;
+  VLCProtocolManager mgr = VLMakeManager(&ctx, delegate);
+
+  // The largest files come last in the directory, so selecting them in
+  // place reorders it.
+  VLDirectoryQuery query = {};
+  query.order = kVLDirectoryOrderLargest;
+  query.limit = 3;
+  vivtest::AllocationTracker tracker;
+  VLManagerQueryDirectory(mgr, query);
+  auto const values = _device.Respond(tracker, ctx.written, ctx.written_length);
+  for (auto const &value : values) {
+    VLManagerNotifyValue(mgr, value.data(), value.size());
+  }
+  VLAssertAllocationBudget(tracker, kDirectoryBudget);
+  XCTAssertEqual(ctx.directories, 1);
+  XCTAssertEqual(ctx.entries, 3);
+  XCTAssertEqual(ctx.last_index, 14);
+  VLDeleteManager(mgr);
+}
+
+@end
@@ -0,0 +1,125 @@
+// AllocationTracker.cpp - counts heap allocations in tests
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "AllocationTracker.hpp"
+
+#include <execinfo.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+
+/// The tracker that is tracking on this thread, if any.
+thread_local vivtest::AllocationTracker *tCurrent = nullptr;
+
+/// Set while the tracker itself is running, so that its own allocations (e.g.
+/// from backtrace or Report) aren't counted.
+thread_local bool tBusy = false;
+
+/// Sets tBusy for its lifetime.
+class Busy {
+public:
+  Busy() : was_busy_(tBusy) { tBusy = true; }
+  ~Busy() { tBusy = was_busy_; }
+
+private:
+  bool const was_busy_;
+};
+
+} // namespace
+
+namespace vivtest {
+
+AllocationTracker::AllocationTracker() {
+  assert(tCurrent == nullptr);
+  tCurrent = this;
+}
+
+AllocationTracker::~AllocationTracker() { tCurrent = nullptr; }
+
+void
+AllocationTracker::Reset() {
+  count_ = 0;
+  bytes_ = 0;
+  recorded_ = 0;
+}
+
+void
+AllocationTracker::DidAllocate(size_t size) {
+  AllocationTracker *const tracker = tCurrent;
+  if (tracker == nullptr || tracker->paused_ || tBusy) {
+    return;
+  }
+  Busy busy;
+  ++tracker->count_;
+  tracker->bytes_ += size;
+  if (tracker->recorded_ < kMaxRecorded) {
+    Site &site = tracker->sites_[tracker->recorded_++];
+    site.size = size;
+    site.depth = backtrace(site.frames, kMaxFrames);
+  }
+}
+
+std::string
+AllocationTracker::Report() const {
+  Busy busy;
+  char line[64];
+  std::snprintf(
+      line, sizeof(line), "%zu allocations (%zu bytes)\n", count_, bytes_);
+  std::string report = line;
+  for (int i = 0; i < recorded_; ++i) {
+    Site const &site = sites_[i];
+    std::snprintf(
+        line, sizeof(line), "allocation %d (%zu bytes):\n", i, site.size);
+    report += line;
+    char **const symbols = backtrace_symbols(site.frames, site.depth);
+    if (symbols == nullptr) {
+      continue;
+    }
+    // Skip DidAllocate and operator new.
+    for (int frame = 2; frame < site.depth; ++frame) {
+      report += "  ";
+      report += symbols[frame];
+      report += "\n";
+    }
+    std::free(symbols);
+  }
+  if (static_cast<size_t>(recorded_) < count_) {
+    report += "...\n";
+  }
+  return report;
+}
+
+} // namespace vivtest
+
+void *
+operator new(std::size_t size) {
+  vivtest::AllocationTracker::DidAllocate(size);
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    std::abort();
+  }
+  return p;
+}
+
+void
+operator delete(void *p) noexcept {
+  std::free(p);
+}
@@ -0,0 +1,95 @@
+// AllocationTracker.hpp - counts heap allocations in tests
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivTests_AllocationTracker_hpp
+#define vivTests_AllocationTracker_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace vivtest {
+
+/// Counts calls to operator new on this thread while it is tracking.
+///
+/// The test target replaces the global operator new (see
+/// AllocationTracker.cpp), so allocations from libviv and the C++ standard
+/// library are seen; malloc calls (e.g. from Objective-C) are not.  The call
+/// stacks of the first few allocations are recorded, so that a failed budget
+/// can say where the allocations came from.
+///
+/// Only one tracker may be tracking on a thread at a time.
+class AllocationTracker {
+public:
+  /// Maximum number of allocations whose call stacks are recorded.
+  static constexpr int kMaxRecorded = 8;
+
+  /// Maximum number of frames recorded per call stack.
+  static constexpr int kMaxFrames = 16;
+
+  /// Starts tracking.
+  AllocationTracker();
+
+  /// Stops tracking.
+  ~AllocationTracker();
+
+  // Disallow copy/move semantics.
+  AllocationTracker(const AllocationTracker &) = delete;
+  AllocationTracker &operator=(const AllocationTracker &) = delete;
+
+  /// Pauses or resumes tracking, e.g. around simulator code.
+  void set_paused(bool paused) { paused_ = paused; }
+
+  /// Forgets the allocations counted so far.
+  void Reset();
+
+  /// Number of allocations since the tracker was created or reset.
+  size_t count() const { return count_; }
+
+  /// Number of bytes requested by those allocations.
+  size_t bytes() const { return bytes_; }
+
+  /// Describes the recorded allocations and their call stacks.
+  ///
+  /// This allocates, but not while tracking.
+  ::std::string Report() const;
+
+  /// Called by operator new.
+  static void DidAllocate(size_t size);
+
+private:
+  struct Site {
+    size_t size;
+    int depth;
+    void *frames[kMaxFrames];
+  };
+
+  bool paused_ = false;
+  size_t count_ = 0;
+  size_t bytes_ = 0;
+  int recorded_ = 0;
+  Site sites_[kMaxRecorded];
+};
+
+} // namespace vivtest
+
+/// Fails the test if \p tracker has counted more than \p budget allocations,
+/// listing their call sites.
+#define VLAssertAllocationBudget(tracker, budget)                              \
+  XCTAssertLessThanOrEqual(                                                    \
+      (tracker).count(), static_cast<size_t>(budget), @"%s",                   \
+      (tracker).Report().c_str())
+
+#endif /* vivTests_AllocationTracker_hpp */
@@ -0,0 +1,286 @@
+// CaptureTests.mm - unit tests for viv/capture.hpp and viv/replayer.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "viv/capture.hpp"
+#include "viv/crc.hpp"
+#include "viv/directory_query.h"
+#include "viv/manager.hpp"
+#include "viv/replayer.hpp"
+#include "vivsim/device.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+/// Delegate that records written values and downloaded files.
+class RecordingDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override {
+    writes.emplace_back(value, value + length);
+    return 0;
+  }
+
+  void DidStartWaiting() const override {}
+
+  void DidFinishWaiting() const override { ++finishes; }
+
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
+    ++errors;
+  }
+
+  void DidDownloadFile(
+      uint16_t index, uint8_t const *data, size_t length) const override {
+    file.assign(data, data + length);
+  }
+
+  std::vector<std::vector<uint8_t>> writes;
+  mutable int finishes = 0;
+  mutable int errors = 0;
+  mutable std::vector<uint8_t> file;
+};
+
+/// Sink that appends to a vector.
+struct VectorSink {
+  int operator()(uint8_t const *data, size_t length) {
+    bytes.insert(bytes.end(), data, data + length);
+    return 0;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+/// Clock that only advances when told to.
+struct FakeClock {
+  uint64_t operator()() const { return now; }
+
+  uint64_t now = 0;
+};
+
+/// Sums the delays requested by a Replayer.
+struct DelaySum {
+  void operator()(uint64_t delay) { total += delay; }
+
+  uint64_t total = 0;
+};
+
+std::vector<uint8_t> const kAck = {
+    0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0};
+std::vector<uint8_t> const kReply0 = {
+    0x1a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+std::vector<uint8_t> const kReply1 = {
+    0xe7, 14, 1,  3,  0x0b, 0x03, 15, 16, 17, 18,
+    19,   20, 21, 22, 23,   24,   25, 26, 27, 28};
+
+/// Returns kAck for a download resumed from \p offset.
+std::vector<uint8_t>
+MakeResumedAck(uint32_t offset) {
+  std::vector<uint8_t> ack = kAck;
+  ack[8] = offset & 0xff;
+  ack[12] -= offset;
+  ack[0] = (ack[0] & 0xe0) | (0x1f & viv::crc(&ack[1], ack.size() - 1));
+  return ack;
+}
+
+} // namespace
+
+@interface CaptureTests : XCTestCase
+
+@end
+
+@implementation CaptureTests
+
+- (void)testRoundTrip {
+  VectorSink sink;
+  FakeClock clock;
+  viv::CaptureWriter writer{
+      viv::CaptureWriter::Sink(sink), viv::CaptureWriter::Clock(clock)};
+
+  uint8_t const value[] = {1, 2, 3};
+  clock.now = 5;
+  writer.Record(viv::kCaptureNotifyValue, value, sizeof(value));
+  clock.now = 300;
+  writer.Record(viv::kCaptureTimeout, nullptr, 0);
+  XCTAssertTrue(writer.ok());
+
+  // Header, then a 1-byte and a 2-byte varint.
+  XCTAssertEqual(sink.bytes.size(), 8 + (1 + 1 + 3) + (1 + 2));
+
+  viv::CaptureReader reader(sink.bytes.data(), sink.bytes.size());
+  viv::CaptureEvent event;
+  XCTAssertEqual(reader.Next(event), 1);
+  XCTAssertEqual(event.type, viv::kCaptureNotifyValue);
+  XCTAssertEqual(event.time, 5);
+  XCTAssertEqual(event.length, 3);
+  XCTAssertEqual(event.value[2], 3);
+  XCTAssertEqual(reader.Next(event), 1);
+  XCTAssertEqual(event.type, viv::kCaptureTimeout);
+  XCTAssertEqual(event.time, 300);
+  XCTAssertEqual(event.length, 0);
+  XCTAssertEqual(reader.Next(event), 0);
+}
+
+- (void)testMalformed {
+  uint8_t const badHeader[] = {'V', 'I', 'V', 'X', 'A', 'P', 1, 0};
+  viv::CaptureEvent event;
+  XCTAssertLessThan(
+      viv::CaptureReader(badHeader, sizeof(badHeader)).Next(event), 0);
+
+  // Record claims 3 bytes but has 1.
+  uint8_t const truncated[] = {'V', 'I', 'V', 'C', 'A', 'P', 2, 0, 3 << 2, 0,
+                               1};
+  XCTAssertLessThan(
+      viv::CaptureReader(truncated, sizeof(truncated)).Next(event), 0);
+}
+
+- (void)testReplay {
+  VectorSink sink;
+  FakeClock clock;
+  viv::CaptureWriter writer{
+      viv::CaptureWriter::Sink(sink), viv::CaptureWriter::Clock(clock)};
+  auto capturedDelegate = std::make_unique<RecordingDelegate>();
+  auto *captured = capturedDelegate.get();
+  viv::Manager capturedManager(std::move(capturedDelegate));
+  capturedManager.SetCaptureWriter(&writer);
+
+  clock.now = 1000;
+  capturedManager.DownloadFile(0x1234);
+  clock.now = 1200;
+  capturedManager.NotifyValue(kAck.data(), kAck.size());
+  clock.now = 1300;
+  capturedManager.NotifyValue(kReply0.data(), kReply0.size());
+  clock.now = 1450;
+  capturedManager.NotifyValue(kReply1.data(), kReply1.size());
+  XCTAssertEqual(captured->file.size(), 28);
+
+  auto delegate = std::make_unique<RecordingDelegate>();
+  auto *d = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  DelaySum delays;
+  viv::Replayer replayer(
+      manager, sink.bytes.data(), sink.bytes.size(),
+      viv::Replayer::Wait(delays));
+
+  // One call, its command write and three notifications.
+  XCTAssertEqual(replayer.Run(), 5);
+  XCTAssertEqual(delays.total, 450);
+  XCTAssertEqual(d->errors, 0);
+  XCTAssertEqual(d->finishes, 1);
+  XCTAssertTrue(d->writes == captured->writes);
+  XCTAssertTrue(d->file == captured->file);
+}
+
+- (void)testReplayResumedDownload {
+  VectorSink sink;
+  FakeClock clock;
+  viv::CaptureWriter writer{
+      viv::CaptureWriter::Sink(sink), viv::CaptureWriter::Clock(clock)};
+  auto capturedDelegate = std::make_unique<RecordingDelegate>();
+  auto *captured = capturedDelegate.get();
+  viv::Manager capturedManager(std::move(capturedDelegate));
+  capturedManager.SetCaptureWriter(&writer);
+
+  auto const ack = MakeResumedAck(14);
+  capturedManager.DownloadFile(0x1234, 14);
+  capturedManager.NotifyValue(ack.data(), ack.size());
+  capturedManager.NotifyValue(kReply1.data(), kReply1.size());
+  XCTAssertEqual(captured->errors, 0);
+  XCTAssertEqual(captured->file.size(), 14);
+
+  auto delegate = std::make_unique<RecordingDelegate>();
+  auto *d = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  DelaySum delays;
+  viv::Replayer replayer(
+      manager, sink.bytes.data(), sink.bytes.size(),
+      viv::Replayer::Wait(delays));
+
+  // The replayed command asks for the same offset, so the ack still matches.
+  XCTAssertEqual(replayer.Run(), 4);
+  XCTAssertEqual(d->errors, 0);
+  XCTAssertEqual(d->finishes, 1);
+  XCTAssertTrue(d->writes == captured->writes);
+  XCTAssertTrue(d->file == captured->file);
+}
+
+- (void)testReplaySimulatedSession {
+  VectorSink sink;
+  vivsim::Scheduler scheduler;
+  viv::CaptureWriter writer{viv::CaptureWriter::Sink(sink), scheduler.clock()};
+  vivsim::Device device(scheduler);
+  auto capturedDelegate = std::make_unique<vivsim::HostDelegate>(
+      scheduler, [&device](uint8_t const *value, size_t length) {
+        return device.Receive(value, length);
+      });
+  auto *captured = capturedDelegate.get();
+  viv::Manager capturedManager(std::move(capturedDelegate));
+  captured->Attach(&capturedManager);
+  device.Attach([captured](uint8_t const *value, size_t length) {
+    captured->Deliver(0, value, length);
+  });
+  std::vector<uint16_t> indices;
+  for (uint16_t i = 1; i <= 40; ++i) {
+    device.AddFile(
+        i, kVLFileTypeFitActivity, 1000 + i, std::vector<uint8_t>(10));
+    indices.push_back(i);
+  }
+
+  // Calls whose command packets look like other calls' packets.
+  capturedManager.SetCaptureWriter(&writer);
+  capturedManager.DownloadDirectoryPage(0, 2);
+  scheduler.Run();
+  capturedManager.DownloadDirectory();
+  scheduler.Run();
+  capturedManager.DownloadDirectoryIfChanged(captured->fingerprint());
+  scheduler.Run();
+  VLDirectoryQuery query = {};
+  query.order = kVLDirectoryOrderNewest;
+  query.limit = 3;
+  capturedManager.QueryDirectory(query);
+  scheduler.Run();
+  // More files than fit in one capture record.
+  capturedManager.EraseFiles(indices.data(), indices.size());
+  scheduler.Run();
+  XCTAssertEqual(captured->errors(), 0);
+  XCTAssertEqual(captured->pages(), 1);
+  XCTAssertEqual(captured->unchanged(), 1);
+  XCTAssertEqual(captured->erase_results().size(), indices.size());
+
+  vivsim::Scheduler replayScheduler;
+  auto delegate = std::make_unique<vivsim::HostDelegate>(
+      replayScheduler, [](uint8_t const *value, size_t length) { return 0; });
+  auto *host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+  viv::Replayer replayer(manager, sink.bytes.data(), sink.bytes.size());
+  XCTAssertGreaterThan(replayer.Run(), 0);
+
+  XCTAssertEqual(host->errors(), 0);
+  XCTAssertEqual(host->waits(), captured->waits());
+  XCTAssertEqual(host->pages(), 1);
+  XCTAssertEqual(host->unchanged(), 1);
+  XCTAssertEqual(host->fingerprint(), captured->fingerprint());
+  XCTAssertEqual(host->entries().size(), captured->entries().size());
+  XCTAssertEqual(host->erased().size(), indices.size());
+  XCTAssertEqual(
+      host->erase_results().size(), captured->erase_results().size());
+}
+
+@end
@@ -0,0 +1,131 @@
+// ClockDisciplineTests.mm - unit tests for viv/clock_discipline.h
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cmath>
+#include <ctime>
+
+#include "viv/clock_discipline.h"
+
+namespace {
+
+/// Arbitrary host time, in seconds since 1970-01-01.
+constexpr double kEpoch = 1600000000;
+
+constexpr double kDay = 24 * 60 * 60;
+
+} // namespace
+
+@interface ClockDisciplineTests : XCTestCase
+
+@end
+
+@implementation ClockDisciplineTests
+
+- (void)testMeasureOffset {
+  // Sampled at 1000.0 host time, truncated from 1000.5 on average.
+  XCTAssertEqualWithAccuracy(VLClockMeasureOffset(1000, 999.9, 0.2), 0.5, 1e-9);
+  XCTAssertEqualWithAccuracy(
+      VLClockMeasureOffset(995, 999.9, 0.2), -4.5, 1e-9);
+}
+
+- (void)testCompensatedTime {
+  XCTAssertEqual(VLClockCompensatedTime(1000.2, 0.8), 1001);
+  XCTAssertEqual(VLClockCompensatedTime(1000.2, 0.2), 1000);
+}
+
+- (void)testShouldSet {
+  VLClockOptions const options = VLClockDefaultOptions();
+  VLClockState state = {0};
+
+  // Nothing is known.
+  XCTAssertTrue(VLClockShouldSet(&state, &options, kEpoch, NAN));
+
+  XCTAssertFalse(VLClockShouldSet(&state, &options, kEpoch, 1.5));
+  XCTAssertTrue(VLClockShouldSet(&state, &options, kEpoch, 2.5));
+  XCTAssertTrue(VLClockShouldSet(&state, &options, kEpoch, -2.5));
+}
+
+- (void)testObserve {
+  VLClockOptions const options = VLClockDefaultOptions();
+  VLClockState state = {0};
+
+  // Ignored until the clock has been set.
+  VLClockObserve(&state, &options, kEpoch, 10);
+  XCTAssertEqual(state.samples, 0);
+
+  VLClockDidSet(&state, kEpoch);
+  VLClockObserve(&state, &options, kEpoch + 60, 1);
+  XCTAssertEqual(state.samples, 0);
+
+  VLClockObserve(&state, &options, kEpoch + kDay, 8.64);
+  XCTAssertEqual(state.samples, 1);
+  XCTAssertEqualWithAccuracy(state.drift, 1e-4, 1e-12);
+
+  VLClockObserve(&state, &options, kEpoch + kDay, 0);
+  XCTAssertEqual(state.samples, 2);
+  XCTAssertEqualWithAccuracy(state.drift, 0.75e-4, 1e-12);
+}
+
+- (void)testPredict {
+  VLClockOptions const options = VLClockDefaultOptions();
+  VLClockState state = {0};
+  XCTAssertEqual(VLClockPredictOffset(&state, kEpoch), 0);
+
+  VLClockDidSet(&state, kEpoch);
+  state.drift = 1e-4;
+  state.samples = 1;
+  XCTAssertEqualWithAccuracy(
+      VLClockPredictOffset(&state, kEpoch + 10000), 1.0, 1e-9);
+  XCTAssertFalse(VLClockShouldSet(&state, &options, kEpoch + 10000, NAN));
+  XCTAssertTrue(VLClockShouldSet(&state, &options, kEpoch + 30000, NAN));
+}
+
+- (void)testSkipsSyncs {
+  // A Viiiiva gaining 20 ppm (1.7 s per day), synced daily.
+  constexpr double kDrift = 20e-6;
+  constexpr double kRtt = 0.3;
+  VLClockOptions const options = VLClockDefaultOptions();
+  VLClockState state = {0};
+
+  double device_offset = 30; // Initially wrong.
+  int sets = 0;
+  for (int day = 0; day < 30; ++day) {
+    double const sent = kEpoch + day * kDay;
+    double const sampled = sent + kRtt / 2;
+    auto const device_time =
+        static_cast<time_t>(std::floor(sampled + device_offset));
+    double const offset = VLClockMeasureOffset(device_time, sent, kRtt);
+    XCTAssertEqualWithAccuracy(offset, device_offset, 0.5);
+
+    VLClockObserve(&state, &options, sent, offset);
+    if (VLClockShouldSet(&state, &options, sent, offset)) {
+      ++sets;
+      time_t const set = VLClockCompensatedTime(sent, kRtt);
+      device_offset = set - (sent + kRtt / 2);
+      XCTAssertLessThanOrEqual(std::fabs(device_offset), 0.5);
+      VLClockDidSet(&state, sent);
+    }
+    device_offset += kDrift * kDay;
+  }
+
+  // Only about every other sync sets the clock.
+  XCTAssertGreaterThan(sets, 10);
+  XCTAssertLessThan(sets, 20);
+  XCTAssertEqualWithAccuracy(state.drift, kDrift, 10e-6);
+}
+
+@end
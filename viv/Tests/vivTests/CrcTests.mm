@@ -30,4 +30,10 @@
   XCTAssertEqual(viv::crc(ref, 9), static_cast<uint8_t>(0xf4));
 }
 
+- (void)testCrc32 {
+  uint8_t const ref[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  XCTAssertEqual(viv::crc32(ref, 9), 0xcbf43926);
+  XCTAssertEqual(viv::crc32(ref, 0), 0);
+}
+
 @end
@@ -0,0 +1,363 @@
+// DeviceTests.mm - unit tests for vivsim/device.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "viv/directory_query.h"
+#include "viv/endian.hpp"
+#include "viv/manager.hpp"
+#include "viv/packet.h"
+#include "viv/vivtime.h"
+#include "vivsim/device.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+/// A manager connected to a simulated device.
+struct Session {
+  Session() : device(scheduler) {
+    auto delegate = std::make_unique<vivsim::HostDelegate>(
+        scheduler, [this](uint8_t const *value, size_t length) {
+          return device.Receive(value, length);
+        });
+    host = delegate.get();
+    manager = std::make_unique<viv::Manager>(std::move(delegate));
+    host->Attach(manager.get());
+    device.Attach([this](uint8_t const *value, size_t length) {
+      host->Deliver(0, value, length);
+    });
+  }
+
+  vivsim::Scheduler scheduler;
+  vivsim::Device device;
+  vivsim::HostDelegate *host;
+  std::unique_ptr<viv::Manager> manager;
+};
+
+std::vector<uint8_t>
+MakeContents(size_t length) {
+  std::vector<uint8_t> contents(length);
+  for (size_t i = 0; i < length; ++i) {
+    contents[i] = static_cast<uint8_t>(i);
+  }
+  return contents;
+}
+
+} // namespace
+
+@interface DeviceTests : XCTestCase
+
+@end
+
+@implementation DeviceTests
+
+- (void)testDirectory {
+  Session s;
+  s.device.set_clock(1000);
+  s.device.AddFile(2, kVLFileTypeFitActivity, 500, MakeContents(100));
+  s.device.AddFile(3, kVLFileTypeFitActivity, 600, MakeContents(3000));
+
+  s.manager->DownloadDirectory();
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->device_time(), VLGetPosixTimeFromViva(1000));
+  XCTAssertEqual(s.host->entries().size(), 2);
+  XCTAssertEqual(s.host->entries()[1].index, 3);
+  XCTAssertEqual(s.host->entries()[1].length, 3000);
+  XCTAssertEqual(s.host->entries()[1].file_type, kVLFileTypeFitActivity);
+  XCTAssertEqual(
+      s.host->entries()[1].posix_time, VLGetPosixTimeFromViva(600));
+}
+
+- (void)testProbeDirectory {
+  Session s;
+  s.device.set_clock(1000);
+  for (uint16_t i = 2; i <= 40; ++i) {
+    s.device.AddFile(i, kVLFileTypeFitActivity, 500, MakeContents(100));
+  }
+
+  s.manager->ProbeDirectory(2, 39);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->probe().posix_time, VLGetPosixTimeFromViva(1000));
+  XCTAssertEqual(s.host->probe().entry_count, 2);
+  XCTAssertEqual(s.host->probe().grown, 0);
+  XCTAssertTrue(s.host->entries().empty());
+  // An ack and 48 bytes of replies, then an empty ack for the entry after the
+  // known ones, rather than the whole directory.
+  XCTAssertEqual(s.device.packets_sent(), 6);
+  XCTAssertEqual(s.host->waits(), 1);
+  XCTAssertFalse(s.host->waiting());
+  uint32_t const fingerprint = s.host->probe().fingerprint;
+
+  // The clock moves, but the fingerprint doesn't.
+  s.scheduler.RunUntil(s.scheduler.now() + 10 * vivsim::kSecond);
+  s.manager->ProbeDirectory(2, 39);
+  s.scheduler.Run();
+  XCTAssertGreaterThan(
+      s.host->probe().posix_time, VLGetPosixTimeFromViva(1000));
+  XCTAssertEqual(s.host->probe().fingerprint, fingerprint);
+  XCTAssertEqual(s.host->probe().grown, 0);
+
+  // A new file at the end of the directory is past the entries read, but
+  // the probe still sees that the directory has grown.
+  s.device.AddFile(41, kVLFileTypeFitActivity, 500, MakeContents(100));
+  s.manager->ProbeDirectory(2, 39);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->probe().fingerprint, fingerprint);
+  XCTAssertEqual(s.host->probe().grown, 1);
+  XCTAssertEqual(s.host->waits(), 3);
+  XCTAssertFalse(s.host->waiting());
+
+  // A new file at the start of the directory changes it.
+  s.device.AddFile(1, kVLFileTypeFitActivity, 500, MakeContents(100));
+  s.manager->ProbeDirectory(2, 40);
+  s.scheduler.Run();
+  XCTAssertNotEqual(s.host->probe().fingerprint, fingerprint);
+  XCTAssertEqual(s.host->probe().grown, 1);
+
+  // Known entries within those read don't need a second download.
+  int const packets = s.device.packets_sent();
+  s.manager->ProbeDirectory(2, 1);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->probe().grown, 1);
+  XCTAssertEqual(s.device.packets_sent() - packets, 5);
+
+  // Only the header, for the clock.
+  s.manager->ProbeDirectory(0, 41);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->probe().entry_count, 0);
+  XCTAssertEqual(s.host->probe().grown, 0);
+}
+
+- (void)testDirectoryPages {
+  Session s;
+  s.device.set_clock(1000);
+  for (uint16_t i = 1; i <= 10; ++i) {
+    s.device.AddFile(i, kVLFileTypeFitActivity, 500, MakeContents(10 * i));
+  }
+
+  // The first page arrives before the rest of the directory.
+  s.manager->DownloadDirectoryPage(0, 4);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->device_time(), VLGetPosixTimeFromViva(1000));
+  XCTAssertTrue(s.host->entries().empty());
+
+  // Other commands can go between pages.
+  s.manager->DownloadFile(2);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->files().at(2).size(), 20);
+
+  s.manager->DownloadDirectoryPage(4, 4);
+  s.scheduler.Run();
+  XCTAssertTrue(s.host->entries().empty());
+  s.manager->DownloadDirectoryPage(8, 4);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->pages(), 3);
+  XCTAssertEqual(s.host->entries().size(), 10);
+  for (uint16_t i = 0; i < 10; ++i) {
+    XCTAssertEqual(s.host->entries()[i].index, i + 1);
+    XCTAssertEqual(s.host->entries()[i].length, 10 * (i + 1));
+  }
+}
+
+- (void)testDirectoryPagesExact {
+  Session s;
+  for (uint16_t i = 1; i <= 8; ++i) {
+    s.device.AddFile(i, kVLFileTypeFitActivity, 500, MakeContents(10));
+  }
+
+  for (uint16_t first = 0; first <= 8; first += 4) {
+    s.manager->DownloadDirectoryPage(first, 4);
+    s.scheduler.Run();
+  }
+
+  // The last page is empty, and finishes with its ack.
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->timeouts(), 0);
+  XCTAssertEqual(s.host->pages(), 3);
+  XCTAssertEqual(s.host->entries().size(), 8);
+}
+
+- (void)testDownloadDirectoryIfChanged {
+  Session s;
+  s.device.set_clock(1000);
+  for (uint16_t i = 1; i <= 5; ++i) {
+    s.device.AddFile(i, kVLFileTypeFitActivity, 500, MakeContents(100));
+  }
+  s.manager->DownloadDirectory();
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->entries().size(), 5);
+  XCTAssertEqual(s.host->unchanged(), 0);
+  uint32_t const fingerprint = s.host->fingerprint();
+
+  // Only the clock has moved, so the entries aren't reported again.
+  s.scheduler.RunUntil(s.scheduler.now() + 10 * vivsim::kSecond);
+  s.manager->DownloadDirectoryIfChanged(fingerprint);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->unchanged(), 1);
+  XCTAssertEqual(s.host->fingerprint(), fingerprint);
+  XCTAssertGreaterThan(s.host->device_time(), VLGetPosixTimeFromViva(1000));
+
+  // A new file is reported.
+  s.device.AddFile(6, kVLFileTypeFitActivity, 600, MakeContents(100));
+  s.manager->DownloadDirectoryIfChanged(fingerprint);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->unchanged(), 1);
+  XCTAssertNotEqual(s.host->fingerprint(), fingerprint);
+  XCTAssertEqual(s.host->entries().size(), 6);
+}
+
+- (void)testQueryDirectory {
+  Session s;
+  s.device.set_clock(1000);
+  s.device.AddFile(1, kVLFileTypeFitDevice, 900, MakeContents(10));
+  for (uint16_t i = 2; i <= 20; ++i) {
+    s.device.AddFile(
+        i, kVLFileTypeFitActivity, 100 * (i % 7), MakeContents(10));
+  }
+
+  VLDirectoryQuery query = {};
+  query.file_type = kVLFileTypeFitActivity;
+  query.order = kVLDirectoryOrderNewest;
+  query.limit = 3;
+  s.manager->QueryDirectory(query);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->entries().size(), 3);
+  std::vector<uint16_t> indices;
+  for (auto const &entry : s.host->entries()) {
+    indices.push_back(entry.index);
+  }
+  XCTAssertTrue(indices == std::vector<uint16_t>({6, 13, 20}));
+}
+
+- (void)testDownloadFile {
+  Session s;
+  auto const contents = MakeContents(100);
+  s.device.AddFile(2, kVLFileTypeFitActivity, 0, contents);
+
+  s.manager->DownloadFile(2);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertTrue(s.host->files().at(2) == contents);
+  // An ack and 8 replies.
+  XCTAssertEqual(s.device.packets_sent(), 9);
+  XCTAssertEqual(s.device.commands(), 1);
+  XCTAssertEqual(
+      s.scheduler.now(), vivsim::Device::kDefaultLatency +
+                             8 * vivsim::Device::kDefaultPacketInterval);
+}
+
+- (void)testLargeFile {
+  Session s;
+  auto const contents = MakeContents(100000);
+  s.device.AddFile(2, kVLFileTypeFitActivity, 0, contents);
+
+  s.manager->DownloadFile(2);
+  s.scheduler.Run();
+
+  // The transfer outlasts the host's timeout, but values keep arriving.
+  XCTAssertGreaterThan(
+      s.scheduler.now(), vivsim::HostDelegate::kDefaultTimeout);
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertTrue(s.host->files().at(2) == contents);
+}
+
+- (void)testOffsetAndLength {
+  vivsim::Scheduler scheduler;
+  vivsim::Device device(scheduler);
+  device.AddFile(2, kVLFileTypeFitActivity, 0, MakeContents(100));
+  std::vector<VLPacket> sent;
+  device.Attach([&sent](uint8_t const *value, size_t length) {
+    VLPacket packet;
+    if (VLReadPacket(&packet, value, length) == 0) {
+      sent.push_back(packet);
+    }
+  });
+
+  uint8_t const payload[] = {2, 0, 10, 0, 0, 0, 20, 0, 0, 0};
+  VLPacket const command =
+      VLMakePacket(kVLSeqnoEnd, 0x010b, payload, sizeof(payload));
+  device.Receive(
+      reinterpret_cast<uint8_t const *>(&command), VLPacketLength(&command));
+  scheduler.Run();
+
+  XCTAssertEqual(sent.size(), 3);
+  XCTAssertEqual(OSReadLittleInt16(sent[0].cmd, 0), 0x810b);
+  XCTAssertEqual(OSReadLittleInt32(sent[0].payload, 2), 10);
+  XCTAssertEqual(OSReadLittleInt32(sent[0].payload, 6), 20);
+  XCTAssertEqual(VLPacketSeqno(&sent[1]), kVLSeqnoStart);
+  XCTAssertEqual(sent[1].payload_length, 14);
+  XCTAssertEqual(sent[1].payload[0], 10);
+  XCTAssertEqual(VLPacketSeqno(&sent[2]), kVLSeqnoEnd);
+  XCTAssertEqual(sent[2].payload_length, 6);
+  XCTAssertEqual(sent[2].payload[5], 29);
+}
+
+- (void)testErase {
+  Session s;
+  s.device.AddFile(2, kVLFileTypeFitActivity, 0, MakeContents(10));
+
+  s.manager->EraseFile(2);
+  s.scheduler.Run();
+  XCTAssertTrue(s.host->erased().at(2));
+  XCTAssertFalse(s.device.HasFile(2));
+
+  s.manager->EraseFile(2);
+  s.scheduler.Run();
+  XCTAssertFalse(s.host->erased().at(2));
+  XCTAssertEqual(s.host->timeouts(), 0);
+}
+
+- (void)testSetTime {
+  Session s;
+  time_t const posix_time = 1600000000;
+
+  s.manager->SetTime(posix_time);
+  s.scheduler.Run();
+  XCTAssertEqual(s.host->set_time_count(), 1);
+  XCTAssertEqual(s.device.clock(), VLGetVivaTimeFromPosix(posix_time));
+
+  s.scheduler.RunUntil(s.scheduler.now() + 60 * vivsim::kSecond);
+  XCTAssertEqual(s.device.clock(), VLGetVivaTimeFromPosix(posix_time) + 60);
+}
+
+- (void)testUnknownFile {
+  Session s;
+
+  s.manager->DownloadFile(9);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.device.packets_sent(), 0);
+  XCTAssertEqual(s.device.ignored(), 1);
+  XCTAssertEqual(s.host->timeouts(), 1);
+}
+
+@end
@@ -0,0 +1,165 @@
+// DirectoryCacheTests.mm - unit tests for viv/directory_cache.h
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DirectoryFixture.hpp"
+#include "viv/directory_cache.h"
+#include "viv/directory_cache.hpp"
+#include "viv/manager.hpp"
+#include "viv/raw_directory.h"
+#include "viv/vivtime.h"
+#include "vivsim/device.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+using vivtest::MakeActivities;
+
+/// Builds a cache file for \p directory.
+std::vector<uint8_t>
+MakeCache(std::vector<uint8_t> const &directory, time_t fetched_time) {
+  std::vector<uint8_t> cache(VLDirectoryCacheLength(directory.size()));
+  int const written = VLWriteDirectoryCache(
+      cache.data(), cache.size(), directory.data(), directory.size(),
+      fetched_time);
+  cache.resize(written < 0 ? 0 : written);
+  return cache;
+}
+
+void
+AppendEntry(void *ctx, VLDirectoryEntry entry) {
+  static_cast<std::vector<VLDirectoryEntry> *>(ctx)->push_back(entry);
+}
+
+} // namespace
+
+@interface DirectoryCacheTests : XCTestCase
+
+@end
+
+@implementation DirectoryCacheTests
+
+- (void)testRoundTrip {
+  auto const directory = MakeActivities({1, 2, 5});
+  auto const cache = MakeCache(directory, 1600000000);
+  XCTAssertEqual(cache.size(), directory.size() + 32);
+
+  VLDirectoryCacheInfo info;
+  XCTAssertEqual(VLReadDirectoryCache(&info, cache.data(), cache.size()), 0);
+  XCTAssertEqual(info.device_time, VLGetPosixTimeFromViva(1000));
+  XCTAssertEqual(info.fetched_time, 1600000000);
+  XCTAssertEqual(
+      info.fingerprint,
+      VLDirectoryFingerprint(directory.data(), directory.size()));
+  XCTAssertEqual(info.entry_count, 3);
+
+  viv::DirectoryCache view(cache.data(), cache.size());
+  XCTAssertEqual(view.Read(), 0);
+  XCTAssertEqual(view.directory().size(), 3);
+  XCTAssertEqual(view.directory()[2].index(), 5);
+  XCTAssertEqual(view.directory()[2].length(), 500);
+}
+
+- (void)testQuery {
+  auto const cache = MakeCache(MakeActivities({1, 2, 3, 4, 5}), 0);
+
+  VLDirectoryQuery query = {};
+  query.order = kVLDirectoryOrderLargest;
+  query.limit = 2;
+  std::vector<VLDirectoryEntry> entries;
+  XCTAssertEqual(
+      VLQueryDirectoryCache(
+          cache.data(), cache.size(), query, AppendEntry, &entries),
+      2);
+  XCTAssertEqual(entries.size(), 2);
+  XCTAssertEqual(entries[0].index, 5);
+  XCTAssertEqual(entries[1].index, 4);
+}
+
+- (void)testRejectsInvalid {
+  auto const cache = MakeCache(MakeActivities({1, 2}), 0);
+  VLDirectoryCacheInfo info;
+
+  XCTAssertLessThan(VLReadDirectoryCache(&info, cache.data(), 16), 0);
+  XCTAssertLessThan(
+      VLReadDirectoryCache(&info, cache.data(), cache.size() - 16), 0);
+
+  auto newer = cache;
+  newer[6] = 2;
+  XCTAssertEqual(VLReadDirectoryCache(&info, newer.data(), newer.size()), -2);
+
+  auto corrupt = cache;
+  corrupt[32 + 16 + 8] ^= 1;
+  XCTAssertEqual(
+      VLReadDirectoryCache(&info, corrupt.data(), corrupt.size()), -5);
+
+  std::vector<VLDirectoryEntry> entries;
+  XCTAssertLessThan(
+      VLQueryDirectoryCache(
+          corrupt.data(), corrupt.size(), VLDirectoryQuery{}, AppendEntry,
+          &entries),
+      0);
+  XCTAssertTrue(entries.empty());
+}
+
+- (void)testWriteErrors {
+  auto const directory = MakeActivities({1, 2});
+  std::vector<uint8_t> cache(directory.size() + 31);
+  XCTAssertLessThan(
+      VLWriteDirectoryCache(
+          cache.data(), cache.size(), directory.data(), directory.size(), 0),
+      0);
+
+  cache.resize(directory.size() + 32);
+  XCTAssertLessThan(
+      VLWriteDirectoryCache(
+          cache.data(), cache.size(), directory.data(), directory.size() - 1,
+          0),
+      0);
+}
+
+- (void)testDownloadedDirectory {
+  vivsim::Scheduler scheduler;
+  vivsim::Device device(scheduler);
+  auto delegate = std::make_unique<vivsim::HostDelegate>(
+      scheduler, [&](uint8_t const *value, size_t length) {
+        return device.Receive(value, length);
+      });
+  vivsim::HostDelegate *const host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+  device.Attach([host](uint8_t const *value, size_t length) {
+    host->Deliver(0, value, length);
+  });
+  for (uint16_t i = 1; i <= 3; ++i) {
+    device.AddFile(i, kVLFileTypeFitActivity, 500, std::vector<uint8_t>(10));
+  }
+
+  manager.DownloadDirectory();
+  scheduler.Run();
+  auto const cache = MakeCache(host->raw_directory(), 1600000000);
+  VLDirectoryCacheInfo info;
+  XCTAssertEqual(VLReadDirectoryCache(&info, cache.data(), cache.size()), 0);
+  XCTAssertEqual(info.entry_count, 3);
+  XCTAssertEqual(info.fingerprint, host->fingerprint());
+}
+
+@end
@@ -0,0 +1,134 @@
+// DirectoryColumnsTests.mm - unit tests for viv/directory_columns.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <random>
+#include <vector>
+
+#include "viv/directory.hpp"
+#include "viv/directory_columns.hpp"
+#include "viv/raw_directory.h"
+#include "viv/vivtime.h"
+
+namespace {
+
+/// Column storage for up to \c size entries.
+struct Columns {
+  explicit Columns(size_t size)
+      : index(size), file_type(size), flags(size), length(size),
+        posix_time(size) {}
+
+  viv::DirectoryColumns columns() {
+    return viv::DirectoryColumns{
+        index.data(), file_type.data(), flags.data(), length.data(),
+        posix_time.data()};
+  }
+
+  bool operator==(Columns const &other) const {
+    return index == other.index && file_type == other.file_type &&
+           flags == other.flags && length == other.length &&
+           posix_time == other.posix_time;
+  }
+
+  std::vector<uint16_t> index;
+  std::vector<uint16_t> file_type;
+  std::vector<uint8_t> flags;
+  std::vector<uint32_t> length;
+  std::vector<time_t> posix_time;
+};
+
+/// Returns \p count entries of random bytes.
+std::vector<VLRawDirectoryEntry>
+MakeEntries(size_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<VLRawDirectoryEntry> entries(count);
+  auto *const p = reinterpret_cast<uint8_t *>(entries.data());
+  for (size_t i = 0; i < count * sizeof(VLRawDirectoryEntry); ++i) {
+    p[i] = static_cast<uint8_t>(rng());
+  }
+  return entries;
+}
+
+} // namespace
+
+@interface DirectoryColumnsTests : XCTestCase
+
+@end
+
+@implementation DirectoryColumnsTests
+
+- (void)testDecode {
+  uint8_t const data[] = {
+      0x01, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // header
+      0xe8, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //
+      0x02, 0x00, 0x80, 0x04, 0x02, 0x00, 0x00, 0x60, // entry 2
+      0x00, 0x01, 0x00, 0x00, 0xe8, 0x03, 0x00, 0x00, //
+  };
+  viv::DirectoryView dir(data, sizeof(data));
+  XCTAssertTrue(dir.Read());
+
+  Columns c(1);
+  viv::DecodeDirectoryColumns(dir.data(), dir.size(), c.columns());
+  XCTAssertEqual(c.index[0], 2);
+  XCTAssertEqual(c.file_type[0], kVLFileTypeFitActivity);
+  XCTAssertEqual(c.flags[0], viv::kReadable | viv::kErasable);
+  XCTAssertEqual(c.length[0], 256);
+  XCTAssertEqual(c.posix_time[0], VLGetPosixTimeFromViva(1000));
+}
+
+- (void)testVectorMatchesScalar {
+  // Counts that do and don't fill the last block of four.
+  for (size_t count = 0; count <= 9; ++count) {
+    auto const entries = MakeEntries(count, count);
+    Columns scalar(count);
+    Columns vector(count);
+    viv::DecodeDirectoryColumnsScalar(
+        entries.data(), count, scalar.columns());
+    viv::DecodeDirectoryColumns(entries.data(), count, vector.columns());
+    XCTAssertTrue(scalar == vector, @"count %zu", count);
+
+    for (size_t i = 0; i < count; ++i) {
+      viv::DirectoryEntry const entry(entries[i]);
+      XCTAssertEqual(vector.index[i], entry.index());
+      XCTAssertEqual(vector.file_type[i], entry.file_type());
+      XCTAssertEqual(vector.flags[i], entries[i].flags);
+      XCTAssertEqual(vector.length[i], entry.length());
+      XCTAssertEqual(vector.posix_time[i], entry.time());
+    }
+  }
+}
+
+- (void)testExtremes {
+  std::vector<VLRawDirectoryEntry> entries(8);
+  auto *const p = reinterpret_cast<uint8_t *>(entries.data());
+  // All bits set in the first four entries; all clear in the rest.
+  std::fill(p, p + 4 * sizeof(VLRawDirectoryEntry), 0xff);
+
+  Columns c(entries.size());
+  viv::DecodeDirectoryColumns(entries.data(), entries.size(), c.columns());
+  XCTAssertEqual(c.index[3], 0xffff);
+  XCTAssertEqual(c.file_type[3], 0xffff);
+  XCTAssertEqual(c.flags[3], 0xff);
+  XCTAssertEqual(c.length[3], 0xffffffff);
+  XCTAssertEqual(c.posix_time[3], VLGetPosixTimeFromViva(0xffffffff));
+  XCTAssertEqual(c.index[4], 0);
+  XCTAssertEqual(c.posix_time[4], VLGetPosixTimeFromViva(0));
+}
+
+@end
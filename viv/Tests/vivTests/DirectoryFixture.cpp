@@ -0,0 +1,52 @@
+// DirectoryFixture.cpp - raw directories for tests
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DirectoryFixture.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "viv/endian.hpp"
+
+namespace vivtest {
+
+std::vector<uint8_t>
+MakeDirectory(std::vector<DirectoryFile> const &files) {
+  std::vector<uint8_t> data(16 * (files.size() + 1));
+  data[0] = 1;  // version
+  data[1] = 16; // record_length
+  VLWriteLittleInt32(&data[8], 0, 1000);
+  for (size_t i = 0; i < files.size(); ++i) {
+    uint8_t *const p = &data[16 * (i + 1)];
+    VLWriteLittleInt16(p, 0, files[i].index);
+    VLWriteLittleInt16(p + 2, 0, files[i].file_type);
+    p[7] = files[i].flags;
+    VLWriteLittleInt32(p + 8, 0, files[i].length);
+    VLWriteLittleInt32(p + 12, 0, files[i].viva_time);
+  }
+  return data;
+}
+
+std::vector<uint8_t>
+MakeActivities(std::vector<uint16_t> const &indices) {
+  std::vector<DirectoryFile> files;
+  for (uint16_t const index : indices) {
+    files.push_back(DirectoryFile{
+        index, 1000u + index, 100u * index, viv::kReadable});
+  }
+  return MakeDirectory(files);
+}
+
+} // namespace vivtest
@@ -0,0 +1,48 @@
+// DirectoryFixture.hpp - raw directories for tests
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef vivTests_DirectoryFixture_hpp
+#define vivTests_DirectoryFixture_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "viv/directory.hpp"
+#include "viv/directory_entry.h"
+
+namespace vivtest {
+
+/// A file listed by MakeDirectory.
+struct DirectoryFile {
+  uint16_t index;
+  uint32_t viva_time;
+  uint32_t length;
+  uint8_t flags = viv::kReadable | viv::kErasable;
+  VLFileType file_type = kVLFileTypeFitActivity;
+};
+
+/// Builds a raw directory (as downloaded from index 0) listing \p files.
+///
+/// The header's time is Viva time 1000.
+std::vector<uint8_t> MakeDirectory(std::vector<DirectoryFile> const &files);
+
+/// Builds a raw directory of readable activities with the given indices.
+///
+/// File \c i is <tt>100 * i</tt> bytes long, with Viva time <tt>1000 + i</tt>.
+std::vector<uint8_t> MakeActivities(std::vector<uint16_t> const &indices);
+
+} // namespace vivtest
+
+#endif /* vivTests_DirectoryFixture_hpp */
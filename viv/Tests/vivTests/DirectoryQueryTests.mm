@@ -0,0 +1,191 @@
+// DirectoryQueryTests.mm - unit tests for viv/directory_query.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "DirectoryFixture.hpp"
+#include "viv/directory.hpp"
+#include "viv/directory_query.h"
+#include "viv/directory_query.hpp"
+#include "viv/raw_directory.h"
+#include "viv/vivtime.h"
+
+namespace {
+
+using vivtest::MakeDirectory;
+
+constexpr uint8_t kReadable = viv::kReadable;
+constexpr uint8_t kReadableErasable = viv::kReadable | viv::kErasable;
+
+/// A directory with a device file and several activities.
+std::vector<uint8_t> const kDirectory = MakeDirectory({
+    {1, 100, 50, kReadable, kVLFileTypeFitDevice},
+    {2, 300, 4000, kReadableErasable, kVLFileTypeFitActivity},
+    {3, 500, 1000, kReadableErasable, kVLFileTypeFitActivity},
+    {4, 200, 2000, kReadable, kVLFileTypeFitActivity},
+    {5, 500, 3000, kReadableErasable, kVLFileTypeFitActivity},
+    {6, 400, 500, kReadableErasable, kVLFileTypeFitActivity},
+});
+
+/// Returns the indices of the entries of kDirectory selected by \p query.
+///
+/// Both DirectoryQuery::Run and DirectoryQuery::Select are checked; if they
+/// disagree, the result is empty.
+std::vector<uint16_t>
+Select(VLDirectoryQuery const &query) {
+  viv::DirectoryView dir(kDirectory.data(), kDirectory.size());
+  if (!dir.Read()) {
+    return {};
+  }
+  std::vector<uint16_t> indices;
+  size_t const count = viv::DirectoryQuery(query).Run(
+      dir, [&](viv::DirectoryEntry const &entry) {
+        indices.push_back(entry.index());
+      });
+  if (count != indices.size()) {
+    return {};
+  }
+
+  std::vector<uint8_t> data = kDirectory;
+  auto *const raw = reinterpret_cast<VLRawDirectoryEntry *>(&data[16]);
+  size_t const selected = viv::DirectoryQuery(query).Select(raw, dir.size());
+  if (selected != count) {
+    return {};
+  }
+  for (size_t i = 0; i < selected; ++i) {
+    if (viv::DirectoryEntry(raw[i]).index() != indices[i]) {
+      return {};
+    }
+  }
+  return indices;
+}
+
+} // namespace
+
+@interface DirectoryQueryTests : XCTestCase
+
+@end
+
+@implementation DirectoryQueryTests
+
+- (void)testMatchAll {
+  VLDirectoryQuery const query = {};
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({1, 2, 3, 4, 5, 6}));
+}
+
+- (void)testPredicates {
+  VLDirectoryQuery query = {};
+  query.file_type = kVLFileTypeFitDevice;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({1}));
+
+  query = {};
+  query.required_flags = kVLFileFlagErasable;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({2, 3, 5, 6}));
+
+  query = {};
+  query.min_posix_time = VLGetPosixTimeFromViva(300);
+  query.max_posix_time = VLGetPosixTimeFromViva(400);
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({2, 6}));
+
+  query = {};
+  query.min_length = 1000;
+  query.max_length = 3000;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({3, 4, 5}));
+
+  query = {};
+  query.file_type = kVLFileTypeFitActivity;
+  query.required_flags = kVLFileFlagReadable | kVLFileFlagErasable;
+  query.min_length = 1000;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({2, 3, 5}));
+}
+
+- (void)testLimit {
+  VLDirectoryQuery query = {};
+  query.limit = 2;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({1, 2}));
+
+  query.limit = 10;
+  XCTAssertEqual(Select(query).size(), 6);
+}
+
+- (void)testOrder {
+  VLDirectoryQuery query = {};
+  query.file_type = kVLFileTypeFitActivity;
+
+  // Ties (files 3 and 5) are broken by directory order.
+  query.order = kVLDirectoryOrderNewest;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({3, 5, 6, 2, 4}));
+
+  query.order = kVLDirectoryOrderOldest;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({4, 2, 6, 3, 5}));
+
+  query.order = kVLDirectoryOrderLargest;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({2, 5, 4, 3, 6}));
+}
+
+- (void)testNewestActivities {
+  VLDirectoryQuery query = {};
+  query.file_type = kVLFileTypeFitActivity;
+  query.order = kVLDirectoryOrderNewest;
+  query.limit = 3;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({3, 5, 6}));
+}
+
+- (void)testOrderWithLimit {
+  VLDirectoryQuery query = {};
+  query.file_type = kVLFileTypeFitActivity;
+
+  // A later match with a tied key must not displace an earlier one.
+  query.order = kVLDirectoryOrderNewest;
+  query.limit = 1;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({3}));
+
+  query.order = kVLDirectoryOrderOldest;
+  query.limit = 4;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({4, 2, 6, 3}));
+
+  query.order = kVLDirectoryOrderLargest;
+  query.limit = 2;
+  XCTAssertTrue(Select(query) == std::vector<uint16_t>({2, 5}));
+}
+
+- (void)testNoMatches {
+  VLDirectoryQuery query = {};
+  query.min_length = 5000;
+  query.order = kVLDirectoryOrderNewest;
+  XCTAssertTrue(Select(query).empty());
+}
+
+- (void)testNoAllocations {
+  viv::DirectoryView dir(kDirectory.data(), kDirectory.size());
+  XCTAssertTrue(dir.Read());
+  VLDirectoryQuery query = {};
+  query.order = kVLDirectoryOrderLargest;
+  query.limit = 3;
+
+  vivtest::AllocationTracker tracker;
+  uint32_t total = 0;
+  viv::DirectoryQuery(query).Run(dir, [&](viv::DirectoryEntry const &entry) {
+    total += entry.length();
+  });
+  VLAssertAllocationBudget(tracker, 0);
+  XCTAssertEqual(total, 9000);
+}
+
+@end
@@ -0,0 +1,154 @@
+// DirectoryTests.mm - unit tests for viv/directory.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "DirectoryFixture.hpp"
+#include "viv/directory.hpp"
+#include "viv/raw_directory.h"
+
+using vivtest::MakeActivities;
+
+@interface DirectoryTests : XCTestCase
+
+@end
+
+@implementation DirectoryTests
+
+- (void)testRead {
+  auto const data = MakeActivities({1, 2, 5});
+  viv::DirectoryView dir(data.data(), data.size());
+  XCTAssertTrue(dir.Read());
+  XCTAssertEqual(dir.header().time(), VLGetPosixTimeFromViva(1000));
+  XCTAssertEqual(dir.size(), 3);
+  XCTAssertEqual(dir[2].index(), 5);
+  XCTAssertEqual(dir[2].length(), 500);
+  XCTAssertEqual(dir[2].file_type(), kVLFileTypeFitActivity);
+
+  std::vector<uint16_t> indices;
+  for (viv::DirectoryEntry const entry : dir) {
+    indices.push_back(entry.index());
+  }
+  XCTAssertTrue(indices == std::vector<uint16_t>({1, 2, 5}));
+}
+
+- (void)testReadEmpty {
+  auto const data = MakeActivities({});
+  viv::DirectoryView dir(data.data(), data.size());
+  XCTAssertTrue(dir.Read());
+  XCTAssertEqual(dir.size(), 0);
+  XCTAssertTrue(dir.begin() == dir.end());
+  XCTAssertEqual(dir.Find(1), nullptr);
+}
+
+- (void)testReadInvalid {
+  auto data = MakeActivities({1, 2});
+  viv::DirectoryView truncated(data.data(), data.size() - 1);
+  XCTAssertFalse(truncated.Read());
+
+  viv::DirectoryView short_header(data.data(), 15);
+  XCTAssertFalse(short_header.Read());
+
+  data[0] = 2;
+  viv::DirectoryView bad_version(data.data(), data.size());
+  XCTAssertFalse(bad_version.Read());
+}
+
+- (void)testFindSorted {
+  auto const data = MakeActivities({1, 3, 4, 8, 9});
+  viv::DirectoryView dir(data.data(), data.size());
+  XCTAssertTrue(dir.Read());
+
+  VLRawDirectoryEntry const *raw = dir.Find(8);
+  XCTAssertNotEqual(raw, nullptr);
+  XCTAssertEqual(viv::DirectoryEntry(*raw).length(), 800);
+  XCTAssertNotEqual(dir.Find(1), nullptr);
+  XCTAssertNotEqual(dir.Find(9), nullptr);
+  XCTAssertEqual(dir.Find(0), nullptr);
+  XCTAssertEqual(dir.Find(5), nullptr);
+  XCTAssertEqual(dir.Find(10), nullptr);
+}
+
+- (void)testFindUnsorted {
+  auto const data = MakeActivities({9, 3, 8});
+  viv::DirectoryView dir(data.data(), data.size());
+  XCTAssertTrue(dir.Read());
+
+  VLRawDirectoryEntry const *raw = dir.Find(3);
+  XCTAssertNotEqual(raw, nullptr);
+  XCTAssertEqual(viv::DirectoryEntry(*raw).length(), 300);
+  XCTAssertNotEqual(dir.Find(8), nullptr);
+  XCTAssertEqual(dir.Find(4), nullptr);
+}
+
+- (void)testDecodeEntriesInPlace {
+  std::vector<uint16_t> indices;
+  for (uint16_t i = 1; i <= 20; ++i) {
+    indices.push_back(i);
+  }
+  auto data = MakeActivities(indices);
+  auto const *raw = reinterpret_cast<VLRawDirectoryEntry const *>(&data[16]);
+  VLDirectoryEntry const *entries =
+      viv::DecodeEntriesInPlace(data.data(), raw, indices.size());
+  XCTAssertNotEqual(entries, nullptr);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    XCTAssertEqual(entries[i].index, indices[i]);
+    XCTAssertEqual(entries[i].length, 100 * indices[i]);
+    XCTAssertEqual(entries[i].file_type, kVLFileTypeFitActivity);
+  }
+
+  // Records without a header, e.g. a directory page.
+  data = MakeActivities({7, 8});
+  data.erase(data.begin(), data.begin() + 16);
+  entries = viv::DecodeEntriesInPlace(
+      data.data(), reinterpret_cast<VLRawDirectoryEntry const *>(data.data()),
+      2);
+  XCTAssertNotEqual(entries, nullptr);
+  XCTAssertEqual(entries[0].index, 7);
+  XCTAssertEqual(entries[1].index, 8);
+  XCTAssertEqual(entries[1].length, 800);
+}
+
+- (void)testDecodeEntriesInPlaceUnaligned {
+  auto data = MakeActivities({1});
+  data.insert(data.begin(), 0);
+  auto const *raw = reinterpret_cast<VLRawDirectoryEntry const *>(&data[17]);
+  XCTAssertEqual(viv::DecodeEntriesInPlace(data.data() + 1, raw, 1), nullptr);
+}
+
+- (void)testNoAllocations {
+  std::vector<uint16_t> indices;
+  for (uint16_t i = 1; i <= 100; ++i) {
+    indices.push_back(i);
+  }
+  auto const data = MakeActivities(indices);
+
+  vivtest::AllocationTracker tracker;
+  viv::DirectoryView dir(data.data(), data.size());
+  XCTAssertTrue(dir.Read());
+  uint32_t total = 0;
+  for (viv::DirectoryEntry const entry : dir) {
+    total += entry.length();
+  }
+  XCTAssertNotEqual(dir.Find(50), nullptr);
+  VLAssertAllocationBudget(tracker, 0);
+  XCTAssertEqual(total, 100 * 5050);
+}
+
+@end
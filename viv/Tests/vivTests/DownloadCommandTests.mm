@@ -29,8 +29,7 @@
 @implementation DownloadCommandTests
 
 - (void)testMakeCommandPacket {
-  viv::DownloadCommand cmd(
-      0x1234, 1, 0xffffffee, [](uint16_t, uint8_t const *, size_t) {});
+  viv::DownloadCommand cmd(0x1234, 1, 0xffffffee, {});
   VLPacket const packet = cmd.MakeCommandPacket();
 
   XCTAssertEqual(packet.payload_length, 10);
@@ -47,7 +46,7 @@
       3,
       {0x0b, 0x81},
       {0x34, 0x12, 0, 0, 0, 0, 0x56, 0, 0, 0, 0, 0, 0, 0}};
-  viv::DownloadCommand cmd(0x1234, [](uint16_t, uint8_t const *, size_t) {});
+  viv::DownloadCommand cmd(0x1234, {});
   XCTAssertEqual(cmd.ReadPacket(ack), 0);
 
   VLPacket const reply = {
@@ -58,6 +57,21 @@
   XCTAssertEqual(memcmp(reply.payload, cmd.buffer(), 14), 0);
 }
 
+- (void)testEmptyDownloadFinishesWithAck {
+  VLPacket const ack = {
+      0xfa,
+      0,
+      1,
+      3,
+      {0x0b, 0x81},
+      {0x34, 0x12, 0x20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+  viv::DownloadCommand cmd(0x1234, 0x20, 0xffffffff, {});
+  XCTAssertFalse(cmd.MaybeFinish());
+  XCTAssertEqual(cmd.ReadPacket(ack), 0);
+  XCTAssertTrue(cmd.MaybeFinish());
+  XCTAssertEqual(cmd.length(), 0);
+}
+
 - (void)testReadPacketBadCmd {
   VLPacket const packet = {
       0xe6,
@@ -66,7 +80,7 @@
       3,
       {0x0b, 0x85 /* bad */},
       {0x34, 0x12, 0, 0, 0, 0, 0x56, 0, 0, 0, 0, 0, 0, 0}};
-  viv::DownloadCommand cmd(0x1234, [](uint16_t, uint8_t const *, size_t) {});
+  viv::DownloadCommand cmd(0x1234, {});
   XCTAssertLessThan(cmd.ReadPacket(packet), 0);
 }
 
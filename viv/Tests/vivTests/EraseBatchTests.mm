@@ -0,0 +1,201 @@
+// EraseBatchTests.mm - unit tests for viv/erase_batch.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "viv/endian.hpp"
+#include "viv/erase_batch.hpp"
+#include "viv/erase_result.h"
+#include "viv/manager.hpp"
+#include "viv/packet.h"
+#include "vivsim/device.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+constexpr VLCommandId kCommandErase = 0x040b;
+
+/// A manager connected to a simulated device with five files.
+struct Session {
+  Session() : device(scheduler) {
+    auto delegate = std::make_unique<vivsim::HostDelegate>(
+        scheduler, [this](uint8_t const *value, size_t length) {
+          VLPacket packet;
+          if (VLReadPacket(&packet, value, length) == 0 &&
+              OSReadLittleInt16(packet.cmd, 0) == kCommandErase &&
+              OSReadLittleInt16(packet.payload, 0) == lost_index) {
+            return 0;
+          }
+          return device.Receive(value, length);
+        });
+    host = delegate.get();
+    manager = std::make_unique<viv::Manager>(std::move(delegate));
+    host->Attach(manager.get());
+    device.Attach([this](uint8_t const *value, size_t length) {
+      host->Deliver(0, value, length);
+    });
+    for (uint16_t i = 1; i <= 5; ++i) {
+      device.AddFile(i, kVLFileTypeFitActivity, 0, std::vector<uint8_t>(100));
+    }
+  }
+
+  /// Returns the outcome reported for \p index.
+  int OutcomeOf(uint16_t index) const {
+    for (auto const &result : host->erase_results()) {
+      if (result.index == index) {
+        return result.outcome;
+      }
+    }
+    return -1;
+  }
+
+  vivsim::Scheduler scheduler;
+  vivsim::Device device;
+  vivsim::HostDelegate *host;
+  std::unique_ptr<viv::Manager> manager;
+
+  /// Erase commands for this index are lost in transit.
+  uint16_t lost_index = 0;
+};
+
+} // namespace
+
+@interface EraseBatchTests : XCTestCase
+
+@end
+
+@implementation EraseBatchTests
+
+- (void)testNext {
+  viv::EraseBatch batch;
+  uint16_t const indices[] = {4, 2};
+  XCTAssertTrue(batch.Start(indices, 2));
+  XCTAssertTrue(batch.active());
+
+  uint16_t index;
+  XCTAssertTrue(batch.Next(index));
+  XCTAssertEqual(index, 4);
+  XCTAssertTrue(batch.Next(index));
+  XCTAssertEqual(index, 2);
+  XCTAssertFalse(batch.Next(index));
+  XCTAssertFalse(batch.verifying());
+}
+
+- (void)testTooMany {
+  viv::EraseBatch batch;
+  std::vector<uint16_t> indices(viv::EraseBatch::kMaxFiles + 1);
+  XCTAssertFalse(batch.Start(indices.data(), indices.size()));
+  XCTAssertFalse(batch.active());
+}
+
+- (void)testVerified {
+  viv::EraseBatch batch;
+  uint16_t const indices[] = {1, 2, 3, 4};
+  batch.Start(indices, 4);
+  uint16_t index;
+  while (batch.Next(index)) {
+  }
+  batch.DidErase(1, true);
+  batch.DidErase(2, true);
+  batch.DidErase(3, false);
+  batch.StartVerifying();
+  batch.DidFindFile(2);
+  batch.DidFindFile(3);
+  batch.DidVerify();
+
+  size_t count;
+  VLEraseResult const *results = batch.Finish(count);
+  XCTAssertEqual(count, 4);
+  XCTAssertEqual(results[0].index, 1);
+  XCTAssertEqual(results[0].outcome, kVLEraseOutcomeErased);
+  XCTAssertEqual(results[1].outcome, kVLEraseOutcomeStillPresent);
+  XCTAssertEqual(results[2].outcome, kVLEraseOutcomeFailed);
+  // The reply was lost, but the file is gone.
+  XCTAssertEqual(results[3].outcome, kVLEraseOutcomeErased);
+}
+
+- (void)testUnverified {
+  viv::EraseBatch batch;
+  uint16_t const indices[] = {1, 2, 3};
+  batch.Start(indices, 3);
+  uint16_t index;
+  while (batch.Next(index)) {
+  }
+  batch.DidErase(1, true);
+  batch.DidErase(2, false);
+  batch.StartVerifying();
+
+  size_t count;
+  VLEraseResult const *results = batch.Finish(count);
+  XCTAssertEqual(count, 3);
+  XCTAssertEqual(results[0].outcome, kVLEraseOutcomeErased);
+  XCTAssertEqual(results[1].outcome, kVLEraseOutcomeFailed);
+  XCTAssertEqual(results[2].outcome, kVLEraseOutcomeFailed);
+}
+
+- (void)testSession {
+  Session s;
+  uint16_t const indices[] = {1, 3, 5};
+  s.manager->EraseFiles(indices, 3);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->waits(), 1);
+  XCTAssertFalse(s.host->waiting());
+  // Three erases and one directory download.
+  XCTAssertEqual(s.device.commands(), 4);
+  XCTAssertEqual(s.host->erase_results().size(), 3);
+  XCTAssertEqual(s.OutcomeOf(1), kVLEraseOutcomeErased);
+  XCTAssertEqual(s.OutcomeOf(3), kVLEraseOutcomeErased);
+  XCTAssertEqual(s.OutcomeOf(5), kVLEraseOutcomeErased);
+  XCTAssertEqual(s.host->erased().size(), 3);
+  XCTAssertEqual(s.host->entries().size(), 2);
+  XCTAssertFalse(s.device.HasFile(3));
+}
+
+- (void)testLostCommand {
+  Session s;
+  s.lost_index = 3;
+  uint16_t const indices[] = {1, 3, 5};
+  s.manager->EraseFiles(indices, 3);
+  s.scheduler.Run();
+
+  // Only the lost command is abandoned.
+  XCTAssertEqual(s.host->timeouts(), 1);
+  XCTAssertEqual(s.host->waits(), 1);
+  XCTAssertFalse(s.host->waiting());
+  XCTAssertEqual(s.OutcomeOf(1), kVLEraseOutcomeErased);
+  XCTAssertEqual(s.OutcomeOf(3), kVLEraseOutcomeFailed);
+  XCTAssertEqual(s.OutcomeOf(5), kVLEraseOutcomeErased);
+  XCTAssertEqual(s.host->entries().size(), 3);
+}
+
+- (void)testEmpty {
+  Session s;
+  s.manager->EraseFiles(nullptr, 0);
+  s.scheduler.Run();
+
+  XCTAssertEqual(s.host->waits(), 1);
+  XCTAssertEqual(s.device.commands(), 1);
+  XCTAssertEqual(s.host->entries().size(), 5);
+  XCTAssertEqual(s.host->erase_results().size(), 0);
+}
+
+@end
@@ -24,7 +24,7 @@
 @implementation EraseCommandTests
 
 - (void)testMakeCommandPacket {
-  viv::EraseCommand cmd(0x1234, [](bool) {});
+  viv::EraseCommand cmd(0x1234, {});
   VLPacket const packet = cmd.MakeCommandPacket();
 
   XCTAssertEqual(packet.payload_length, 2);
@@ -34,7 +34,8 @@
 - (void)testReadPacket {
   VLPacket const ack = {0xe9, 0, 1, 3, {0x0b, 0x84}};
   bool replyOk = false;
-  viv::EraseCommand cmd(0x1234, [&replyOk](bool ok) { replyOk = ok; });
+  auto onFinish = [&replyOk](uint16_t, bool ok) { replyOk = ok; };
+  viv::EraseCommand cmd(0x1234, onFinish);
   int err = cmd.ReadPacket(ack);
   XCTAssertEqual(err, 0);
 
@@ -48,7 +49,8 @@
 - (void)testReadPacketError {
   VLPacket const ack = {0xe9, 0, 1, 3, {0x0b, 0x84}};
   bool replyOk = false;
-  viv::EraseCommand cmd(0x1234, [&replyOk](bool ok) { replyOk = ok; });
+  auto onFinish = [&replyOk](uint16_t, bool ok) { replyOk = ok; };
+  viv::EraseCommand cmd(0x1234, onFinish);
   int err = cmd.ReadPacket(ack);
   XCTAssertEqual(err, 0);
 
@@ -0,0 +1,162 @@
+// FaultInjectorTests.mm - unit tests for vivsim/fault_injector.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "viv/manager.hpp"
+#include "viv/manager_metrics.h"
+#include "vivsim/device.hpp"
+#include "vivsim/fault_injector.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+constexpr int kNumFiles = 20;
+constexpr size_t kFileLength = 1400;
+
+/// A manager connected to a simulated device by a faulty link.
+struct Session {
+  explicit Session(vivsim::FaultProfile const &profile)
+      : device(scheduler),
+        injector(
+            scheduler, profile, [this](uint8_t const *value, size_t length) {
+              host->Deliver(0, value, length);
+            }) {
+    auto delegate = std::make_unique<vivsim::HostDelegate>(
+        scheduler, [this](uint8_t const *value, size_t length) {
+          return device.Receive(value, length);
+        });
+    host = delegate.get();
+    manager = std::make_unique<viv::Manager>(std::move(delegate));
+    host->Attach(manager.get());
+    device.Attach(injector.link());
+    for (int i = 1; i <= kNumFiles; ++i) {
+      device.AddFile(
+          i, kVLFileTypeFitActivity, 0, std::vector<uint8_t>(kFileLength, i));
+    }
+  }
+
+  /// Downloads every file, returning the goodput in bytes per second.
+  double DownloadAll() {
+    for (int i = 1; i <= kNumFiles; ++i) {
+      manager->DownloadFile(i);
+      scheduler.Run();
+    }
+    size_t bytes = 0;
+    for (auto const &file : host->files()) {
+      bytes += file.second.size();
+    }
+    return bytes * static_cast<double>(vivsim::kSecond) / scheduler.now();
+  }
+
+  vivsim::Scheduler scheduler;
+  vivsim::Device device;
+  vivsim::FaultInjector injector;
+  vivsim::HostDelegate *host = nullptr;
+  std::unique_ptr<viv::Manager> manager;
+};
+
+} // namespace
+
+@interface FaultInjectorTests : XCTestCase
+
+@end
+
+@implementation FaultInjectorTests
+
+- (void)testNoFaults {
+  Session s{vivsim::FaultProfile()};
+  s.DownloadAll();
+
+  XCTAssertEqual(s.host->errors(), 0);
+  XCTAssertEqual(s.host->files().size(), kNumFiles);
+  XCTAssertEqual(s.injector.delivered(), s.injector.sent());
+  for (int i = 0; i < vivsim::kNumFaults; ++i) {
+    XCTAssertEqual(s.injector.count(static_cast<vivsim::Fault>(i)), 0);
+  }
+}
+
+- (void)testReorder {
+  vivsim::Scheduler scheduler;
+  std::vector<uint8_t> order;
+  vivsim::FaultInjector injector(
+      scheduler, vivsim::FaultProfile::Only(vivsim::kFaultReorder, 1),
+      [&order](uint8_t const *value, size_t length) {
+        order.push_back(value[0]);
+      });
+
+  for (uint8_t i = 1; i <= 5; ++i) {
+    injector.Send(&i, 1);
+  }
+  XCTAssertTrue(order == std::vector<uint8_t>({2, 1, 4, 3}));
+
+  // The last value is released after the delay.
+  scheduler.Run();
+  XCTAssertEqual(order.back(), 5);
+  XCTAssertEqual(scheduler.now(), vivsim::FaultProfile().delay_time);
+}
+
+- (void)testCorruptFailsCrc {
+  Session s{vivsim::FaultProfile::Only(vivsim::kFaultCorrupt, 0.05, 7)};
+  s.DownloadAll();
+
+  VLManagerMetrics const metrics = s.manager->SnapshotMetrics();
+  XCTAssertGreaterThan(s.injector.count(vivsim::kFaultCorrupt), 0);
+  XCTAssertEqual(metrics.crc_failures, s.injector.count(vivsim::kFaultCorrupt));
+  XCTAssertEqual(metrics.length_failures, 0);
+}
+
+- (void)testSeed {
+  auto const profile = vivsim::FaultProfile::Only(vivsim::kFaultDrop, 0.1, 3);
+  Session a{profile};
+  Session b{profile};
+  a.DownloadAll();
+  b.DownloadAll();
+
+  XCTAssertEqual(
+      a.injector.count(vivsim::kFaultDrop),
+      b.injector.count(vivsim::kFaultDrop));
+  XCTAssertEqual(a.scheduler.now(), b.scheduler.now());
+}
+
+- (void)testGoodput {
+  double const clean = Session{vivsim::FaultProfile()}.DownloadAll();
+
+  for (int i = 0; i < vivsim::kNumFaults; ++i) {
+    auto const fault = static_cast<vivsim::Fault>(i);
+    Session s{vivsim::FaultProfile::Only(fault, 0.02, 1)};
+    double const goodput = s.DownloadAll();
+    XCTAssertGreaterThan(s.injector.count(fault), 0);
+    XCTAssertGreaterThan(s.host->errors(), 0);
+    if (fault == vivsim::kFaultDuplicate) {
+      // The manager reports duplicates but otherwise ignores them.
+      XCTAssertEqual(goodput, clean);
+    } else {
+      XCTAssertLessThan(goodput, clean);
+    }
+  }
+
+  // Lost values cost a whole response timeout.
+  Session s{vivsim::FaultProfile::Only(vivsim::kFaultDrop, 0.02, 1)};
+  s.DownloadAll();
+  XCTAssertGreaterThan(s.host->timeouts(), 0);
+}
+
+@end
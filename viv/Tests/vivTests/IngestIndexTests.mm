@@ -0,0 +1,375 @@
+// IngestIndexTests.mm - unit tests for viv/ingest_index.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "viv/directory.hpp"
+#include "viv/endian.hpp"
+#include "viv/ingest_index.h"
+#include "viv/ingest_index.hpp"
+#include "viv/sync_plan.h"
+#include "viv/vivtime.h"
+
+namespace {
+
+constexpr VLDeviceId kDevice = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}};
+constexpr VLDeviceId kOtherDevice = {{0xff}};
+
+/// A log buffer and its index's slots.
+struct Log {
+  explicit Log(size_t capacity)
+      : bytes(capacity), slots(viv::IngestIndex::SlotCount(capacity)) {}
+
+  viv::IngestIndex Index() {
+    return viv::IngestIndex(
+        bytes.data(), bytes.size(), slots.data(), slots.size());
+  }
+
+  std::vector<uint8_t> bytes;
+  std::vector<uint32_t> slots;
+};
+
+VLLocalFile
+MakeFile(uint16_t index, uint32_t length, uint32_t checksum = 0x1234) {
+  return VLLocalFile{index, VLGetPosixTimeFromViva(1000 + index), length,
+                     checksum};
+}
+
+VLDirectoryEntry
+MakeEntry(uint16_t index, uint32_t length) {
+  return VLDirectoryEntry{
+      VLGetPosixTimeFromViva(1000 + index), length, index,
+      kVLFileTypeFitActivity};
+}
+
+} // namespace
+
+@interface IngestIndexTests : XCTestCase
+
+@end
+
+@implementation IngestIndexTests
+
+- (void)testAppendAndLookup {
+  Log log(4096);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+  XCTAssertEqual(index.Append(kDevice, MakeFile(1, 500)), 0);
+  XCTAssertEqual(index.Append(kDevice, MakeFile(2, 600)), 0);
+  XCTAssertEqual(index.Append(kOtherDevice, MakeFile(1, 700)), 0);
+
+  VLLocalFile file;
+  XCTAssertTrue(index.Lookup(kDevice, 1, file));
+  XCTAssertEqual(file.length, 500);
+  XCTAssertEqual(file.checksum, 0x1234);
+  XCTAssertEqual(file.posix_time, VLGetPosixTimeFromViva(1001));
+  XCTAssertTrue(index.Lookup(kOtherDevice, 1, file));
+  XCTAssertEqual(file.length, 700);
+  XCTAssertFalse(index.Lookup(kOtherDevice, 2, file));
+  XCTAssertFalse(index.Lookup(kDevice, 3, file));
+  XCTAssertEqual(index.live_count(), 3);
+}
+
+- (void)testSupersede {
+  Log log(4096);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+  index.Append(kDevice, MakeFile(1, 500));
+  index.Append(kDevice, MakeFile(1, 800));
+  index.Append(kDevice, MakeFile(2, 600));
+  index.Forget(kDevice, 2);
+
+  VLLocalFile file;
+  XCTAssertTrue(index.Lookup(kDevice, 1, file));
+  XCTAssertEqual(file.length, 800);
+  XCTAssertFalse(index.Lookup(kDevice, 2, file));
+  XCTAssertEqual(index.live_count(), 1);
+  XCTAssertEqual(index.record_count(), 4);
+}
+
+- (void)testState {
+  Log log(4096);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+  index.Append(kDevice, MakeFile(1, 500));
+  index.Append(kDevice, MakeFile(2, 500));
+  index.Append(kDevice, MakeFile(3, 500, 0));
+  VLLocalFile replaced = MakeFile(4, 500);
+  replaced.posix_time = 0;
+  index.Append(kDevice, replaced);
+
+  XCTAssertEqual(
+      index.State(kDevice, MakeEntry(1, 500)), kVLIngestStateIngested);
+  XCTAssertEqual(
+      index.State(kDevice, MakeEntry(2, 900)), kVLIngestStatePartial);
+  XCTAssertEqual(index.State(kDevice, MakeEntry(2, 400)), kVLIngestStateStale);
+  XCTAssertEqual(index.State(kDevice, MakeEntry(3, 500)), kVLIngestStateStale);
+  XCTAssertEqual(index.State(kDevice, MakeEntry(4, 500)), kVLIngestStateStale);
+  XCTAssertEqual(index.State(kDevice, MakeEntry(5, 500)), kVLIngestStateNew);
+  XCTAssertEqual(
+      index.State(kOtherDevice, MakeEntry(1, 500)), kVLIngestStateNew);
+}
+
+- (void)testReopen {
+  Log log(4096);
+  {
+    viv::IngestIndex index = log.Index();
+    XCTAssertEqual(index.Open(), 0);
+    index.Append(kDevice, MakeFile(1, 500));
+    index.Append(kDevice, MakeFile(2, 600));
+    index.Append(kDevice, MakeFile(1, 700));
+  }
+
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 2);
+  XCTAssertEqual(index.record_count(), 3);
+  XCTAssertEqual(index.torn_count(), 0);
+  VLLocalFile file;
+  XCTAssertTrue(index.Lookup(kDevice, 1, file));
+  XCTAssertEqual(file.length, 700);
+}
+
+- (void)testRecoverTornRecord {
+  Log log(4096);
+  {
+    viv::IngestIndex index = log.Index();
+    index.Open();
+    for (uint16_t i = 1; i <= 4; ++i) {
+      index.Append(kDevice, MakeFile(i, 100 * i));
+    }
+  }
+  // The third record didn't reach the file, but the fourth did.
+  size_t const third = viv::IngestIndex::kHeaderLength +
+                       2 * viv::IngestIndex::kRecordLength;
+  log.bytes[third + 10] ^= 0xff;
+
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 2);
+  XCTAssertEqual(index.torn_count(), 2);
+  VLLocalFile file;
+  XCTAssertFalse(index.Lookup(kDevice, 3, file));
+  XCTAssertFalse(index.Lookup(kDevice, 4, file));
+
+  // Appends continue from the last whole record, and the fourth record isn't
+  // resurrected.
+  index.Append(kDevice, MakeFile(5, 500));
+  viv::IngestIndex reopened = log.Index();
+  XCTAssertEqual(reopened.Open(), 3);
+  XCTAssertFalse(reopened.Lookup(kDevice, 4, file));
+  XCTAssertTrue(reopened.Lookup(kDevice, 5, file));
+}
+
+- (void)testRecoverAfterMissingRecord {
+  Log log(4096);
+  {
+    viv::IngestIndex index = log.Index();
+    index.Open();
+    for (uint16_t i = 1; i <= 4; ++i) {
+      index.Append(kDevice, MakeFile(i, 100 * i));
+    }
+  }
+  // The third record's page was never written back, but the fourth's was.
+  size_t const third = viv::IngestIndex::kHeaderLength +
+                       2 * viv::IngestIndex::kRecordLength;
+  std::memset(&log.bytes[third], 0, viv::IngestIndex::kRecordLength);
+
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 2);
+  XCTAssertEqual(index.torn_count(), 1);
+
+  // Filling the gap doesn't bring the fourth record back.
+  index.Append(kDevice, MakeFile(5, 500));
+  viv::IngestIndex reopened = log.Index();
+  XCTAssertEqual(reopened.Open(), 3);
+  XCTAssertEqual(reopened.record_count(), 3);
+  VLLocalFile file;
+  XCTAssertFalse(reopened.Lookup(kDevice, 4, file));
+  XCTAssertTrue(reopened.Lookup(kDevice, 5, file));
+}
+
+- (void)testRejectsOtherFormats {
+  Log log(4096);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+
+  Log newer(4096);
+  newer.bytes = log.bytes;
+  newer.bytes[6] = 2;
+  XCTAssertEqual(newer.Index().Open(), -2);
+
+  Log other(4096);
+  std::memcpy(other.bytes.data(), "VIVDIR", 6);
+  XCTAssertEqual(other.Index().Open(), -1);
+
+  std::vector<uint32_t> slots(4);
+  viv::IngestIndex few_slots(
+      log.bytes.data(), log.bytes.size(), slots.data(), slots.size());
+  XCTAssertLessThan(few_slots.Open(), 0);
+}
+
+- (void)testUnopenedIndexIsInert {
+  Log newer(4096);
+  XCTAssertEqual(newer.Index().Open(), 0);
+  newer.bytes[6] = 2;
+  std::vector<uint8_t> const header = newer.bytes;
+  viv::IngestIndex index = newer.Index();
+  XCTAssertEqual(index.Open(), -2);
+  XCTAssertFalse(index.is_open());
+  XCTAssertLessThan(index.Append(kDevice, MakeFile(1, 500)), 0);
+  XCTAssertLessThan(index.Forget(kDevice, 1), 0);
+  VLLocalFile file;
+  XCTAssertFalse(index.Lookup(kDevice, 1, file));
+  XCTAssertEqual(index.State(kDevice, MakeEntry(1, 500)), kVLIngestStateNew);
+  std::vector<uint8_t> dst(4096);
+  XCTAssertLessThan(index.Compact(dst.data(), dst.size()), 0);
+  XCTAssertTrue(newer.bytes == header);
+
+  Log log(4096);
+  uint32_t slot;
+  viv::IngestIndex no_slots(log.bytes.data(), log.bytes.size(), &slot, 0);
+  XCTAssertEqual(no_slots.Open(), -3);
+  XCTAssertLessThan(no_slots.Append(kDevice, MakeFile(1, 500)), 0);
+  XCTAssertFalse(no_slots.Lookup(kDevice, 1, file));
+  XCTAssertEqual(no_slots.record_count(), 0);
+}
+
+- (void)testCBridgeRejectsOtherFormats {
+  std::vector<uint8_t> bytes(4096);
+  std::vector<uint32_t> slots(VLIngestIndexSlotCount(bytes.size()));
+  std::memcpy(bytes.data(), "VIVIDX", 6);
+  bytes[6] = 2;
+  int recovered;
+  VLIngestIndex index = VLMakeIngestIndex(
+      bytes.data(), bytes.size(), slots.data(), slots.size(), &recovered);
+  XCTAssertEqual(recovered, -2);
+  XCTAssertEqual(index.index, nullptr);
+
+  uint32_t slot;
+  index = VLMakeIngestIndex(bytes.data(), bytes.size(), &slot, 0, &recovered);
+  XCTAssertLessThan(recovered, 0);
+  XCTAssertEqual(index.index, nullptr);
+}
+
+- (void)testFull {
+  size_t const capacity =
+      viv::IngestIndex::kHeaderLength + 2 * viv::IngestIndex::kRecordLength;
+  Log log(capacity);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+  XCTAssertEqual(index.Append(kDevice, MakeFile(1, 500)), 0);
+  XCTAssertEqual(index.Append(kDevice, MakeFile(2, 500)), 0);
+  XCTAssertLessThan(index.Append(kDevice, MakeFile(3, 500)), 0);
+  XCTAssertLessThan(index.Forget(kDevice, 1), 0);
+  XCTAssertEqual(index.length(), capacity);
+}
+
+- (void)testCompact {
+  Log log(64 * 1024);
+  viv::IngestIndex index = log.Index();
+  XCTAssertEqual(index.Open(), 0);
+  for (uint32_t length = 1; length <= 100; ++length) {
+    index.Append(kDevice, MakeFile(1, length));
+  }
+  index.Append(kDevice, MakeFile(2, 500));
+  index.Append(kDevice, MakeFile(3, 500));
+  index.Forget(kDevice, 3);
+  XCTAssertTrue(index.ShouldCompact());
+
+  Log compacted(4096);
+  int const length =
+      index.Compact(compacted.bytes.data(), compacted.bytes.size());
+  XCTAssertEqual(
+      length,
+      viv::IngestIndex::kHeaderLength + 2 * viv::IngestIndex::kRecordLength);
+
+  viv::IngestIndex reopened = compacted.Index();
+  XCTAssertEqual(reopened.Open(), 2);
+  XCTAssertFalse(reopened.ShouldCompact());
+  VLLocalFile file;
+  XCTAssertTrue(reopened.Lookup(kDevice, 1, file));
+  XCTAssertEqual(file.length, 100);
+  XCTAssertTrue(reopened.Lookup(kDevice, 2, file));
+  XCTAssertFalse(reopened.Lookup(kDevice, 3, file));
+  XCTAssertEqual(reopened.Append(kDevice, MakeFile(4, 500)), 0);
+
+  Log tiny(64);
+  XCTAssertLessThan(index.Compact(tiny.bytes.data(), tiny.bytes.size()), 0);
+}
+
+- (void)testCBridge {
+  std::vector<uint8_t> bytes(4096);
+  std::vector<uint32_t> slots(VLIngestIndexSlotCount(bytes.size()));
+  int recovered;
+  VLIngestIndex index = VLMakeIngestIndex(
+      bytes.data(), bytes.size(), slots.data(), slots.size(), &recovered);
+  XCTAssertEqual(recovered, 0);
+  XCTAssertEqual(VLIngestIndexAppend(index, &kDevice, MakeFile(1, 500)), 0);
+  XCTAssertEqual(
+      VLIngestIndexState(index, &kDevice, MakeEntry(1, 800)),
+      kVLIngestStatePartial);
+
+  // A plan resumes the file from what was ingested.
+  std::vector<uint8_t> directory(32);
+  directory[0] = 1;
+  directory[1] = 16;
+  uint8_t *const p = &directory[16];
+  VLWriteLittleInt16(p, 0, 1);
+  p[2] = 0x80;
+  p[3] = 0x04;
+  p[7] = viv::kReadable;
+  VLWriteLittleInt32(p + 8, 0, 800);
+  VLWriteLittleInt32(p + 12, 0, 1001);
+  VLSyncPolicy policy = VLSyncDefaultPolicy();
+  policy.clock_offset = 0;
+  VLSyncStep steps[2];
+  XCTAssertEqual(
+      VLPlanSyncWithIngestIndex(
+          directory.data(), directory.size(), index, &kDevice, &policy, steps,
+          2),
+      1);
+  XCTAssertEqual(steps[0].action, kVLSyncActionResume);
+  XCTAssertEqual(steps[0].offset, 500);
+
+  XCTAssertEqual(VLIngestIndexForget(index, &kDevice, 1), 0);
+  VLLocalFile file;
+  XCTAssertFalse(VLIngestIndexLookup(index, &kDevice, 1, &file));
+  XCTAssertFalse(VLIngestIndexShouldCompact(index));
+  VLDeleteIngestIndex(index);
+}
+
+- (void)testNoAllocations {
+  Log log(64 * 1024);
+  viv::IngestIndex index = log.Index();
+
+  vivtest::AllocationTracker tracker;
+  index.Open();
+  for (uint16_t i = 1; i <= 100; ++i) {
+    index.Append(kDevice, MakeFile(i, 500));
+  }
+  int ingested = 0;
+  for (uint16_t i = 1; i <= 200; ++i) {
+    ingested +=
+        index.State(kDevice, MakeEntry(i, 500)) == kVLIngestStateIngested;
+  }
+  VLAssertAllocationBudget(tracker, 0);
+  XCTAssertEqual(ingested, 100);
+}
+
+@end
@@ -0,0 +1,138 @@
+// IngressQueueTests.mm - unit tests for viv/ingress_queue.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "viv/ingress_queue.hpp"
+#include "viv/manager.hpp"
+
+namespace {
+
+/// Delegate that counts calls to DidFinishWaiting.
+class FinishCountingDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override { return 0; }
+  void DidStartWaiting() const override {}
+  void DidFinishWaiting() const override { ++finishes; }
+  void DidError(VLManagerErrorCode code, char const *msg) const override {}
+
+  mutable int finishes = 0;
+};
+
+} // namespace
+
+@interface IngressQueueTests : XCTestCase
+
+@end
+
+@implementation IngressQueueTests
+
+- (void)testPushPop {
+  viv::IngressQueue<4> queue;
+  uint8_t const a[] = {1, 2, 3};
+  uint8_t const b[] = {4};
+  XCTAssertTrue(queue.Push(a, sizeof(a)));
+  XCTAssertTrue(queue.Push(b, sizeof(b)));
+
+  uint8_t value[kVLPacketMaxLength];
+  XCTAssertEqual(queue.Pop(value), 3);
+  XCTAssertEqual(memcmp(value, a, sizeof(a)), 0);
+  XCTAssertEqual(queue.Pop(value), 1);
+  XCTAssertEqual(value[0], 4);
+  XCTAssertLessThan(queue.Pop(value), 0);
+}
+
+- (void)testFull {
+  viv::IngressQueue<2> queue;
+  uint8_t const a[] = {1};
+  XCTAssertTrue(queue.Push(a, sizeof(a)));
+  XCTAssertTrue(queue.Push(a, sizeof(a)));
+  XCTAssertFalse(queue.Push(a, sizeof(a)));
+
+  uint8_t value[kVLPacketMaxLength];
+  XCTAssertEqual(queue.Pop(value), 1);
+  XCTAssertTrue(queue.Push(a, sizeof(a)));
+}
+
+- (void)testTooLong {
+  viv::IngressQueue<2> queue;
+  uint8_t const a[kVLPacketMaxLength + 1] = {0};
+  XCTAssertFalse(queue.Push(a, sizeof(a)));
+}
+
+- (void)testConcurrentProducers {
+  constexpr int kProducers = 4;
+  constexpr int kValuesPerProducer = 10000;
+  viv::IngressQueue<16> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kValuesPerProducer; ++i) {
+        uint8_t const value[] = {
+            static_cast<uint8_t>(p), static_cast<uint8_t>(i),
+            static_cast<uint8_t>(i >> 8)};
+        while (!queue.Push(value, sizeof(value))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Values from each producer must arrive in order.
+  int next[kProducers] = {0};
+  bool inOrder = true;
+  for (int received = 0; received < kProducers * kValuesPerProducer;) {
+    uint8_t value[kVLPacketMaxLength];
+    if (queue.Pop(value) < 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    int const i = value[1] | (value[2] << 8);
+    inOrder = inOrder && (i == next[value[0]]);
+    ++next[value[0]];
+    ++received;
+  }
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  XCTAssertTrue(inOrder);
+}
+
+- (void)testManagerDrainValues {
+  auto delegate = std::make_unique<FinishCountingDelegate>();
+  auto *d = delegate.get();
+  viv::Manager manager(std::move(delegate));
+
+  manager.SetTime(0x12345678);
+  uint8_t const writeAck[] = {0xed, 0, 1, 3, 0x08, 0x81};
+  std::thread radio(
+      [&manager, &writeAck]() { manager.EnqueueValue(writeAck, 6); });
+  radio.join();
+
+  XCTAssertEqual(d->finishes, 0);
+  XCTAssertEqual(manager.DrainValues(10), 1);
+  XCTAssertEqual(d->finishes, 1);
+  XCTAssertEqual(manager.DrainValues(10), 0);
+}
+
+@end
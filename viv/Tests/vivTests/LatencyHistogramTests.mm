@@ -0,0 +1,169 @@
+// LatencyHistogramTests.mm - unit tests for viv/latency_histogram.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "viv/latency.h"
+#include "viv/latency_histogram.hpp"
+#include "viv/manager.hpp"
+
+namespace {
+
+/// Delegate that ignores all callbacks.
+class NullDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override { return 0; }
+  void DidStartWaiting() const override {}
+  void DidFinishWaiting() const override {}
+  void DidError(VLManagerErrorCode code, char const *msg) const override {}
+};
+
+/// Clock that only advances when told to.
+struct FakeClock {
+  uint64_t operator()() const { return now; }
+
+  uint64_t now = 0;
+};
+
+} // namespace
+
+@interface LatencyHistogramTests : XCTestCase
+
+@end
+
+@implementation LatencyHistogramTests
+
+- (void)testBuckets {
+  using viv::LatencyHistogram;
+  for (uint64_t value : {0ULL, 7ULL, 8ULL, 17ULL, 1000ULL, 123456789ULL,
+                         0xffffffffffffffffULL}) {
+    size_t const bucket = LatencyHistogram::BucketForValue(value);
+    XCTAssertLessThan(bucket, LatencyHistogram::kNumBuckets);
+    XCTAssertLessThanOrEqual(LatencyHistogram::LowerBound(bucket), value);
+    XCTAssertGreaterThanOrEqual(LatencyHistogram::UpperBound(bucket), value);
+  }
+  XCTAssertEqual(LatencyHistogram::BucketForValue(7), 7);
+  XCTAssertEqual(LatencyHistogram::BucketForValue(16), 16);
+  XCTAssertEqual(LatencyHistogram::BucketForValue(17), 16);
+  XCTAssertEqual(LatencyHistogram::LowerBound(17), 18);
+  XCTAssertEqual(
+      LatencyHistogram::BucketForValue(0xffffffffffffffffULL),
+      LatencyHistogram::kNumBuckets - 1);
+}
+
+- (void)testPercentile {
+  viv::LatencyHistogram histogram;
+  XCTAssertEqual(histogram.ValueAtPercentile(50), 0);
+
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.Record(value);
+  }
+  XCTAssertEqual(histogram.count(), 100);
+  XCTAssertEqual(histogram.ValueAtPercentile(0), 1);
+  XCTAssertEqual(histogram.ValueAtPercentile(50), 51);
+  XCTAssertEqual(histogram.ValueAtPercentile(100), 103);
+}
+
+- (void)testMerge {
+  viv::LatencyHistogram a;
+  viv::LatencyHistogram b;
+  a.Record(10);
+  b.Record(10);
+  b.Record(1000);
+
+  a.Merge(b);
+  XCTAssertEqual(a.count(), 3);
+  XCTAssertEqual(a.counts()[viv::LatencyHistogram::BucketForValue(10)], 2);
+}
+
+- (void)testManagerDownloadFile {
+  FakeClock clock;
+  viv::LatencyRecorder recorder{viv::LatencyRecorder::Clock(clock)};
+  viv::Manager manager(std::make_unique<NullDelegate>());
+  manager.SetLatencyRecorder(&recorder);
+
+  std::vector<uint8_t> const ack = {
+      0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0};
+  std::vector<uint8_t> const reply0 = {
+      0x1a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+      14};
+  std::vector<uint8_t> const reply1 = {
+      0xe7, 14, 1, 3, 0x0b, 0x03, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+      26, 27, 28};
+
+  clock.now = 100;
+  manager.DownloadFile(0x1234);
+  clock.now = 105;
+  manager.NotifyValue(ack.data(), ack.size());
+  clock.now = 107;
+  manager.NotifyValue(reply0.data(), reply0.size());
+  clock.now = 110;
+  manager.NotifyValue(reply1.data(), reply1.size());
+
+  auto const kind = kVLLatencyKindDownloadFile;
+  auto const &ackHistogram = recorder.histogram(kind, kVLLatencyStageAck);
+  XCTAssertEqual(ackHistogram.count(), 1);
+  XCTAssertEqual(ackHistogram.ValueAtPercentile(100), 5);
+  XCTAssertEqual(
+      recorder.histogram(kind, kVLLatencyStageFirstPacket)
+          .ValueAtPercentile(100),
+      2);
+  XCTAssertEqual(
+      recorder.histogram(kind, kVLLatencyStagePacketGap).ValueAtPercentile(100),
+      3);
+  XCTAssertEqual(
+      recorder.histogram(kind, kVLLatencyStageTotal).ValueAtPercentile(100),
+      10);
+  // 10 * 1024 / 28 = 365, which is in the bucket [352, 383].
+  XCTAssertEqual(
+      recorder.histogram(kind, kVLLatencyStageTotalPerKiB)
+          .ValueAtPercentile(100),
+      383);
+  XCTAssertEqual(
+      recorder.histogram(kVLLatencyKindSetTime, kVLLatencyStageAck).count(), 0);
+}
+
+- (void)testCBridge {
+  VLLatencyRecorder a = VLMakeLatencyRecorder(
+      nullptr, [](void *_Nullable ctx) -> uint64_t { return 0; });
+  VLLatencyRecorder b = VLMakeLatencyRecorder(
+      nullptr, [](void *_Nullable ctx) -> uint64_t { return 0; });
+
+  uint64_t counts[viv::LatencyHistogram::kNumBuckets] = {0};
+  counts[3] = 2;
+  VLLatencyRecorderAddBuckets(
+      b, kVLLatencyKindEraseFile, kVLLatencyStageTotal, counts, 4);
+  VLLatencyRecorderMerge(a, b);
+  XCTAssertEqual(
+      VLLatencyRecorderCount(a, kVLLatencyKindEraseFile, kVLLatencyStageTotal),
+      2);
+
+  uint64_t copy[4];
+  XCTAssertEqual(
+      VLLatencyRecorderCopyBuckets(
+          a, kVLLatencyKindEraseFile, kVLLatencyStageTotal, copy, 4),
+      viv::LatencyHistogram::kNumBuckets);
+  XCTAssertEqual(copy[3], 2);
+  XCTAssertEqual(VLLatencyBucketLowerBound(3), 3);
+
+  VLDeleteLatencyRecorder(a);
+  VLDeleteLatencyRecorder(b);
+}
+
+@end
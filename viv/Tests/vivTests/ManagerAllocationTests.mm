@@ -0,0 +1,178 @@
+// ManagerAllocationTests.mm - heap allocation tests for viv/manager.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "viv/manager.hpp"
+
+namespace {
+
+/// Delegate that records callbacks without allocating.
+class CountingDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override {
+    ++writes;
+    return 0;
+  }
+
+  void DidStartWaiting() const override {}
+
+  void DidFinishWaiting() const override { ++finishes; }
+
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
+    ++errors;
+  }
+
+  void DidParseDirectoryEntry(VLDirectoryEntry entry) const override {
+    ++entries;
+  }
+
+  int writes = 0;
+  mutable int finishes = 0;
+  mutable int errors = 0;
+  mutable int entries = 0;
+};
+
+/// Notifies \p manager of each value in \p values.
+template <size_t N>
+void
+NotifyValues(viv::Manager &manager, std::vector<uint8_t> const (&values)[N]) {
+  for (auto const &value : values) {
+    manager.NotifyValue(value.data(), value.size());
+  }
+}
+
+} // namespace
+
+@interface ManagerAllocationTests : XCTestCase
+
+@end
+
+@implementation ManagerAllocationTests {
+  uint8_t _buffer[256];
+  CountingDelegate *_delegate;
+  std::unique_ptr<viv::Manager> _manager;
+  std::unique_ptr<vivtest::AllocationTracker> _tracker;
+}
+
+- (void)setUp {
+  auto delegate = std::make_unique<CountingDelegate>();
+  _delegate = delegate.get();
+  _manager = std::make_unique<viv::Manager>(
+      std::move(delegate), _buffer, sizeof(_buffer));
+  _tracker = std::make_unique<vivtest::AllocationTracker>();
+}
+
+- (void)tearDown {
+  _tracker.reset();
+  _manager.reset();
+}
+
+- (void)testDownloadFile {
+  std::vector<uint8_t> const values[] = {
+      {0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0},
+      {0x1a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+      {0xe7, 14, 1, 3, 0x0b, 0x03, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+       26, 27, 28},
+  };
+  _tracker->Reset();
+
+  _manager->DownloadFile(0x1234);
+  NotifyValues(*_manager, values);
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->finishes, 1);
+  XCTAssertEqual(_delegate->errors, 0);
+}
+
+- (void)testDownloadFileTooBig {
+  // Specifies a file bigger than the buffer.
+  std::vector<uint8_t> const values[] = {
+      {0xe4, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 0, 2, 0, 0},
+  };
+  _tracker->Reset();
+
+  _manager->DownloadFile(0x1234);
+  NotifyValues(*_manager, values);
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->errors, 1);
+}
+
+- (void)testEraseFile {
+  std::vector<uint8_t> const values[] = {
+      {0xe9, 0, 1, 3, 0x0b, 0x84},
+      {0xfc, 1, 1, 3, 0x0b, 0x05, 0},
+  };
+  _tracker->Reset();
+
+  _manager->EraseFile(1);
+  NotifyValues(*_manager, values);
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->writes, 2);
+  XCTAssertEqual(_delegate->finishes, 1);
+}
+
+- (void)testSetTime {
+  std::vector<uint8_t> const values[] = {
+      {0xed, 0, 1, 3, 0x08, 0x81},
+  };
+  _tracker->Reset();
+
+  _manager->SetTime(0x12345678);
+  NotifyValues(*_manager, values);
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->finishes, 1);
+}
+
+- (void)testErrors {
+  uint8_t const bad[] = {0xff, 0, 1, 3, 0x08, 0x81};
+  _manager->NotifyValue(bad, sizeof(bad));
+  _manager->SetTime(0x12345678);
+  _manager->NotifyValue(bad, sizeof(bad));
+  _manager->NotifyTimeout();
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->errors, 3);
+}
+
+- (void)testDownloadDirectory {
+  std::vector<uint8_t> const values[] = {
+      {0xff, 10, 1, 3, 0x0b, 0x81, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0},
+      {0x1f, 14, 1, 3, 0x0b, 0x03, 1, 0x10, 0, 0, 0, 0, 0, 0, 0x12, 0x34, 0x56,
+       0x78, 0, 0},
+      {0x3e, 14, 1, 3, 0x0b, 0x03, 0, 0, 2, 0, 0x80, 4, 2, 0, 0, 0x60, 28, 0, 0,
+       0},
+      {0xe2, 4, 1, 3, 0x0b, 0x03, 0x11, 0x34, 0x56, 0x78},
+  };
+  _tracker->Reset();
+
+  _manager->DownloadDirectory();
+  NotifyValues(*_manager, values);
+
+  VLAssertAllocationBudget(*_tracker, 0);
+  XCTAssertEqual(_delegate->entries, 1);
+}
+
+@end
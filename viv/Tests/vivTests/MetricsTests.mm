@@ -0,0 +1,226 @@
+// MetricsTests.mm - unit tests for viv/metrics.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "viv/manager.hpp"
+#include "viv/manager_metrics.h"
+#include "viv/metrics.hpp"
+
+namespace {
+
+/// Delegate that ignores all callbacks.
+class NullDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override { return 0; }
+  void DidStartWaiting() const override {}
+  void DidFinishWaiting() const override {}
+  void DidError(VLManagerErrorCode code, char const *msg) const override {}
+};
+
+/// Delegate that snapshots its manager's metrics from its callbacks.
+class SnapshotDelegate final : public viv::ManagerDelegate {
+public:
+  int WriteValue(uint8_t const *value, size_t length) override { return 0; }
+  void DidStartWaiting() const override {}
+
+  void DidFinishWaiting() const override {
+    finished = manager->SnapshotMetrics();
+  }
+
+  void DidError(VLManagerErrorCode code, char const *msg) const override {
+    errored = manager->SnapshotMetrics();
+  }
+
+  void DidDownloadFile(
+      uint16_t index, uint8_t const *data, size_t length) const override {
+    downloaded = manager->SnapshotMetrics();
+  }
+
+  viv::Manager *manager = nullptr;
+  mutable VLManagerMetrics finished = {};
+  mutable VLManagerMetrics errored = {};
+  mutable VLManagerMetrics downloaded = {};
+};
+
+/// Notifies \p manager of each value in \p values.
+template <size_t N>
+void
+NotifyValues(viv::Manager &manager, std::vector<uint8_t> const (&values)[N]) {
+  for (auto const &value : values) {
+    manager.NotifyValue(value.data(), value.size());
+  }
+}
+
+} // namespace
+
+@interface MetricsTests : XCTestCase
+
+@end
+
+@implementation MetricsTests
+
+- (void)testDownloadFile {
+  viv::Manager manager(std::make_unique<NullDelegate>());
+  std::vector<uint8_t> const values[] = {
+      {0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0},
+      // Bad CRC.
+      {0x1b, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+      {0x1a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+      {0xe7, 14, 1, 3, 0x0b, 0x03, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+       26, 27, 28},
+  };
+
+  manager.DownloadFile(0x1234);
+  NotifyValues(manager, values);
+
+  VLManagerMetrics const metrics = manager.SnapshotMetrics();
+  XCTAssertEqual(metrics.packets_received, 4);
+  XCTAssertEqual(metrics.packets_sent, 1);
+  XCTAssertEqual(metrics.crc_failures, 1);
+  XCTAssertEqual(metrics.length_failures, 0);
+  XCTAssertEqual(metrics.acks, 1);
+  XCTAssertEqual(metrics.bytes_downloaded, 28);
+  XCTAssertEqual(metrics.commands_completed, 1);
+  XCTAssertEqual(metrics.commands_failed, 1);
+}
+
+- (void)testSnapshotFromCallbacks {
+  auto delegate = std::make_unique<SnapshotDelegate>();
+  SnapshotDelegate *const callbacks = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  callbacks->manager = &manager;
+  std::vector<uint8_t> const values[] = {
+      {0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0},
+      // Bad CRC.
+      {0x1b, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+      {0x1a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+      {0xe7, 14, 1, 3, 0x0b, 0x03, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+       26, 27, 28},
+  };
+
+  // Snapshots on the manager's own thread, while it's calling back, must not
+  // wait for the update in progress.
+  manager.DownloadFile(0x1234);
+  NotifyValues(manager, values);
+  XCTAssertEqual(callbacks->errored.packets_received, 2);
+  XCTAssertEqual(callbacks->errored.crc_failures, 1);
+  XCTAssertEqual(callbacks->downloaded.packets_received, 4);
+  XCTAssertEqual(callbacks->downloaded.bytes_downloaded, 28);
+  XCTAssertEqual(callbacks->finished.commands_completed, 1);
+
+  manager.NotifyTimeout();
+  manager.DownloadFile(0x1234);
+  manager.NotifyTimeout();
+  XCTAssertEqual(callbacks->errored.timeouts, 1);
+}
+
+- (void)testSeqnoError {
+  viv::Manager manager(std::make_unique<NullDelegate>());
+  std::vector<uint8_t> const values[] = {
+      {0xfd, 10, 1, 3, 0x0b, 0x81, 0x34, 0x12, 0, 0, 0, 0, 28, 0, 0, 0},
+      // Skips seqno 0.
+      {0x3a, 14, 1, 3, 0x0b, 0x03, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+       14},
+  };
+
+  manager.DownloadFile(0x1234);
+  NotifyValues(manager, values);
+  manager.NotifyTimeout();
+
+  VLManagerMetrics const metrics = manager.SnapshotMetrics();
+  XCTAssertEqual(metrics.seqno_errors, 1);
+  XCTAssertEqual(metrics.timeouts, 1);
+  XCTAssertEqual(metrics.commands_failed, 1);
+  XCTAssertEqual(metrics.commands_completed, 0);
+}
+
+- (void)testConsistentSnapshot {
+  viv::Metrics metrics;
+  std::atomic<bool> done(false);
+
+  // The writer always updates two counters together.
+  std::thread writer([&metrics, &done]() {
+    for (int i = 0; i < 100000; ++i) {
+      viv::Metrics::Update update(metrics);
+      metrics.Add(viv::Metrics::kPacketsSent);
+      metrics.Add(viv::Metrics::kAcks);
+    }
+    done = true;
+  });
+
+  bool consistent = true;
+  while (!done) {
+    VLManagerMetrics const snapshot = metrics.Snapshot();
+    consistent = consistent && (snapshot.packets_sent == snapshot.acks);
+  }
+  writer.join();
+
+  XCTAssertTrue(consistent);
+  XCTAssertEqual(metrics.Snapshot().acks, 100000);
+}
+
+- (void)testAggregator {
+  VLManagerMetrics a = {};
+  a.packets_received = 3;
+  a.timeouts = 1;
+  VLManagerMetrics b = {};
+  b.packets_received = 4;
+
+  viv::MetricsAggregator aggregator;
+  aggregator.Add(a);
+  aggregator.Add(b);
+
+  XCTAssertEqual(aggregator.count(), 2);
+  XCTAssertEqual(aggregator.total().packets_received, 7);
+  XCTAssertEqual(aggregator.total().timeouts, 1);
+}
+
+- (void)testFormat {
+  VLManagerMetrics metrics = {};
+  metrics.packets_received = 7;
+
+  size_t const length = VLFormatManagerMetrics(&metrics, nullptr, 0);
+  std::vector<char> text(length + 1);
+  XCTAssertEqual(
+      VLFormatManagerMetrics(&metrics, text.data(), text.size()), length);
+  XCTAssertEqual(std::strlen(text.data()), length);
+  XCTAssertTrue(
+      std::strstr(
+          text.data(), "# TYPE viv_packets_received counter\n"
+                       "# HELP viv_packets_received Value notifications "
+                       "received.\n"
+                       "viv_packets_received_total 7\n") != nullptr);
+  XCTAssertEqual(std::strcmp(text.data() + length - 6, "# EOF\n"), 0);
+
+  // Truncated output is still terminated.
+  char small[8];
+  XCTAssertEqual(VLFormatManagerMetrics(&metrics, small, sizeof(small)),
+                 length);
+  XCTAssertEqual(std::strlen(small), sizeof(small) - 1);
+}
+
+@end
@@ -47,4 +47,21 @@
   XCTAssertEqual(entry.subtype, 4);
 }
 
+- (void)testDirectoryFingerprint {
+  uint8_t src[] = {
+      1, 16, 0, 0, 0, 0, 0, 0, 0x12, 0x34, 0x14, 0x39, 0, 0, 0, 0,
+      2, 0, 16, 4, 2, 0, 0, 96, 192, 1, 0, 0, 0x12, 0x34, 0x14, 0x39,
+  };
+  XCTAssertEqual(VLDirectoryFingerprint(src, 16), 0x79bf0d34U);
+  uint32_t const fingerprint = VLDirectoryFingerprint(src, sizeof(src));
+
+  // The clock is ignored.
+  src[8] = 0x13;
+  XCTAssertEqual(VLDirectoryFingerprint(src, sizeof(src)), fingerprint);
+
+  // Entries are not.
+  src[24] = 193;
+  XCTAssertNotEqual(VLDirectoryFingerprint(src, sizeof(src)), fingerprint);
+}
+
 @end
@@ -0,0 +1,141 @@
+// SchedulerTests.mm - unit tests for vivsim/scheduler.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "viv/manager.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+@interface SchedulerTests : XCTestCase
+
+@end
+
+@implementation SchedulerTests
+
+- (void)testOrder {
+  vivsim::Scheduler scheduler;
+  std::vector<int> order;
+  scheduler.Schedule(20, [&order]() { order.push_back(3); });
+  scheduler.Schedule(10, [&order]() { order.push_back(1); });
+  scheduler.Schedule(10, [&order]() { order.push_back(2); });
+
+  XCTAssertEqual(scheduler.Run(), 3);
+  XCTAssertTrue(order == std::vector<int>({1, 2, 3}));
+  XCTAssertEqual(scheduler.now(), 20);
+}
+
+- (void)testCancel {
+  vivsim::Scheduler scheduler;
+  bool ran = false;
+  auto const id = scheduler.Schedule(10, [&ran]() { ran = true; });
+  XCTAssertTrue(scheduler.Cancel(id));
+  XCTAssertFalse(scheduler.Cancel(id));
+  XCTAssertEqual(scheduler.Run(), 0);
+  XCTAssertFalse(ran);
+}
+
+- (void)testRunUntil {
+  vivsim::Scheduler scheduler;
+  int runs = 0;
+  scheduler.Schedule(5, [&runs]() { ++runs; });
+  scheduler.Schedule(50, [&runs]() { ++runs; });
+
+  XCTAssertEqual(scheduler.RunUntil(10), 1);
+  XCTAssertEqual(scheduler.now(), 10);
+  XCTAssertEqual(scheduler.pending(), 1);
+}
+
+- (void)testTasksScheduleTasks {
+  vivsim::Scheduler scheduler;
+  scheduler.set_logging(true);
+  scheduler.Schedule(
+      1, [&scheduler]() { scheduler.Schedule(2, []() {}, "inner"); },
+      "outer");
+
+  XCTAssertEqual(scheduler.Run(), 2);
+  XCTAssertEqual(scheduler.log().size(), 2);
+  XCTAssertEqual(std::strcmp(scheduler.log()[1].label, "inner"), 0);
+  XCTAssertEqual(scheduler.log()[1].time, 3);
+}
+
+- (void)testTimer {
+  vivsim::Scheduler scheduler;
+  int fires = 0;
+  vivsim::Timer timer(scheduler, 100, [&fires]() { ++fires; });
+
+  timer.Start();
+  scheduler.RunUntil(60);
+  timer.Start();
+  scheduler.RunUntil(120);
+  XCTAssertEqual(fires, 0);
+  scheduler.Run();
+  XCTAssertEqual(fires, 1);
+  XCTAssertEqual(scheduler.now(), 160);
+  XCTAssertFalse(timer.armed());
+}
+
+- (void)testSeed {
+  vivsim::Scheduler a(42);
+  vivsim::Scheduler b(42);
+  XCTAssertEqual(a.rng()(), b.rng()());
+}
+
+- (void)testManagerTimeout {
+  vivsim::Scheduler scheduler;
+  // The device never responds.
+  auto delegate = std::make_unique<vivsim::HostDelegate>(
+      scheduler, [](uint8_t const *value, size_t length) { return 0; });
+  auto *host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+
+  // An hour of timed-out commands runs instantly.
+  for (int i = 0; i < 225; ++i) {
+    manager.SetTime(0);
+    XCTAssertTrue(host->waiting());
+    scheduler.Run();
+    XCTAssertFalse(host->waiting());
+  }
+
+  XCTAssertEqual(host->timeouts(), 225);
+  XCTAssertEqual(host->errors(), 225);
+  XCTAssertEqual(scheduler.now(), 3600 * vivsim::kSecond);
+}
+
+- (void)testManagerDeliver {
+  vivsim::Scheduler scheduler;
+  auto delegate = std::make_unique<vivsim::HostDelegate>(
+      scheduler, [](uint8_t const *value, size_t length) { return 0; });
+  auto *host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+
+  manager.SetTime(0);
+  uint8_t const writeAck[] = {0xed, 0, 1, 3, 0x08, 0x81};
+  host->Deliver(30 * vivsim::kMillisecond, writeAck, sizeof(writeAck));
+  scheduler.Run();
+
+  XCTAssertEqual(host->set_time_count(), 1);
+  XCTAssertEqual(host->timeouts(), 0);
+  XCTAssertEqual(scheduler.now(), 30 * vivsim::kMillisecond);
+}
+
+@end
@@ -0,0 +1,280 @@
+// SyncPlanTests.mm - unit tests for viv/sync_plan.hpp
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <XCTest/XCTest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "DirectoryFixture.hpp"
+#include "viv/directory.hpp"
+#include "viv/manager.hpp"
+#include "viv/sync_plan.h"
+#include "viv/sync_plan.hpp"
+#include "viv/vivtime.h"
+#include "vivsim/device.hpp"
+#include "vivsim/host.hpp"
+#include "vivsim/scheduler.hpp"
+
+namespace {
+
+using File = vivtest::DirectoryFile;
+using vivtest::MakeDirectory;
+
+/// Returns the local record of a completely ingested \p file.
+VLLocalFile
+Ingested(File const &file) {
+  return VLLocalFile{
+      file.index, VLGetPosixTimeFromViva(file.viva_time), file.length, 1};
+}
+
+/// Returns a policy that never sets the clock.
+VLSyncPolicy
+ClockIsRight() {
+  VLSyncPolicy policy = VLSyncDefaultPolicy();
+  policy.clock_offset = 0;
+  return policy;
+}
+
+std::vector<VLSyncStep>
+Plan(
+    std::vector<File> const &files, std::vector<VLLocalFile> const &local,
+    VLSyncPolicy const &policy) {
+  auto const directory = MakeDirectory(files);
+  std::vector<VLSyncStep> steps(files.size() + 1);
+  int const count = VLPlanSync(
+      directory.data(), directory.size(), local.data(), local.size(), &policy,
+      steps.data(), steps.size());
+  steps.resize(count < 0 ? 0 : count);
+  return steps;
+}
+
+} // namespace
+
+@interface SyncPlanTests : XCTestCase
+
+@end
+
+@implementation SyncPlanTests
+
+- (void)testNothingToDo {
+  File const a = {1, 100, 500};
+  auto const steps = Plan({a}, {Ingested(a)}, ClockIsRight());
+  XCTAssertTrue(steps.empty());
+}
+
+- (void)testNewFilesOldestFirst {
+  auto const steps =
+      Plan({{1, 300, 10}, {2, 100, 20}, {3, 200, 30}}, {}, ClockIsRight());
+  XCTAssertEqual(steps.size(), 3);
+  for (auto const &step : steps) {
+    XCTAssertEqual(step.action, kVLSyncActionDownload);
+    XCTAssertEqual(step.offset, 0);
+  }
+  XCTAssertEqual(steps[0].entry.index, 2);
+  XCTAssertEqual(steps[1].entry.index, 3);
+  XCTAssertEqual(steps[2].entry.index, 1);
+  XCTAssertEqual(steps[0].entry.length, 20);
+}
+
+- (void)testResumesGrownFile {
+  File const grown = {1, 100, 800};
+  VLLocalFile local = Ingested(grown);
+  local.length = 500;
+  auto const steps = Plan({grown, {2, 50, 10}}, {local}, ClockIsRight());
+  XCTAssertEqual(steps.size(), 2);
+  XCTAssertEqual(steps[0].action, kVLSyncActionResume);
+  XCTAssertEqual(steps[0].entry.index, 1);
+  XCTAssertEqual(steps[0].offset, 500);
+  XCTAssertEqual(steps[1].action, kVLSyncActionDownload);
+}
+
+- (void)testDownloadsUnusableCopies {
+  File const replaced = {1, 200, 500};
+  File const shrunk = {2, 100, 400};
+  File const unverified = {3, 100, 500};
+  VLLocalFile a = Ingested(replaced);
+  a.posix_time = VLGetPosixTimeFromViva(100);
+  VLLocalFile b = Ingested(shrunk);
+  b.length = 500;
+  VLLocalFile c = Ingested(unverified);
+  c.checksum = 0;
+  c.length = 100;
+
+  auto const steps =
+      Plan({replaced, shrunk, unverified}, {a, b, c}, ClockIsRight());
+  XCTAssertEqual(steps.size(), 3);
+  for (auto const &step : steps) {
+    XCTAssertEqual(step.action, kVLSyncActionDownload);
+    XCTAssertEqual(step.offset, 0);
+  }
+}
+
+- (void)testErasesIngested {
+  File const done = {1, 100, 500};
+  File const locked = {2, 100, 500, viv::kReadable};
+  File const fresh = {3, 200, 500};
+  VLSyncPolicy policy = ClockIsRight();
+  policy.erase_ingested = 1;
+  auto const steps =
+      Plan({done, locked, fresh}, {Ingested(done), Ingested(locked)}, policy);
+  XCTAssertEqual(steps.size(), 2);
+  XCTAssertEqual(steps[0].action, kVLSyncActionDownload);
+  XCTAssertEqual(steps[0].entry.index, 3);
+  XCTAssertEqual(steps[1].action, kVLSyncActionErase);
+  XCTAssertEqual(steps[1].entry.index, 1);
+}
+
+- (void)testFilter {
+  VLSyncPolicy policy = ClockIsRight();
+  policy.filter.min_length = 100;
+  File unreadable = {3, 100, 500, 0};
+  auto const steps =
+      Plan({{1, 100, 50}, {2, 100, 500}, unreadable}, {}, policy);
+  XCTAssertEqual(steps.size(), 1);
+  XCTAssertEqual(steps[0].entry.index, 2);
+}
+
+- (void)testSetsClockLast {
+  VLSyncPolicy policy = VLSyncDefaultPolicy();
+  policy.clock_offset = 10;
+  auto steps = Plan({{1, 100, 500}}, {}, policy);
+  XCTAssertEqual(steps.size(), 2);
+  XCTAssertEqual(steps[1].action, kVLSyncActionSetTime);
+
+  // Nothing is known about the clock.
+  policy = VLSyncDefaultPolicy();
+  XCTAssertTrue(std::isnan(policy.clock_offset));
+  steps = Plan({}, {}, policy);
+  XCTAssertEqual(steps.size(), 1);
+  XCTAssertEqual(steps[0].action, kVLSyncActionSetTime);
+}
+
+- (void)testCapacity {
+  auto const directory = MakeDirectory({{1, 100, 10}, {2, 200, 20}});
+  VLSyncPolicy const policy = ClockIsRight();
+  VLSyncStep steps[1] = {};
+  XCTAssertEqual(
+      VLPlanSync(
+          directory.data(), directory.size(), nullptr, 0, &policy, steps, 1),
+      2);
+  XCTAssertEqual(steps[0].entry.index, 0);
+  XCTAssertEqual(
+      VLPlanSync(
+          directory.data(), directory.size(), nullptr, 0, &policy, nullptr, 0),
+      2);
+}
+
+- (void)testInvalid {
+  auto const directory = MakeDirectory({{1, 100, 10}, {2, 200, 20}});
+  VLSyncPolicy const policy = ClockIsRight();
+  VLSyncStep steps[3];
+  VLLocalFile const unsorted[] = {
+      {2, 0, 0, 0},
+      {1, 0, 0, 0},
+  };
+  XCTAssertLessThan(
+      VLPlanSync(
+          directory.data(), directory.size(), unsorted, 2, &policy, steps, 3),
+      0);
+  XCTAssertLessThan(
+      VLPlanSync(
+          directory.data(), directory.size() - 1, nullptr, 0, &policy, steps,
+          3),
+      0);
+}
+
+- (void)testNoAllocations {
+  std::vector<File> files;
+  std::vector<VLLocalFile> local;
+  for (uint16_t i = 1; i <= 100; ++i) {
+    files.push_back({i, static_cast<uint32_t>(1000 - i), 100u * i});
+    if (i % 2) {
+      local.push_back(Ingested(files.back()));
+    }
+  }
+  auto const directory = MakeDirectory(files);
+  VLSyncPolicy policy = ClockIsRight();
+  policy.erase_ingested = 1;
+  std::vector<VLSyncStep> steps(files.size() + 1);
+
+  vivtest::AllocationTracker tracker;
+  int const count = VLPlanSync(
+      directory.data(), directory.size(), local.data(), local.size(), &policy,
+      steps.data(), steps.size());
+  VLAssertAllocationBudget(tracker, 0);
+  XCTAssertEqual(count, 100);
+}
+
+- (void)testRunPlan {
+  vivsim::Scheduler scheduler;
+  vivsim::Device device(scheduler);
+  auto delegate = std::make_unique<vivsim::HostDelegate>(
+      scheduler, [&](uint8_t const *value, size_t length) {
+        return device.Receive(value, length);
+      });
+  vivsim::HostDelegate *const host = delegate.get();
+  viv::Manager manager(std::move(delegate));
+  host->Attach(&manager);
+  device.Attach([host](uint8_t const *value, size_t length) {
+    host->Deliver(0, value, length);
+  });
+  std::vector<uint8_t> contents(3000);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<uint8_t>(i);
+  }
+  device.AddFile(
+      1, kVLFileTypeFitActivity, 100,
+      std::vector<uint8_t>(contents.begin(), contents.begin() + 1000));
+  device.AddFile(2, kVLFileTypeFitActivity, 200, contents);
+  device.AddFile(3, kVLFileTypeFitActivity, 300, contents);
+
+  // File 1 is done, and file 2 has grown since it was ingested.
+  std::vector<VLLocalFile> const local = {
+      {1, VLGetPosixTimeFromViva(100), 1000, 1},
+      {2, VLGetPosixTimeFromViva(200), 2000, 1},
+  };
+  manager.DownloadDirectory();
+  scheduler.Run();
+  auto const &directory = host->raw_directory();
+  VLSyncPolicy policy = VLSyncDefaultPolicy();
+  policy.erase_ingested = 1;
+  std::vector<VLSyncStep> steps(4);
+  int const count = VLPlanSync(
+      directory.data(), directory.size(), local.data(), local.size(), &policy,
+      steps.data(), steps.size());
+  XCTAssertEqual(count, 4);
+
+  for (size_t i = 0; i < static_cast<size_t>(count);) {
+    i += viv::IssueSyncSteps(
+        manager, &steps[i], count - i, VLGetPosixTimeFromViva(5000));
+    scheduler.Run();
+  }
+  XCTAssertEqual(host->errors(), 0);
+  XCTAssertEqual(host->files().at(2).size(), 1000);
+  XCTAssertTrue(std::equal(
+      contents.begin() + 2000, contents.end(), host->files().at(2).begin()));
+  XCTAssertEqual(host->files().at(3).size(), 3000);
+  XCTAssertEqual(host->files().count(1), 0);
+  XCTAssertFalse(device.HasFile(1));
+  XCTAssertTrue(device.HasFile(2));
+  XCTAssertGreaterThanOrEqual(device.clock(), 5000);
+}
+
+@end
@@ -0,0 +1,119 @@
+// DirectoryCache.swift
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import Foundation
+import Viv
+
+/// Per-device cache of the most recently downloaded directory.
+///
+/// Each device's directory is kept in its own file, in libviv's directory
+/// cache format (see `VLWriteDirectoryCache`).  The file is memory-mapped
+/// when it's loaded and read in place, so listing a cached directory doesn't
+/// copy or contact the device.
+struct DirectoryCache {
+  /// The directory holding the cache files.
+  let baseURL: URL
+
+  /// Creates a cache in the given directory.
+  ///
+  /// - Parameter baseURL: The directory for cache files, which is created
+  ///     when a directory is first stored.  Defaults to a "vivtool"
+  ///     subdirectory of the user's caches directory.
+  init(baseURL: URL? = nil) {
+    self.baseURL =
+      baseURL
+      ?? FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0]
+      .appendingPathComponent("vivtool", isDirectory: true)
+  }
+
+  /// Returns the cache file for the given device.
+  func url(for device: UUID) -> URL {
+    return baseURL.appendingPathComponent("\(device.uuidString).vivdir", isDirectory: false)
+  }
+
+  /// Stores a downloaded directory for the given device.
+  ///
+  /// - Parameters:
+  ///     - directory: The raw directory, from `didReadDirectory`.
+  ///     - device: The device the directory was downloaded from.
+  ///     - fetchedTime: When the directory was downloaded.
+  func store(_ directory: Data, for device: UUID, fetchedTime: Date = Date()) throws {
+    var cache = Data(count: VLDirectoryCacheLength(directory.count))
+    let capacity = cache.count
+    let written = cache.withUnsafeMutableBytes { (dst) in
+      directory.withUnsafeBytes { (src) in
+        VLWriteDirectoryCache(
+          dst.bindMemory(to: UInt8.self).baseAddress!, capacity,
+          src.bindMemory(to: UInt8.self).baseAddress!, src.count,
+          time_t(fetchedTime.timeIntervalSince1970))
+      }
+    }
+    guard written >= 0 else {
+      throw DirectoryCacheError.invalidDirectory
+    }
+
+    try FileManager.default.createDirectory(at: baseURL, withIntermediateDirectories: true)
+    try cache.write(to: url(for: device), options: .atomic)
+  }
+
+  /// Removes the cached directory for the given device, e.g. once files have
+  /// been erased from it.  Does nothing if there's no cached directory.
+  func remove(for device: UUID) throws {
+    do {
+      try FileManager.default.removeItem(at: url(for: device))
+    } catch CocoaError.fileNoSuchFile {
+      // Nothing was cached.
+    }
+  }
+
+  /// Lists the cached directory for the given device.
+  ///
+  /// - Parameters:
+  ///     - query: The entries to list, as for `queryDirectory`.
+  ///     - device: The device whose directory to list.
+  /// - Returns: A summary of the cached directory and the entries matching
+  ///     `query`, or nil if there is no valid cache for the device.
+  func load(_ query: VLDirectoryQuery, for device: UUID) -> (
+    info: VLDirectoryCacheInfo, entries: [VLDirectoryEntry]
+  )? {
+    guard let cache = try? Data(contentsOf: url(for: device), options: .alwaysMapped) else {
+      return nil
+    }
+
+    var info = VLDirectoryCacheInfo()
+    var entries = [VLDirectoryEntry]()
+    let status = cache.withUnsafeBytes { (buffer) -> Int32 in
+      let src = buffer.bindMemory(to: UInt8.self)
+      guard let base = src.baseAddress,
+        VLReadDirectoryCache(&info, base, src.count) == 0
+      else {
+        return -1
+      }
+      return withUnsafeMutablePointer(to: &entries) { (entries) in
+        VLQueryDirectoryCache(
+          base, src.count, query,
+          { (ctx, entry) in
+            ctx!.assumingMemoryBound(to: [VLDirectoryEntry].self).pointee.append(entry)
+          }, entries)
+      }
+    }
+    return status < 0 ? nil : (info, entries)
+  }
+}
+
+enum DirectoryCacheError: Error {
+  /// The directory couldn't be parsed.
+  case invalidDirectory
+}
@@ -38,11 +38,17 @@ class TerminalManager<Stream: TextOutputStream> {
 
   private let store: Store
 
+  private let directoryCache: DirectoryCache
+
   private var standardOutput: Stream
   private var standardError: Stream
 
-  init(store: Store, standardOutput: Stream, standardError: Stream) {
+  init(
+    store: Store, standardOutput: Stream, standardError: Stream,
+    directoryCache: DirectoryCache = DirectoryCache()
+  ) {
     self.store = store
+    self.directoryCache = directoryCache
     self.standardOutput = standardOutput
     self.standardError = standardError
   }
@@ -114,6 +120,11 @@ class TerminalManager<Stream: TextOutputStream> {
         print("Scanning for peripherals... ^C to exit.\n", to: &standardOutput)
       case let list as VivtoolCommand.List:
         updateFromOptions(list)
+        if !list.refresh, let entries = loadCachedDirectory(list) {
+          // Listing from the cache doesn't need the device at all.
+          store.dispatch { $0.directory = entries }
+          break
+        }
         store.dispatch { (state) in
           state.setFromOptions(list)
           state.vivCommandQueue.append(.downloadDirectory)
@@ -164,6 +175,25 @@ class TerminalManager<Stream: TextOutputStream> {
     verbose = options.verbose.verbose
   }
 
+  /// Lists activities from the cached directory of the requested device.
+  ///
+  /// - Returns: The cached activities, or nil if there's no cached directory.
+  private func loadCachedDirectory(_ options: VivtoolCommand.List) -> [VLDirectoryEntry]? {
+    guard let device = options.uuid.uuid ?? store.state.lastConnectedDevice,
+      let cached = directoryCache.load(VivManager.activityQuery, for: device)
+    else {
+      return nil
+    }
+
+    let fetched = Date(timeIntervalSince1970: TimeInterval(cached.info.fetched_time))
+    let age = Int(Date().timeIntervalSince(fetched))
+    let message =
+      "listing directory cached at \(ISO8601DateFormatter().string(from: fetched))"
+      + " (\(age)s ago); use --refresh to download it again"
+    store.dispatch { $0.message = .verboseError(message) }
+    return cached.entries
+  }
+
   // MARK: Renderers
 
   func renderMessage(_ terminalMessage: TerminalMessage) {
@@ -212,7 +242,7 @@ class TerminalManager<Stream: TextOutputStream> {
     } else {
       entryRenderer = renderDirectoryEntry(_:)
     }
-    directory.filter({ $0.file_type == .fitActivity }).forEach(entryRenderer)
+    directory.forEach(entryRenderer)
     store.dispatch { $0.shouldTerminate = true }
   }
 
@@ -355,6 +385,9 @@ extension VivtoolCommand {
 
     @Flag(name: .customShort("h"), help: "With -l, output localized sizes and times.")
     var humanReadable = false
+
+    @Flag(help: "Download the directory, even if it's cached.")
+    var refresh = false
   }
 
   struct Copy: ParsableCommand, WithCommonOptions {
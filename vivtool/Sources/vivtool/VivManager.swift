@@ -27,12 +27,22 @@ class VivManager: NSObject {
   /// and the application will terminate.
   private static let timeoutInterval = DispatchTimeInterval.seconds(16)
 
+  /// The entries listed by vivtool: only activities.
+  static let activityQuery: VLDirectoryQuery = {
+    var query = VLDirectoryQuery()
+    query.file_type = .fitActivity
+    return query
+  }()
+
   private let store: Store
 
   /// A manager for encoding and decoding messages to Viiiiva
   /// devices over GATT values.
   private let protocolManager: VLProtocolManager
 
+  /// Cache for downloaded directories.
+  private let directoryCache: DirectoryCache
+
   /// Whether the manager is busy with a command.
   ///
   /// If true, no new commands should be issued to the manager.
@@ -41,6 +51,13 @@ class VivManager: NSObject {
   /// Notifies the manager that it has been waiting for too long.
   private var timeout: DispatchWorkItem?
 
+  /// When the manager started waiting, until the first value arrives.
+  private var waitStart: DispatchTime?
+
+  /// Seconds between writing the most recent command and receiving its first
+  /// response, or `nil` if no command has been answered.
+  private(set) var roundTrip: TimeInterval?
+
   /// Subscriptions.
   private var cancellable = Set<AnyCancellable>()
 
@@ -59,9 +76,14 @@ class VivManager: NSObject {
   ///     - protocolManager: A closure that returns a manager
   ///         for encoding and decoding messages to Viiiiva devices
   ///         to GATT values.
-  init(store: Store, protocolManager: VLProtocolManager) {
+  ///     - directoryCache: Where to store downloaded directories.
+  init(
+    store: Store, protocolManager: VLProtocolManager,
+    directoryCache: DirectoryCache = DirectoryCache()
+  ) {
     self.store = store
     self.protocolManager = protocolManager
+    self.directoryCache = directoryCache
   }
 
   /// Subscribes to updates from the store.
@@ -77,6 +99,11 @@ class VivManager: NSObject {
         if self.isBusy {
           self.restartTimer()
         }
+        if let waitStart = self.waitStart {
+          let nanoseconds = DispatchTime.now().uptimeNanoseconds - waitStart.uptimeNanoseconds
+          self.roundTrip = TimeInterval(nanoseconds) / 1e9
+          self.waitStart = nil
+        }
 
         self.protocolManager.notifyValue(value)
       }
@@ -126,7 +153,8 @@ class VivManager: NSObject {
     assert(!self.isBusy)
 
     self.isBusy = true
-    self.protocolManager.downloadDirectory()
+    // Only activities are listed, so the core filters out the other files.
+    self.protocolManager.queryDirectory(Self.activityQuery)
   }
 
   func downloadFile(index: UInt16) {
@@ -147,9 +175,17 @@ class VivManager: NSObject {
     assert(!self.isBusy)
 
     self.isBusy = true
-    // Rounding upward before truncation will compensate for the lag in actually
-    // updating the device.
-    self.protocolManager.setTime(time_t(ceil(time.timeIntervalSince1970)))
+    let posixTime: time_t
+    if let roundTrip = roundTrip {
+      // The command arrives about half a round trip after it's written.
+      posixTime = VLClockState.compensatedTime(
+        hostTime: time.timeIntervalSince1970, rtt: roundTrip)
+    } else {
+      // Rounding upward before truncation will compensate for the lag in
+      // actually updating the device.
+      posixTime = time_t(ceil(time.timeIntervalSince1970))
+    }
+    self.protocolManager.setTime(posixTime)
   }
 }
 
@@ -160,6 +196,7 @@ extension VivManager: VLProtocolManagerDelegate {
   }
 
   func didStartWaiting() {
+    waitStart = DispatchTime.now()
     restartTimer()
   }
 
@@ -182,8 +219,19 @@ extension VivManager: VLProtocolManagerDelegate {
     }
   }
 
-  func didParseDirectoryEntry(_ entry: VLDirectoryEntry) {
-    directory.append(entry)
+  func didReadDirectory(_ data: Data) {
+    guard let device = store.state.lastConnectedDevice else { return }
+    do {
+      try directoryCache.store(data, for: device)
+    } catch {
+      store.dispatch { (state) in
+        state.message = .verboseError("error caching directory: \(error.localizedDescription)")
+      }
+    }
+  }
+
+  func didParseDirectory(_ entries: UnsafePointer<VLDirectoryEntry>, count: Int) {
+    directory.append(contentsOf: UnsafeBufferPointer(start: entries, count: count))
   }
 
   func didFinishParsingDirectory() {
@@ -203,6 +251,18 @@ extension VivManager: VLProtocolManagerDelegate {
   }
 
   func didEraseFile(_ index: UInt16, successfully ok: Bool) {
+    // The cached directory may still list the file, even if the erase
+    // failed; the next listing downloads the directory again.
+    if let device = store.state.lastConnectedDevice {
+      do {
+        try directoryCache.remove(for: device)
+      } catch {
+        store.dispatch { (state) in
+          state.message = .verboseError(
+            "error removing cached directory: \(error.localizedDescription)")
+        }
+      }
+    }
     store.dispatch { (state) in
       state.deletedFile = (index, ok)
       state.dequeCommand(.deleteFile(index: index))
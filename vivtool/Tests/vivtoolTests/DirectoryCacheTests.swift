@@ -0,0 +1,89 @@
+// DirectoryCacheTests.swift
+// Copyright 2020 Dean Scarff
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import Foundation
+import Viv
+import XCTest
+@testable import vivtool
+
+class DirectoryCacheTests: XCTestCase {
+  private static let device = UUID(uuidString: "E621E1F8-C36C-495A-93FC-0C247A3E6E5F")!
+
+  var baseURL: URL?
+  var cache: DirectoryCache?
+
+  override func setUpWithError() throws {
+    baseURL = FileManager.default.temporaryDirectory
+      .appendingPathComponent(UUID().uuidString, isDirectory: true)
+    cache = DirectoryCache(baseURL: baseURL)
+  }
+
+  override func tearDownWithError() throws {
+    try? FileManager.default.removeItem(at: baseURL!)
+  }
+
+  /// A directory with a settings file at index 1 and activities at 2 and 3.
+  static func makeDirectory() -> Data {
+    var data = Data(count: 64)
+    data[0] = 1  // version
+    data[1] = 16  // record_length
+    for index in 1...3 {
+      let offset = 16 * index
+      data[offset] = UInt8(index)
+      data[offset + 2] = 0x80
+      data[offset + 3] = index == 1 ? 0x02 : 0x04
+      data[offset + 8] = UInt8(index)
+    }
+    return data
+  }
+
+  func testLoadMissing() {
+    XCTAssertNil(cache!.load(VLDirectoryQuery(), for: Self.device))
+  }
+
+  func testStoreAndLoad() throws {
+    let fetchedTime = Date(timeIntervalSince1970: 1_600_000_000)
+    try cache!.store(Self.makeDirectory(), for: Self.device, fetchedTime: fetchedTime)
+
+    let cached = cache!.load(VivManager.activityQuery, for: Self.device)
+    XCTAssertNotNil(cached)
+    XCTAssertEqual(cached!.info.fetched_time, 1_600_000_000)
+    XCTAssertEqual(cached!.info.entry_count, 3)
+    XCTAssertEqual(cached!.entries.map { $0.index }, [2, 3])
+  }
+
+  func testLoadCorrupt() throws {
+    try cache!.store(Self.makeDirectory(), for: Self.device)
+    let url = cache!.url(for: Self.device)
+    var data = try Data(contentsOf: url)
+    data[data.count - 8] ^= 1
+    try data.write(to: url)
+
+    XCTAssertNil(cache!.load(VLDirectoryQuery(), for: Self.device))
+  }
+
+  func testRemove() throws {
+    try cache!.store(Self.makeDirectory(), for: Self.device)
+    try cache!.remove(for: Self.device)
+    XCTAssertNil(cache!.load(VLDirectoryQuery(), for: Self.device))
+
+    // Removing a missing cache isn't an error.
+    XCTAssertNoThrow(try cache!.remove(for: Self.device))
+  }
+
+  func testStoreInvalid() {
+    XCTAssertThrowsError(try cache!.store(Data(count: 15), for: Self.device))
+  }
+}
@@ -111,6 +111,7 @@ class TerminalManagerStaticTests: XCTestCase {
     _ = try VivtoolCommand.parseAsRoot(["ls"])
     _ = try VivtoolCommand.parseAsRoot(["ls", "-l"])
     _ = try VivtoolCommand.parseAsRoot(["ls", "-l", "-h"])
+    _ = try VivtoolCommand.parseAsRoot(["ls", "--refresh"])
 
     _ = try VivtoolCommand.parseAsRoot(["cp", "0001.fit", "dest.fit"])
     XCTAssertThrowsError(try VivtoolCommand.parseAsRoot(["cp", "0001.fit"]))
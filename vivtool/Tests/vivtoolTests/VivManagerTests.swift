@@ -45,7 +45,7 @@ class VivManagerTests: XCTestCase {
     store.state.vivCommandQueue.append(.downloadDirectory)
 
     wait(for: [protocolManager.expectation], timeout: Self.timeout)
-    XCTAssertEqual(protocolManager.commands, [.downloadDirectory])
+    XCTAssertEqual(protocolManager.commands, [.queryDirectory(.fitActivity)])
   }
 
   func testDownloadFile() {
@@ -84,6 +84,7 @@ class FakeProtocolManager: VLProtocolManager {
     case notifyValue(Data)
     case notifyTimeout
     case downloadDirectory
+    case queryDirectory(VLFileType)
     case downloadFile(UInt16)
     case eraseFile(UInt16)
     case setTime(time_t)
@@ -107,6 +108,11 @@ class FakeProtocolManager: VLProtocolManager {
     expectation.fulfill()
   }
 
+  override func queryDirectory(_ query: VLDirectoryQuery) {
+    commands.append(.queryDirectory(query.file_type))
+    expectation.fulfill()
+  }
+
   override func downloadFile(_ index: UInt16) {
     commands.append(.downloadFile(index))
     expectation.fulfill()